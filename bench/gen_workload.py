@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""Generate a synthetic FLE link workload.
+
+Writes FLE objects straight to disk, with no compiler involved:
+
+  objN.fo           N main objects, M functions each, K relocations each
+  libarD.fa         D archive levels; members of level d call into level d+1,
+                    so every level is pulled in by the one before it
+  libbenchS.fo      S shared library sources (the harness links them with
+                    `ld -shared` into libbenchS.so)
+  workload.json     the parameters and the inputs to build and link
+
+The code is never run except for _start, which exits right away, so the exec
+timing measures loader startup only.
+"""
+
+import argparse
+import json
+import random
+from pathlib import Path
+
+EXIT_STUB = bytes([0xB8, 0x3C, 0x00, 0x00, 0x00, 0x31, 0xFF, 0x0F, 0x05])  # mov $60,%eax; xor %edi,%edi; syscall
+CALL = 0xE8
+RET = 0xC3
+LINE_BYTES = 16
+
+
+class SectionBuilder:
+    """Accumulates the lines of one FLE section."""
+
+    def __init__(self, name):
+        self.name = name
+        self.lines = []
+        self.pending = bytearray()
+        self.size = 0
+
+    def flush(self):
+        for i in range(0, len(self.pending), LINE_BYTES):
+            chunk = self.pending[i : i + LINE_BYTES]
+            self.lines.append("🔢: " + " ".join(f"{b:02x}" for b in chunk))
+        self.pending.clear()
+
+    def data(self, raw):
+        self.pending += raw
+        self.size += len(raw)
+
+    def reloc(self, kind, symbol, addend, width):
+        self.flush()
+        sign = "-" if addend < 0 else "+"
+        self.lines.append(f"❓: .{kind}({symbol} {sign} {abs(addend)})")
+        self.size += width
+
+    def symbol(self, prefix, name, size, offset):
+        self.flush()
+        self.lines.append(f"{prefix}: {name} {size} {offset}")
+
+    def finish(self):
+        self.flush()
+        return self.lines
+
+
+def emit_functions(text, names, calls_per_function, pick_target):
+    """One function per name: a run of `call target` followed by `ret`."""
+    for name, calls in zip(names, calls_per_function):
+        size = 5 * calls + 1
+        text.symbol("📤", name, size, text.size)
+        for _ in range(calls):
+            text.data(bytes([CALL]))
+            text.reloc("rel", pick_target(), -4, 4)
+        text.data(bytes([RET]))
+
+
+def spread(total, buckets):
+    """Split total into `buckets` near-equal parts."""
+    base, extra = divmod(total, buckets)
+    return [base + (1 if i < extra else 0) for i in range(buckets)]
+
+
+def write_object(path, sections):
+    """sections: list of (SectionBuilder, shdr type, shdr flags)"""
+    obj = {"type": ".obj", "shdrs": []}
+    for sec, sh_type, sh_flags in sections:
+        obj["shdrs"].append(
+            {"name": sec.name, "type": sh_type, "flags": sh_flags, "addr": 0, "offset": 0, "size": sec.size}
+        )
+    for sec, _, _ in sections:
+        obj[sec.name] = sec.finish()
+    path.write_text(json.dumps(obj, indent=4, ensure_ascii=False) + "\n", encoding="utf-8")
+
+
+def generate(args):
+    out = Path(args.output)
+    out.mkdir(parents=True, exist_ok=True)
+    rng = random.Random(args.seed)
+    M = max(1, args.symbols)
+
+    def fn(prefix, i, j):
+        return f"{prefix}{i}_f{j}"
+
+    # Shared libraries: self-contained, functions call within the same library
+    so_sources = []
+    for s in range(args.shared_libs):
+        text = SectionBuilder(".text")
+        names = [fn(f"so{s}_", 0, j) for j in range(M)]
+        emit_functions(text, names, spread(args.relocs, M), lambda: rng.choice(names))
+        src = out / f"libbench{s}.fo"
+        write_object(src, [(text, 1, 1 | 4)])
+        so_sources.append(src.name)
+
+    # Archives: level d member m calls level d+1 member m, so the chain is resolved iteratively
+    archives = []
+    for d in range(args.archive_depth):
+        members = []
+        for m in range(args.archive_members):
+            text = SectionBuilder(".text")
+            names = [fn(f"ar{d}_", m, j) for j in range(M)]
+            deeper = fn(f"ar{d + 1}_", m, 0) if d + 1 < args.archive_depth else None
+            calls = spread(args.relocs, M)
+
+            def pick(names=names, deeper=deeper):
+                if deeper is not None and rng.random() < 0.25:
+                    return deeper
+                return rng.choice(names)
+
+            emit_functions(text, names, calls, pick)
+            # Make sure the next level is always pulled in
+            if deeper is not None:
+                text.symbol("🏷️", f"ar{d}_{m}_link", 6, text.size)
+                text.data(bytes([CALL]))
+                text.reloc("rel", deeper, -4, 4)
+                text.data(bytes([RET]))
+            member = out / f"ar{d}_{m}.fo"
+            write_object(member, [(text, 1, 1 | 4)])
+            members.append(member.name)
+        archives.append({"name": f"libar{d}.fa", "members": members})
+
+    # Main objects: calls across objects, into level-0 archives and shared libraries,
+    # plus a table of absolute pointers in .data
+    all_main = [fn("o", i, j) for i in range(args.objects) for j in range(M)]
+    archive_roots = [fn("ar0_", m, 0) for m in range(args.archive_members)] if args.archive_depth else []
+    so_funcs = [fn(f"so{s}_", 0, j) for s in range(args.shared_libs) for j in range(M)]
+    objects = []
+    for i in range(args.objects):
+        text = SectionBuilder(".text")
+        data = SectionBuilder(".data")
+        names = [fn("o", i, j) for j in range(M)]
+        n_data = args.relocs // 4
+        n_text = args.relocs - n_data
+
+        def pick():
+            r = rng.random()
+            if so_funcs and r < 0.15:
+                return rng.choice(so_funcs)
+            if archive_roots and r < 0.30:
+                return rng.choice(archive_roots)
+            return rng.choice(all_main)
+
+        if i == 0:
+            text.symbol("📤", "_start", len(EXIT_STUB), 0)
+            text.data(EXIT_STUB)
+            # Pull in every archive chain regardless of the random picks
+            for root in archive_roots:
+                text.data(bytes([CALL]))
+                text.reloc("rel", root, -4, 4)
+        emit_functions(text, names, spread(n_text, M), pick)
+
+        data.symbol("📤", f"o{i}_table", 8 * n_data, 0)
+        for _ in range(n_data):
+            data.reloc("abs64", rng.choice(names), 0, 8)
+
+        sections = [(text, 1, 1 | 4)]
+        if n_data:
+            sections.append((data, 1, 1 | 2))
+        obj = out / f"obj{i}.fo"
+        write_object(obj, sections)
+        objects.append(obj.name)
+
+    shared = [f"libbench{s}.so" for s in range(args.shared_libs)]
+    workload = {
+        "params": {
+            "objects": args.objects,
+            "symbols": args.symbols,
+            "relocs": args.relocs,
+            "archive_depth": args.archive_depth,
+            "archive_members": args.archive_members,
+            "shared_libs": args.shared_libs,
+            "seed": args.seed,
+        },
+        "shared_libs": [{"name": so, "sources": [src]} for so, src in zip(shared, so_sources)],
+        "archives": archives,
+        "link": objects + [a["name"] for a in archives] + shared,
+    }
+    (out / "workload.json").write_text(json.dumps(workload, indent=4) + "\n")
+    return workload
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a synthetic FLE link workload")
+    parser.add_argument("-o", "--output", required=True, help="Output directory")
+    parser.add_argument("-n", "--objects", type=int, default=16, help="Main objects (N)")
+    parser.add_argument("-m", "--symbols", type=int, default=64, help="Functions per object (M)")
+    parser.add_argument("-k", "--relocs", type=int, default=256, help="Relocations per object (K)")
+    parser.add_argument("-d", "--archive-depth", type=int, default=2, help="Chained archive levels (D)")
+    parser.add_argument("--archive-members", type=int, default=4, help="Members per archive")
+    parser.add_argument("-s", "--shared-libs", type=int, default=1, help="Shared libraries")
+    parser.add_argument("--seed", type=int, default=1, help="Random seed")
+    args = parser.parse_args()
+    if args.objects < 1:
+        parser.error("need at least one object")
+    generate(args)
+
+
+if __name__ == "__main__":
+    main()
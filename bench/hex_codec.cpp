@@ -0,0 +1,97 @@
+// Microbenchmark for the 🔢 hex codec: GB/s of raw section bytes for every
+// available kernel, encoding and decoding full 16-byte lines as FLEWriter
+// and load_fle do.
+#include "hex.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr size_t DATA_SIZE = 64 << 20;
+constexpr int ROUNDS = 5;
+
+using Clock = std::chrono::steady_clock;
+
+// Best of ROUNDS, in GB/s of DATA_SIZE
+double measure(const std::function<void()>& body)
+{
+    double best = 0;
+    for (int i = 0; i < ROUNDS; ++i) {
+        auto begin = Clock::now();
+        body();
+        std::chrono::duration<double> elapsed = Clock::now() - begin;
+        best = std::max(best, DATA_SIZE / elapsed.count() / 1e9);
+    }
+    return best;
+}
+
+// Lines are stored back to back, one per 48-char slot, so only the kernels are timed
+constexpr size_t SLOT = 3 * HEX_BLOCK_BYTES;
+
+void encode_lines(const std::vector<uint8_t>& data, std::string& text, bool simd)
+{
+    text.resize(data.size() / HEX_BLOCK_BYTES * SLOT);
+    for (size_t pos = 0, slot = 0; pos < data.size(); pos += HEX_BLOCK_BYTES, slot += SLOT) {
+        if (simd) {
+            hex_encode(data.data() + pos, HEX_BLOCK_BYTES, &text[slot]);
+        } else {
+            hex_encode_scalar(data.data() + pos, HEX_BLOCK_BYTES, &text[slot]);
+        }
+        text[slot + HEX_BLOCK_CHARS] = '\n';
+    }
+}
+
+void decode_lines(const std::string& text, std::vector<uint8_t>& out, bool simd)
+{
+    out.clear();
+    for (size_t slot = 0; slot < text.size(); slot += SLOT) {
+        std::string_view line(text.data() + slot, HEX_BLOCK_CHARS);
+        if (simd) {
+            hex_decode(line, out);
+        } else {
+            hex_decode_scalar(line, out);
+        }
+    }
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<uint8_t> data(DATA_SIZE);
+    std::mt19937_64 rng(42);
+    for (auto& byte : data) {
+        byte = static_cast<uint8_t>(rng());
+    }
+
+    std::vector<std::pair<const char*, bool>> kernels = { { "scalar", false } };
+    if (hex_simd_available()) {
+        kernels.push_back({ "ssse3", true });
+    }
+
+    // Output buffers are reused so that page faults are not timed
+    std::string reference, text;
+    std::vector<uint8_t> decoded;
+    decoded.reserve(DATA_SIZE);
+    encode_lines(data, reference, false);
+
+    std::printf("%-8s %12s %12s\n", "kernel", "encode GB/s", "decode GB/s");
+    for (const auto& [name, simd] : kernels) {
+        encode_lines(data, text, simd);
+        decode_lines(reference, decoded, simd);
+        if (text != reference || decoded != data) {
+            std::fprintf(stderr, "%s: round trip mismatch\n", name);
+            return 1;
+        }
+        double encode = measure([&, simd = simd] { encode_lines(data, text, simd); });
+        double decode = measure([&, simd = simd] { decode_lines(reference, decoded, simd); });
+        std::printf("%-8s %12.2f %12.2f\n", name, encode, decode);
+    }
+    return 0;
+}
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Time the FLE tools on synthetic workloads (see gen_workload.py).
+
+For each workload the harness builds the shared libraries and archives, then
+links and runs the program several times. Phase timings come from the tools'
+own Chrome traces (`ld --time-trace-file`, `exec --time-trace-file`), so
+load_fle, FLE_ld, FLE_objdump serialisation and FLE_exec startup are reported
+separately. The best of --repeat runs is kept.
+
+Results are written as JSON (--json). With --baseline, every timing is compared
+against an earlier result file and the exit code is 1 if any phase got slower
+than --threshold allows.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+import gen_workload
+
+ROOT = Path(__file__).resolve().parent.parent
+
+PRESETS = {
+    "small": dict(objects=8, symbols=32, relocs=128, archive_depth=2, archive_members=4, shared_libs=1),
+    "medium": dict(objects=64, symbols=128, relocs=1024, archive_depth=3, archive_members=8, shared_libs=2),
+    "large": dict(objects=256, symbols=256, relocs=4096, archive_depth=4, archive_members=16, shared_libs=4),
+}
+
+# Trace event name -> reported metric
+LD_PHASES = {
+    "Load inputs": "load_fle",
+    "FLE_ld": "FLE_ld",
+    "FLE_objdump": "FLE_objdump",
+    "FLEWriter::finish": "FLEWriter::finish",
+    "Total link": "ld_total",
+}
+EXEC_PHASES = {
+    "Load program": "exec_load_fle",
+    "Scan dependencies": "exec_scan",
+    "Map modules": "exec_map",
+    "Relocate": "exec_relocate",
+    "Protect": "exec_protect",
+    "FLE_exec startup": "exec_startup",
+}
+
+# Metrics too short to compare reliably are skipped by --baseline
+MIN_COMPARE_MS = 5.0
+
+
+def run(cmd, cwd, env=None):
+    begin = time.perf_counter()
+    proc = subprocess.run(cmd, cwd=cwd, env=env, capture_output=True, text=True)
+    elapsed = (time.perf_counter() - begin) * 1000
+    if proc.returncode != 0:
+        raise RuntimeError(f"{' '.join(map(str, cmd))} failed ({proc.returncode}):\n{proc.stderr}")
+    return elapsed
+
+
+def read_trace(path, phases):
+    with open(path) as f:
+        events = json.load(f)["traceEvents"]
+    timings = {}
+    for ev in events:
+        metric = phases.get(ev["name"])
+        if metric is not None:
+            timings[metric] = timings.get(metric, 0.0) + ev["dur"] / 1000
+    return timings
+
+
+def build(workdir, workload):
+    """Archives and shared libraries are inputs, not part of what is measured."""
+    for archive in workload["archives"]:
+        run([ROOT / "ar", archive["name"], *archive["members"]], workdir)
+    for lib in workload["shared_libs"]:
+        run([ROOT / "ld", "-shared", *lib["sources"], "-o", lib["name"]], workdir)
+
+
+def measure(workdir, workload, repeat):
+    env = dict(os.environ, FLE_LIBRARY_PATH=str(workdir))
+    best = {}
+
+    def keep(metric, value):
+        best[metric] = min(best.get(metric, value), value)
+
+    for _ in range(repeat):
+        wall = run([ROOT / "ld", *workload["link"], "-o", "program", "--time-trace-file", "ld.trace.json"], workdir)
+        keep("ld_wall", wall)
+        for metric, value in read_trace(workdir / "ld.trace.json", LD_PHASES).items():
+            keep(metric, value)
+
+        wall = run([ROOT / "exec", "--time-trace-file", "exec.trace.json", "program"], workdir, env)
+        keep("exec_wall", wall)
+        for metric, value in read_trace(workdir / "exec.trace.json", EXEC_PHASES).items():
+            keep(metric, value)
+
+    best["serialise"] = best.get("FLE_objdump", 0.0) + best.get("FLEWriter::finish", 0.0)
+    return {k: round(v, 3) for k, v in sorted(best.items())}
+
+
+def input_bytes(workdir, workload):
+    return sum((workdir / name).stat().st_size for name in workload["link"])
+
+
+def bench_one(name, params, args, workdir):
+    gen_args = argparse.Namespace(output=str(workdir), seed=args.seed, **params)
+    workload = gen_workload.generate(gen_args)
+    build(workdir, workload)
+    timings = measure(workdir, workload, args.repeat)
+    return {
+        "workload": name,
+        "params": workload["params"],
+        "input_bytes": input_bytes(workdir, workload),
+        "output_bytes": (workdir / "program").stat().st_size,
+        "repeat": args.repeat,
+        "timings_ms": timings,
+    }
+
+
+def compare(results, baseline_path, threshold):
+    with open(baseline_path) as f:
+        baseline = {r["workload"]: r for r in json.load(f)["results"]}
+    regressions = []
+    for result in results:
+        base = baseline.get(result["workload"])
+        if base is None or base["params"] != result["params"]:
+            continue
+        for metric, value in result["timings_ms"].items():
+            old = base["timings_ms"].get(metric)
+            if old is None or max(old, value) < MIN_COMPARE_MS:
+                continue
+            if value > old * threshold:
+                regressions.append(f"{result['workload']}/{metric}: {old:.2f} ms -> {value:.2f} ms")
+    return regressions
+
+
+def git_revision():
+    try:
+        return subprocess.run(
+            ["git", "rev-parse", "--short", "HEAD"], cwd=ROOT, capture_output=True, text=True, check=True
+        ).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark the FLE tools on synthetic workloads")
+    parser.add_argument(
+        "-w", "--workloads", default="small,medium", help=f"Comma-separated presets ({', '.join(PRESETS)})"
+    )
+    parser.add_argument("-r", "--repeat", type=int, default=3, help="Runs per workload; the best is kept")
+    parser.add_argument("--seed", type=int, default=1, help="Workload random seed")
+    parser.add_argument("--json", default=str(ROOT / "bench_output.json"), help="Result file")
+    parser.add_argument("--workdir", help="Keep generated files here instead of a temporary directory")
+    parser.add_argument("--baseline", help="Earlier result file to compare against")
+    parser.add_argument("--threshold", type=float, default=1.10, help="Allowed slowdown ratio against --baseline")
+    args = parser.parse_args()
+
+    names = [w for w in args.workloads.split(",") if w]
+    for name in names:
+        if name not in PRESETS:
+            parser.error(f"unknown workload '{name}'")
+
+    results = []
+    for name in names:
+        if args.workdir:
+            workdir = Path(args.workdir).resolve() / name
+            shutil.rmtree(workdir, ignore_errors=True)
+            result = bench_one(name, PRESETS[name], args, workdir)
+        else:
+            with tempfile.TemporaryDirectory(prefix=f"fle-bench-{name}-") as tmp:
+                result = bench_one(name, PRESETS[name], args, Path(tmp))
+        results.append(result)
+
+        t = result["timings_ms"]
+        print(
+            f"{name:8} load_fle {t.get('load_fle', 0):9.2f}  FLE_ld {t.get('FLE_ld', 0):9.2f}  "
+            f"serialise {t['serialise']:9.2f}  exec startup {t.get('exec_startup', 0):9.2f}  (ms)"
+        )
+
+    with open(args.json, "w") as f:
+        json.dump({"revision": git_revision(), "results": results}, f, indent=4)
+        f.write("\n")
+    print(f"Results written to {args.json}")
+
+    if args.baseline:
+        regressions = compare(results, args.baseline, args.threshold)
+        for line in regressions:
+            print(f"REGRESSION {line}", file=sys.stderr)
+        if regressions:
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,121 @@
+// Microbenchmark for x86-64 instruction boundaries: instructions/s of the
+// standalone length decoder against the full disasm decoder, walking the same
+// synthetic stream of typical compiler output.
+#include "x86_decode.hpp"
+#include "x86_length.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t INSTRUCTIONS = 4 << 20;
+constexpr int ROUNDS = 5;
+
+using Clock = std::chrono::steady_clock;
+
+// Encodings as gcc -O2 emits them, weighted roughly like real .text
+const std::vector<std::vector<uint8_t>> SAMPLES = {
+    { 0x55 }, // push %rbp
+    { 0x48, 0x89, 0xe5 }, // mov %rsp,%rbp
+    { 0x48, 0x83, 0xec, 0x20 }, // sub $0x20,%rsp
+    { 0x8b, 0x45, 0xfc }, // mov -0x4(%rbp),%eax
+    { 0x48, 0x8b, 0x05, 0x10, 0x20, 0x00, 0x00 }, // mov 0x2010(%rip),%rax
+    { 0x48, 0x8d, 0x3d, 0x00, 0x01, 0x00, 0x00 }, // lea 0x100(%rip),%rdi
+    { 0x89, 0x44, 0x24, 0x08 }, // mov %eax,0x8(%rsp)
+    { 0x48, 0x8b, 0x84, 0xc8, 0x00, 0x10, 0x00, 0x00 }, // mov 0x1000(%rax,%rcx,8),%rax
+    { 0xe8, 0x00, 0x00, 0x00, 0x00 }, // call
+    { 0x0f, 0x84, 0x10, 0x00, 0x00, 0x00 }, // je rel32
+    { 0x75, 0x08 }, // jne rel8
+    { 0x85, 0xc0 }, // test %eax,%eax
+    { 0x48, 0x39, 0xd0 }, // cmp %rdx,%rax
+    { 0x31, 0xc0 }, // xor %eax,%eax
+    { 0xb8, 0x01, 0x00, 0x00, 0x00 }, // mov $0x1,%eax
+    { 0x48, 0xb8, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11 }, // movabs
+    { 0x48, 0xc7, 0x45, 0xf8, 0x00, 0x00, 0x00, 0x00 }, // movq $0x0,-0x8(%rbp)
+    { 0x0f, 0xb6, 0x07 }, // movzbl (%rdi),%eax
+    { 0x48, 0x63, 0xd2 }, // movslq %edx,%rdx
+    { 0x0f, 0xaf, 0xc2 }, // imul %edx,%eax
+    { 0xc1, 0xe0, 0x04 }, // shl $0x4,%eax
+    { 0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00 }, // nopw 0x0(%rax,%rax,1)
+    { 0xf3, 0x0f, 0x1e, 0xfa }, // endbr64
+    { 0x66, 0x0f, 0xef, 0xc0 }, // pxor %xmm0,%xmm0
+    { 0xf2, 0x0f, 0x10, 0x45, 0xe8 }, // movsd -0x18(%rbp),%xmm0
+    { 0x0f, 0x11, 0x07 }, // movups %xmm0,(%rdi)
+    { 0xc9 }, // leave
+    { 0xc3 }, // ret
+};
+
+// Best of ROUNDS, in millions of instructions per second
+double measure(const std::function<size_t()>& body)
+{
+    double best = 0;
+    for (int i = 0; i < ROUNDS; ++i) {
+        auto begin = Clock::now();
+        size_t count = body();
+        std::chrono::duration<double> elapsed = Clock::now() - begin;
+        best = std::max(best, count / elapsed.count() / 1e6);
+    }
+    return best;
+}
+
+// Number of instructions in code, or 0 if a boundary is missed
+template <typename Step>
+size_t walk(const std::vector<uint8_t>& code, Step step)
+{
+    size_t count = 0;
+    for (size_t pos = 0; pos < code.size(); ++count) {
+        size_t length = step(code.data() + pos, code.size() - pos, pos);
+        if (length == 0) {
+            return 0;
+        }
+        pos += length;
+    }
+    return count;
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<uint8_t> code;
+    std::vector<size_t> boundaries;
+    std::mt19937_64 rng(42);
+    for (size_t i = 0; i < INSTRUCTIONS; ++i) {
+        const auto& sample = SAMPLES[rng() % SAMPLES.size()];
+        boundaries.push_back(code.size());
+        code.insert(code.end(), sample.begin(), sample.end());
+    }
+
+    // Both decoders must agree with the stream as it was built
+    x86::Instruction insn;
+    for (size_t i = 0; i < boundaries.size(); ++i) {
+        size_t pos = boundaries[i];
+        size_t expected = (i + 1 < boundaries.size() ? boundaries[i + 1] : code.size()) - pos;
+        size_t fast = x86::decode_length(code.data() + pos, code.size() - pos);
+        x86::decode(code.data() + pos, code.size() - pos, pos, insn);
+        if (fast != expected || !insn.valid || insn.length != expected) {
+            std::fprintf(stderr, "length mismatch at %#zx: expected %zu, decode_length %zu, decode %zu\n", pos,
+                expected, fast, insn.length);
+            return 1;
+        }
+    }
+
+    double length = measure([&] {
+        return walk(code, [](const uint8_t* p, size_t size, size_t) { return x86::decode_length(p, size); });
+    });
+    double full = measure([&] {
+        return walk(code, [&](const uint8_t* p, size_t size, size_t address) {
+            x86::decode(p, size, address, insn);
+            return insn.length;
+        });
+    });
+
+    std::printf("%-14s %12s\n", "decoder", "M insn/s");
+    std::printf("%-14s %12.2f\n", "decode_length", length);
+    std::printf("%-14s %12.2f\n", "decode", full);
+    return 0;
+}
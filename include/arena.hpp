@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/**
+ * Bump allocator: hands out memory from a few large chunks and releases it
+ * all at once when destroyed. Nothing allocated from an arena is ever freed
+ * individually.
+ */
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+        uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t(align) - 1);
+        if (cursor == nullptr || p + size > reinterpret_cast<uintptr_t>(limit)) {
+            grow(size + align);
+            p = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t(align) - 1);
+        }
+        cursor = reinterpret_cast<char*>(p + size);
+        used += size;
+        return reinterpret_cast<void*>(p);
+    }
+
+    // Copy text into the arena; the view stays valid as long as the arena
+    std::string_view store(std::string_view text)
+    {
+        if (text.empty()) {
+            return {};
+        }
+        char* dst = static_cast<char*>(allocate(text.size(), 1));
+        std::memcpy(dst, text.data(), text.size());
+        return { dst, text.size() };
+    }
+
+    size_t bytes_used() const { return used; } // Bytes handed out
+    size_t bytes_reserved() const { return reserved; } // Bytes obtained from malloc
+    size_t chunk_count() const { return chunks.size(); }
+
+private:
+    static constexpr size_t MIN_CHUNK = 64 * 1024;
+    static constexpr size_t MAX_CHUNK = 4 * 1024 * 1024;
+
+    // Chunks double in size so a large file needs only a handful of them
+    void grow(size_t at_least)
+    {
+        size_t size = std::max(at_least, std::min(MAX_CHUNK, std::max(MIN_CHUNK, reserved)));
+        chunks.emplace_back(new char[size]);
+        cursor = chunks.back().get();
+        limit = cursor + size;
+        reserved += size;
+    }
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t used = 0;
+    size_t reserved = 0;
+};
+
+#endif
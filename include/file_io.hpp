@@ -0,0 +1,182 @@
+#pragma once
+
+#ifndef FILE_IO_HPP
+#define FILE_IO_HPP
+
+#include "stats.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Read a whole file with one fstat-sized read
+ * @throws runtime_error if the file cannot be opened or read
+ */
+inline std::string read_file(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    Stats::add(Counter::FileSyscalls);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    Stats::add(Counter::FileSyscalls);
+    std::string content;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        content.resize(static_cast<size_t>(st.st_size));
+    }
+
+    // The size is only a hint: read until EOF in case the file changed meanwhile.
+    // A full buffer is probed with a one-byte read so exact sizes never regrow.
+    size_t used = 0;
+    for (;;) {
+        char probe;
+        bool full = used == content.size();
+        ssize_t n = full ? ::read(fd, &probe, 1) : ::read(fd, content.data() + used, content.size() - used);
+        Stats::add(Counter::FileSyscalls);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int err = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot read " + path + ": " + std::strerror(err));
+        }
+        if (n == 0) {
+            break;
+        }
+        if (full) {
+            content.resize(std::max<size_t>(content.size() * 2, 4096));
+            content[used] = probe;
+        }
+        used += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    Stats::add(Counter::FileSyscalls);
+    content.resize(used);
+    Stats::add(Counter::BytesRead, used);
+    return content;
+}
+
+// Split a ':'-separated search path such as $FLE_LIBRARY_PATH, dropping empty entries
+inline std::vector<std::string> split_search_path(std::string_view paths)
+{
+    std::vector<std::string> dirs;
+    while (!paths.empty()) {
+        size_t colon = paths.find(':');
+        std::string_view dir = paths.substr(0, colon);
+        if (!dir.empty()) {
+            dirs.emplace_back(dir);
+        }
+        if (colon == std::string_view::npos) {
+            break;
+        }
+        paths.remove_prefix(colon + 1);
+    }
+    return dirs;
+}
+
+/**
+ * Answers "is there a regular file here" from directory listings. Each
+ * directory is read once with getdents64; only entries whose type the listing
+ * does not give (symlinks, some file systems) cost an extra stat, once.
+ * Call clear() when the file system may have changed, e.g. between links in
+ * a long-running process.
+ */
+class DirectoryCache {
+public:
+    static DirectoryCache& get()
+    {
+        static DirectoryCache instance;
+        return instance;
+    }
+
+    bool is_regular_file(std::string_view path)
+    {
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string_view::npos ? "." : std::string(path.substr(0, slash == 0 ? 1 : slash));
+        std::string_view name = slash == std::string_view::npos ? path : path.substr(slash + 1);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& entries = listing(dir);
+        auto it = entries.find(std::string(name));
+        if (it == entries.end()) {
+            return false;
+        }
+        if (it->second == DT_LNK || it->second == DT_UNKNOWN) {
+            struct stat st;
+            Stats::add(Counter::FileSyscalls);
+            it->second = ::stat(std::string(path).c_str(), &st) == 0 && S_ISREG(st.st_mode) ? DT_REG : DT_DIR;
+        }
+        return it->second == DT_REG;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dirs.clear();
+    }
+
+private:
+    using Entries = std::unordered_map<std::string, unsigned char>; // Name -> d_type
+
+    DirectoryCache() = default;
+
+    Entries& listing(const std::string& dir)
+    {
+        // "lib", "lib/" and "./lib" name the same directory
+        std::string key = dir;
+        while (key.size() > 1 && key.back() == '/') {
+            key.pop_back();
+        }
+        if (key.rfind("./", 0) == 0 && key.size() > 2) {
+            key.erase(0, 2);
+        }
+        auto [it, inserted] = dirs.try_emplace(key);
+        if (inserted) {
+            read_directory(key, it->second);
+        }
+        return it->second;
+    }
+
+    // A missing or unreadable directory simply lists as empty
+    static void read_directory(const std::string& dir, Entries& entries)
+    {
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        Stats::add(Counter::FileSyscalls);
+        if (fd < 0) {
+            return;
+        }
+        alignas(8) char buffer[32 * 1024];
+        for (;;) {
+            long n = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+            Stats::add(Counter::FileSyscalls);
+            if (n <= 0) {
+                break;
+            }
+            for (long pos = 0; pos < n;) {
+                auto* entry = reinterpret_cast<dirent64*>(buffer + pos);
+                entries.emplace(entry->d_name, entry->d_type);
+                pos += entry->d_reclen;
+            }
+        }
+        ::close(fd);
+        Stats::add(Counter::FileSyscalls);
+    }
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entries> dirs;
+};
+
+#endif
@@ -3,11 +3,23 @@
 #ifndef FLE_HPP
 #define FLE_HPP
 
+#include "intern.hpp"
 #include "nlohmann/json.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
 #include <cstdint>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <functional>
 #include <map>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
 using json = nlohmann::ordered_json;
@@ -18,14 +30,40 @@ enum class RelocationType {
     R_X86_64_PC32, // 32-bit PC-relative addressing
     R_X86_64_64, // 64-bit absolute addressing
     R_X86_64_32S, // 32-bit signed absolute addressing
-    R_X86_64_GOTPCREL // 32-bit PC-relative GOT address
+    R_X86_64_GOTPCREL, // 32-bit PC-relative GOT address
+    R_X86_64_GOTPCRELX, // Relaxable GOTPCREL (mov/call/jmp without REX)
+    R_X86_64_REX_GOTPCRELX, // Relaxable GOTPCREL (mov with REX prefix)
+    R_X86_64_COPY, // Executable's copy of a shared library data object (dynamic only)
+    R_X86_64_TPOFF32, // 32-bit offset of a TLS variable from the thread pointer (local-exec)
+    R_X86_64_GOTTPOFF, // 32-bit PC-relative GOT slot holding a TP offset (initial-exec)
+    R_X86_64_TPOFF64, // 64-bit offset from the thread pointer
+    R_X86_64_DTPOFF32, // 32-bit offset within the defining module's TLS block
+    R_X86_64_DTPOFF64 // 64-bit offset within the defining module's TLS block
 };
 
+// Whether the relocation addresses its target through a GOT slot
+inline bool is_gotpcrel(RelocationType type)
+{
+    return type == RelocationType::R_X86_64_GOTPCREL
+        || type == RelocationType::R_X86_64_GOTPCRELX
+        || type == RelocationType::R_X86_64_REX_GOTPCRELX;
+}
+
+// Whether the relocation refers to a thread-local variable rather than an address
+inline bool is_tls(RelocationType type)
+{
+    return type == RelocationType::R_X86_64_TPOFF32
+        || type == RelocationType::R_X86_64_GOTTPOFF
+        || type == RelocationType::R_X86_64_TPOFF64
+        || type == RelocationType::R_X86_64_DTPOFF32
+        || type == RelocationType::R_X86_64_DTPOFF64;
+}
+
 // Relocation entry
 struct Relocation {
     RelocationType type;
     size_t offset; // Relocation position
-    std::string symbol; // Symbol to relocate
+    InternedString symbol; // Symbol to relocate
     int64_t addend; // Relocation addend
 };
 
@@ -37,20 +75,28 @@ enum class SymbolType {
     UNDEFINED // Undefined symbol
 };
 
+// ELF symbol visibility, carried as an optional last field of a symbol line
+enum class SymbolVisibility {
+    DEFAULT, // Exported from a shared library
+    PROTECTED, // Exported, but references inside the library bind to it directly
+    HIDDEN // Never leaves the module it is linked into ("internal" maps here too)
+};
+
 // Symbol entry
 struct Symbol {
     SymbolType type;
-    std::string section; // Section containing the symbol
+    InternedString section; // Section containing the symbol
     size_t offset; // Offset within section
     size_t size; // Symbol size
-    std::string name; // Symbol name
+    InternedString name; // Symbol name
+    SymbolVisibility visibility = SymbolVisibility::DEFAULT;
 };
 
 struct FLESection {
-    std::string name;
+    InternedString name;
     std::vector<uint8_t> data; // Section data (stored as bytes)
     std::vector<Relocation> relocs; // Relocation table for this section
-    bool has_symbols; // Whether section contains symbols
+    bool has_symbols = false; // Whether section contains symbols
 };
 
 enum class PHF { // Program Header Flags
@@ -64,6 +110,7 @@ enum class SHF { // Section Header Flags
     WRITE = 2, // Writable
     EXEC = 4, // Executable
     NOBITS = 8, // Takes no space in file (like BSS)
+    TLS = 16, // Thread-local template (.tdata, .tbss)
 };
 
 // ================= PHF (Program Header Flags) =================
@@ -159,85 +206,319 @@ struct FLEObject {
 
     std::vector<std::string> needed; // List of shared libraries this object depends on (e.g., "libfoo.so")
     std::vector<Relocation> dyn_relocs; // Dynamic relocations
+
+    // Keeps the interner generation holding the text of the names above alive;
+    // its arenas are freed only after renew() and once no object refers to it
+    std::shared_ptr<const StringInterner> names = StringInterner::current();
 };
 
+/**
+ * Streams an FLE file to disk while it is being produced.
+ *
+ * The text is byte-identical to ordered_json::dump(4) of the same calls, but
+ * only a fixed-size buffer is held in memory. Output goes to a uniquely named
+ * temporary file next to the target that replaces it in finish(), so a failed
+ * write never leaves a truncated FLE behind and concurrent writers of the same
+ * path do not share a temporary. A symlinked target is written through, and
+ * an existing target keeps its permission bits.
+ */
 class FLEWriter {
 public:
+    explicit FLEWriter(const std::string& filename)
+        : filename(resolve_symlinks(filename))
+        , temp_filename(this->filename + ".tmp.XXXXXX")
+    {
+        fd = ::mkostemp(temp_filename.data(), O_CLOEXEC);
+        Stats::add(Counter::FileSyscalls);
+        if (fd < 0) {
+            throw std::runtime_error("FLEWriter: cannot create " + temp_filename + ": " + std::strerror(errno));
+        }
+        // mkstemp always creates 0600; give the file the mode a plain open would
+        struct stat st;
+        mode_t mode;
+        if (::stat(this->filename.c_str(), &st) == 0) {
+            mode = st.st_mode & 07777;
+        } else {
+            mode_t mask = ::umask(0);
+            ::umask(mask);
+            mode = 0666 & ~mask;
+        }
+        Stats::add(Counter::FileSyscalls, 2); // stat + fchmod
+        if (::fchmod(fd, mode) != 0) {
+            int err = errno;
+            discard();
+            throw std::runtime_error("FLEWriter: cannot set mode of " + temp_filename + ": " + std::strerror(err));
+        }
+        buffer.reserve(BUFFER_SIZE);
+    }
+
+    // The temporary is removed unless finish() moved it into place
+    ~FLEWriter()
+    {
+        if (!finished) {
+            discard();
+        }
+    }
+
+    FLEWriter(const FLEWriter&) = delete;
+    FLEWriter& operator=(const FLEWriter&) = delete;
+
     void set_type(std::string_view type)
     {
-        result["type"] = type;
+        begin_key("type");
+        put_string(type);
     }
 
     void begin_section(std::string_view name)
     {
+        begin_key(name);
         current_section = name;
-        current_lines.clear();
+        section_empty = true;
     }
     void end_section()
     {
-        result[current_section] = current_lines;
+        put(section_empty ? "[]" : "\n    ]");
         current_section.clear();
-        current_lines.clear();
     }
 
-    void write_line(std::string line)
+    void write_line(std::string_view line)
     {
         if (current_section.empty()) {
             throw std::runtime_error("FLEWriter: begin_section must be called before write_line");
         }
-        current_lines.push_back(line);
+        put(section_empty ? "[\n        " : ",\n        ");
+        put_string(line);
+        section_empty = false;
     }
 
-    void write_to_file(const std::string& filename)
+    // Flush the closing brace and move the file into place
+    void finish()
     {
-        std::ofstream out(filename);
-        out << result.dump(4) << std::endl;
+        put(has_keys ? "\n}\n" : "{}\n");
+        flush();
+        Stats::add(Counter::FileSyscalls, 2); // close + rename
+        int closed = ::close(fd);
+        fd = -1;
+        if (closed != 0) {
+            throw std::runtime_error("FLEWriter: cannot close " + temp_filename + ": " + std::strerror(errno));
+        }
+        if (::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+            throw std::runtime_error("FLEWriter: cannot rename " + temp_filename + " to " + filename + ": " + std::strerror(errno));
+        }
+        finished = true;
     }
 
     void write_program_headers(const std::vector<ProgramHeader>& phdrs)
     {
-        json phdrs_json = json::array();
-        for (const auto& phdr : phdrs) {
-            json phdr_json;
-            phdr_json["name"] = phdr.name;
-            phdr_json["vaddr"] = phdr.vaddr;
-            phdr_json["size"] = phdr.size;
-            phdr_json["flags"] = phdr.flags;
-            phdrs_json.push_back(phdr_json);
-        }
-        result["phdrs"] = phdrs_json;
+        begin_key("phdrs");
+        put_records(phdrs, [this](const ProgramHeader& phdr) {
+            put_field("name", phdr.name, true);
+            put_field("vaddr", phdr.vaddr);
+            put_field("size", phdr.size);
+            put_field("flags", phdr.flags);
+        });
     }
 
     void write_entry(size_t entry)
     {
-        result["entry"] = entry;
+        begin_key("entry");
+        put_uint(entry);
     }
 
     void write_section_headers(const std::vector<SectionHeader>& shdrs)
     {
-        json shdrs_json = json::array();
-        for (const auto& shdr : shdrs) {
-            json shdr_json;
-            shdr_json["name"] = shdr.name;
-            shdr_json["type"] = shdr.type;
-            shdr_json["flags"] = shdr.flags;
-            shdr_json["addr"] = shdr.addr;
-            shdr_json["offset"] = shdr.offset;
-            shdr_json["size"] = shdr.size;
-            shdrs_json.push_back(shdr_json);
-        }
-        result["shdrs"] = shdrs_json;
+        begin_key("shdrs");
+        put_records(shdrs, [this](const SectionHeader& shdr) {
+            put_field("name", shdr.name, true);
+            put_field("type", shdr.type);
+            put_field("flags", shdr.flags);
+            put_field("addr", shdr.addr);
+            put_field("offset", shdr.offset);
+            put_field("size", shdr.size);
+        });
     }
 
     void write_needed(const std::vector<std::string>& needed)
     {
-        result["needed"] = needed;
+        begin_key("needed");
+        if (needed.empty()) {
+            put("[]");
+            return;
+        }
+        for (size_t i = 0; i < needed.size(); ++i) {
+            put(i == 0 ? "[\n        " : ",\n        ");
+            put_string(needed[i]);
+        }
+        put("\n    ]");
     }
 
 private:
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+    static constexpr int MAX_SYMLINK_HOPS = 40; // Same limit as the kernel's ELOOP
+
+    // Follow symlinks so finish() replaces the file they point to, not the link
+    static std::string resolve_symlinks(std::string path)
+    {
+        for (int hops = 0; hops < MAX_SYMLINK_HOPS; ++hops) {
+            char target[PATH_MAX];
+            ssize_t n = ::readlink(path.c_str(), target, sizeof(target));
+            Stats::add(Counter::FileSyscalls);
+            if (n < 0) {
+                return path; // Not a symlink, or does not exist yet
+            }
+            std::string link(target, static_cast<size_t>(n));
+            size_t slash = path.rfind('/');
+            if (link.front() != '/' && slash != std::string::npos) {
+                link = path.substr(0, slash + 1) + link;
+            }
+            path = std::move(link);
+        }
+        throw std::runtime_error("FLEWriter: too many levels of symbolic links in " + path);
+    }
+
+    void discard()
+    {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        ::unlink(temp_filename.c_str());
+    }
+
+    void put(std::string_view text)
+    {
+        if (buffer.size() + text.size() > BUFFER_SIZE) {
+            flush();
+        }
+        buffer.append(text);
+    }
+
+    void put_uint(uint64_t value)
+    {
+        char digits[20];
+        size_t n = 0;
+        do {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        std::reverse(digits, digits + n);
+        put(std::string_view(digits, n));
+    }
+
+    // JSON string literal, escaped the same way as nlohmann::json (UTF-8 kept as is)
+    void put_string(std::string_view text)
+    {
+        static constexpr char HEX[] = "0123456789abcdef";
+        put("\"");
+        size_t run = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            put(text.substr(run, i - run));
+            run = i + 1;
+            switch (c) {
+            case '"':
+                put("\\\"");
+                break;
+            case '\\':
+                put("\\\\");
+                break;
+            case '\b':
+                put("\\b");
+                break;
+            case '\f':
+                put("\\f");
+                break;
+            case '\n':
+                put("\\n");
+                break;
+            case '\r':
+                put("\\r");
+                break;
+            case '\t':
+                put("\\t");
+                break;
+            default: {
+                const char esc[] = { '\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf] };
+                put(std::string_view(esc, sizeof(esc)));
+            }
+            }
+        }
+        put(text.substr(run));
+        put("\"");
+    }
+
+    void begin_key(std::string_view key)
+    {
+        if (!current_section.empty()) {
+            throw std::runtime_error("FLEWriter: end_section must be called before writing " + std::string(key));
+        }
+        put(has_keys ? ",\n    " : "{\n    ");
+        has_keys = true;
+        put_string(key);
+        put(": ");
+    }
+
+    void put_field(std::string_view key, std::string_view value, bool first)
+    {
+        put(first ? "\n            " : ",\n            ");
+        put_string(key);
+        put(": ");
+        put_string(value);
+    }
+    void put_field(std::string_view key, uint64_t value)
+    {
+        put(",\n            ");
+        put_string(key);
+        put(": ");
+        put_uint(value);
+    }
+
+    template <typename T, typename Fn>
+    void put_records(const std::vector<T>& records, Fn&& put_fields)
+    {
+        if (records.empty()) {
+            put("[]");
+            return;
+        }
+        for (size_t i = 0; i < records.size(); ++i) {
+            put(i == 0 ? "[\n        {" : ",\n        {");
+            put_fields(records[i]);
+            put("\n        }");
+        }
+        put("\n    ]");
+    }
+
+    void flush()
+    {
+        Stats::add(Counter::BytesWritten, buffer.size());
+        const char* data = buffer.data();
+        size_t left = buffer.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd, data, left);
+            Stats::add(Counter::FileSyscalls);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("FLEWriter: write to " + temp_filename + " failed: " + std::strerror(errno));
+            }
+            data += n;
+            left -= static_cast<size_t>(n);
+        }
+        buffer.clear();
+    }
+
+    std::string filename;
+    std::string temp_filename;
+    int fd = -1;
+    bool finished = false;
+    std::string buffer;
     std::string current_section;
-    json result;
-    std::vector<std::string> current_lines;
+    bool section_empty = true;
+    bool has_keys = false;
 };
 
 /**
@@ -258,6 +539,7 @@ inline std::vector<uint8_t> generate_plt_stub(int32_t got_offset)
 
 // Core functions that we provide
 FLEObject load_fle(const std::string& filename); // Load FLE file into memory
+FLEObject parse_fle(std::string_view content, const std::string& name); // Parse FLE text already in memory
 void FLE_cc(const std::vector<std::string>& args); // Compile source files to FLE
 
 // Functions for students to implement
@@ -286,18 +568,37 @@ void FLE_objdump(const FLEObject& obj, FLEWriter& writer);
  */
 void FLE_nm(const FLEObject& obj);
 
+struct ExecOptions {
+    std::string profileFile; // 采样剖析结果输出文件 (--profile)，为空则不剖析
+    bool profileFolded = false; // 输出折叠调用栈 (--profile-format folded)，否则输出平坦剖析
+    int profileHz = 1000; // 每秒 CPU 时间的采样次数 (--profile-hz)
+};
+
 /**
  * Execute an FLE executable file
  * @param obj The FLE executable object
+ * @param options Loader options; a profiled program runs in a child process
  * @throws runtime_error if the file is not executable or _start symbol is not found
  */
-void FLE_exec(const FLEObject& obj);
+void FLE_exec(const FLEObject& obj, const ExecOptions& options = {});
+
+// 共享库内对自身导出的 default 符号的引用如何绑定；命令行上最后出现的选项生效
+enum class SymbolBinding {
+    Default, // 直接绑定函数；数据可被抢占，只有被无法改道的引用访问的数据直接绑定（默认）
+    Direct, // 全部在链接时直接绑定 (-Bsymbolic)
+    Functions, // 只直接绑定函数，数据可被抢占 (-Bsymbolic-functions)
+    Interposable, // 全部可被抢占，经 PLT/GOT 或动态重定位访问 (-Bno-symbolic)
+};
 
 struct LinkerOptions {
     std::string outputFile = "a.out"; // 输出文件名 (用于设置 .so 的 name 属性)
     bool shared = false; // 是否生成共享库 (-shared)
     std::string entryPoint = "_start"; // 入口点名称 (默认为 _start)
     bool is_static = false; // 是否强制静态链接 (-static)
+    std::string mapFile; // 链接映射输出文件 (-Map)，为空则不输出
+    bool strip = false; // 可执行文件不输出符号表 (-s)
+    std::string versionScript; // 版本脚本 (--version-script)，限定共享库导出哪些符号
+    SymbolBinding binding = SymbolBinding::Default; // 共享库内对自身导出符号的引用如何绑定
 };
 
 /**
@@ -308,6 +609,32 @@ struct LinkerOptions {
  */
 FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& options);
 
+// Loads one ld input by path; load_fle, or the link server's cache
+using InputLoader = std::function<FLEObject(const std::string& path)>;
+
+/**
+ * The ld command line: parse args, load inputs through load, link and write
+ * the output
+ * @return The process exit status
+ */
+int FLE_ld_main(const std::vector<std::string>& args, const InputLoader& load);
+
+/**
+ * Run a link server on a Unix socket until `ld --serve-stop` is sent. Parsed
+ * inputs are kept in memory across links and reused while the file is unchanged.
+ * @return The process exit status
+ */
+int FLE_ld_serve(const std::string& socket_path);
+
+// Ask the link server on socket_path to exit
+int FLE_ld_serve_stop(const std::string& socket_path);
+
+/**
+ * Run one link on the server at socket_path, relaying its output
+ * @return The link's exit status, or nullopt if no server is listening
+ */
+std::optional<int> FLE_ld_remote(const std::string& socket_path, const std::vector<std::string>& args);
+
 /**
  * Read FLE object file
  * @param obj The FLE object to read
@@ -0,0 +1,327 @@
+#pragma once
+
+#ifndef HEX_HPP
+#define HEX_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FLE_HEX_SIMD 1
+#include <immintrin.h>
+#endif
+
+// ================= Hex Codec for 🔢 lines =================
+// Section data is stored as lowercase hex bytes separated by single spaces,
+// at most 16 bytes per line. The SIMD kernels handle exactly one full line;
+// short lines, tails and anything unusual go through the scalar code.
+
+constexpr size_t HEX_BLOCK_BYTES = 16; // Bytes per SIMD block (= one full line)
+constexpr size_t HEX_BLOCK_CHARS = 3 * HEX_BLOCK_BYTES - 1; // "hh hh ... hh"
+
+namespace hex_detail {
+
+constexpr char DIGITS[] = "0123456789abcdef";
+
+constexpr std::array<int8_t, 256> make_value_table()
+{
+    std::array<int8_t, 256> table {};
+    for (int c = 0; c < 256; ++c) {
+        table[c] = -1;
+    }
+    for (int d = 0; d < 10; ++d) {
+        table['0' + d] = static_cast<int8_t>(d);
+    }
+    for (int d = 0; d < 6; ++d) {
+        table['a' + d] = static_cast<int8_t>(10 + d);
+        table['A' + d] = static_cast<int8_t>(10 + d);
+    }
+    return table;
+}
+
+constexpr auto VALUE = make_value_table(); // ASCII -> nibble, -1 if not a hex digit
+
+inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+[[noreturn]] inline void invalid_byte(std::string_view text, size_t pos)
+{
+    size_t end = pos;
+    while (end < text.size() && !is_space(text[end])) {
+        ++end;
+    }
+    throw std::runtime_error("Invalid hex byte '" + std::string(text.substr(pos, end - pos)) + "' in data line");
+}
+
+} // namespace hex_detail
+
+// ================= Scalar (table-driven) =================
+
+/**
+ * Encode bytes as "hh hh ... hh"
+ * @param out Needs room for 3 * n chars
+ * @return Number of chars in the encoding (3 * n - 1, or 0 when n is 0)
+ */
+inline size_t hex_encode_scalar(const uint8_t* src, size_t n, char* out)
+{
+    for (size_t i = 0; i < n; ++i) {
+        out[3 * i] = hex_detail::DIGITS[src[i] >> 4];
+        out[3 * i + 1] = hex_detail::DIGITS[src[i] & 0xf];
+        out[3 * i + 2] = ' ';
+    }
+    return n == 0 ? 0 : 3 * n - 1;
+}
+
+/**
+ * Decode one whitespace-separated token of one or two hex digits
+ * @return Position just past the token
+ * @throws runtime_error if the token is not a hex byte
+ */
+inline size_t hex_decode_token(std::string_view text, size_t pos, std::vector<uint8_t>& out)
+{
+    int hi = hex_detail::VALUE[static_cast<uint8_t>(text[pos])];
+    if (hi < 0) {
+        hex_detail::invalid_byte(text, pos);
+    }
+    size_t next = pos + 1;
+    if (next < text.size() && !hex_detail::is_space(text[next])) {
+        int lo = hex_detail::VALUE[static_cast<uint8_t>(text[next])];
+        if (lo < 0 || (next + 1 < text.size() && !hex_detail::is_space(text[next + 1]))) {
+            hex_detail::invalid_byte(text, pos);
+        }
+        out.push_back(static_cast<uint8_t>(hi << 4 | lo));
+        return next + 1;
+    }
+    out.push_back(static_cast<uint8_t>(hi));
+    return next;
+}
+
+// Decode whitespace-separated hex bytes, appending them to out
+inline void hex_decode_scalar(std::string_view text, std::vector<uint8_t>& out)
+{
+    size_t pos = 0;
+    while (true) {
+        while (pos < text.size() && hex_detail::is_space(text[pos])) {
+            ++pos;
+        }
+        if (pos == text.size()) {
+            return;
+        }
+        pos = hex_decode_token(text, pos, out);
+    }
+}
+
+// ================= SSSE3 =================
+
+#ifdef FLE_HEX_SIMD
+
+namespace hex_detail {
+
+using ShuffleTable = std::array<int8_t, 16>;
+
+// Encode: output chars [16 * k, 16 * k + 16) taken from the (hi, lo) digit
+// pairs of bytes 0-7 (first_half) or 8-15; -128 selects zero
+constexpr ShuffleTable encode_shuffle(int k, bool first_half)
+{
+    ShuffleTable t {};
+    for (int j = 0; j < 16; ++j) {
+        int p = 16 * k + j;
+        int b = p / 3;
+        int r = p % 3;
+        bool mine = first_half ? b < 8 : b >= 8;
+        t[j] = static_cast<int8_t>(r < 2 && mine ? 2 * (b % 8) + r : -128);
+    }
+    return t;
+}
+
+constexpr ShuffleTable encode_spaces(int k)
+{
+    ShuffleTable t {};
+    for (int j = 0; j < 16; ++j) {
+        t[j] = (16 * k + j) % 3 == 2 ? ' ' : 0;
+    }
+    return t;
+}
+
+// Decode: the 47 input chars are loaded as [0, 16), [16, 32) and [31, 47)
+constexpr int DECODE_LOAD_OFFSET[3] = { 0, 16, 31 };
+
+// Gather char 3 * b + r of every byte b from load k; -128 where another load has it
+constexpr ShuffleTable decode_shuffle(int k, int r)
+{
+    ShuffleTable t {};
+    for (int b = 0; b < 16; ++b) {
+        int p = 3 * b + r;
+        int owner = p < 16 ? 0 : (p < 32 ? 1 : 2);
+        bool valid = !(r == 2 && b == 15); // There is no separator after the last byte
+        t[b] = static_cast<int8_t>(valid && owner == k ? p - DECODE_LOAD_OFFSET[k] : -128);
+    }
+    return t;
+}
+
+constexpr ShuffleTable ENCODE_A[3] = { encode_shuffle(0, true), encode_shuffle(1, true), encode_shuffle(2, true) };
+constexpr ShuffleTable ENCODE_B[3] = { encode_shuffle(0, false), encode_shuffle(1, false), encode_shuffle(2, false) };
+constexpr ShuffleTable ENCODE_SPACES[3] = { encode_spaces(0), encode_spaces(1), encode_spaces(2) };
+constexpr ShuffleTable DECODE[3][3] = {
+    { decode_shuffle(0, 0), decode_shuffle(1, 0), decode_shuffle(2, 0) },
+    { decode_shuffle(0, 1), decode_shuffle(1, 1), decode_shuffle(2, 1) },
+    { decode_shuffle(0, 2), decode_shuffle(1, 2), decode_shuffle(2, 2) },
+};
+
+__attribute__((target("ssse3"))) inline __m128i load_table(const ShuffleTable& t)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.data()));
+}
+
+// ASCII hex digits -> nibbles; clears the matching bit of *valid for anything else
+__attribute__((target("ssse3"))) inline __m128i decode_nibbles(__m128i c, __m128i& valid)
+{
+    const __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    const __m128i alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    const __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+    valid = _mm_and_si128(valid, _mm_or_si128(is_digit, is_alpha));
+    return _mm_or_si128(_mm_and_si128(is_digit, digit),
+        _mm_and_si128(is_alpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+}
+
+} // namespace hex_detail
+
+/**
+ * Encode exactly 16 bytes
+ * @param out Needs room for 48 chars; the last one is a trailing space
+ */
+__attribute__((target("ssse3"))) inline void hex_encode_block_ssse3(const uint8_t* src, char* out)
+{
+    using namespace hex_detail;
+    const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(DIGITS));
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    const __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, mask));
+    const __m128i a = _mm_unpacklo_epi8(hi, lo); // Digit pairs of bytes 0-7
+    const __m128i b = _mm_unpackhi_epi8(hi, lo); // Digit pairs of bytes 8-15
+    for (int k = 0; k < 3; ++k) {
+        __m128i chars = _mm_or_si128(_mm_shuffle_epi8(a, load_table(ENCODE_A[k])),
+            _mm_shuffle_epi8(b, load_table(ENCODE_B[k])));
+        chars = _mm_or_si128(chars, load_table(ENCODE_SPACES[k]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * k), chars);
+    }
+}
+
+/**
+ * Decode exactly one canonical 16-byte block "hh hh ... hh" (47 chars)
+ * @return false, writing nothing, if the block is not in canonical form
+ */
+__attribute__((target("ssse3"))) inline bool hex_decode_block_ssse3(const char* text, uint8_t* dst)
+{
+    using namespace hex_detail;
+    __m128i in[3];
+    for (int k = 0; k < 3; ++k) {
+        in[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + DECODE_LOAD_OFFSET[k]));
+    }
+    __m128i gathered[3];
+    for (int r = 0; r < 3; ++r) {
+        gathered[r] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(in[0], load_table(DECODE[r][0])),
+                                       _mm_shuffle_epi8(in[1], load_table(DECODE[r][1]))),
+            _mm_shuffle_epi8(in[2], load_table(DECODE[r][2])));
+    }
+    // Separators must be spaces; lane 15 has none and is forced to match
+    const __m128i last_lane = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ' ');
+    __m128i valid = _mm_cmpeq_epi8(_mm_or_si128(gathered[2], last_lane), _mm_set1_epi8(' '));
+    const __m128i hi = decode_nibbles(gathered[0], valid);
+    const __m128i lo = decode_nibbles(gathered[1], valid);
+    if (_mm_movemask_epi8(valid) != 0xffff) {
+        return false;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(_mm_slli_epi16(hi, 4), lo));
+    return true;
+}
+
+inline bool hex_simd_available()
+{
+    static const bool available = (__builtin_cpu_init(), __builtin_cpu_supports("ssse3"));
+    return available;
+}
+
+#else
+
+inline bool hex_simd_available()
+{
+    return false;
+}
+
+#endif
+
+// ================= Dispatch =================
+
+/**
+ * Encode bytes as "hh hh ... hh", using SSSE3 for full 16-byte blocks when
+ * the CPU supports it
+ * @param out Needs room for 3 * n chars
+ * @return Number of chars in the encoding
+ */
+inline size_t hex_encode(const uint8_t* src, size_t n, char* out)
+{
+    size_t done = 0;
+#ifdef FLE_HEX_SIMD
+    if (hex_simd_available()) {
+        // Each block also writes the separator that precedes the next one
+        for (; n - done >= HEX_BLOCK_BYTES; done += HEX_BLOCK_BYTES) {
+            hex_encode_block_ssse3(src + done, out + 3 * done);
+        }
+        if (done == n) {
+            return n == 0 ? 0 : 3 * n - 1;
+        }
+    }
+#endif
+    hex_encode_scalar(src + done, n - done, out + 3 * done);
+    return n == 0 ? 0 : 3 * n - 1;
+}
+
+/**
+ * Decode whitespace-separated hex bytes, appending them to out. Canonical
+ * 16-byte runs take the SSSE3 path; everything else is decoded token by token.
+ * @throws runtime_error on anything that is not a one- or two-digit hex byte
+ */
+inline void hex_decode(std::string_view text, std::vector<uint8_t>& out)
+{
+#ifdef FLE_HEX_SIMD
+    if (!hex_simd_available()) {
+        hex_decode_scalar(text, out);
+        return;
+    }
+    size_t pos = 0;
+    while (true) {
+        while (pos < text.size() && hex_detail::is_space(text[pos])) {
+            ++pos;
+        }
+        if (pos == text.size()) {
+            return;
+        }
+        size_t left = text.size() - pos;
+        if (left >= HEX_BLOCK_CHARS && (left == HEX_BLOCK_CHARS || hex_detail::is_space(text[pos + HEX_BLOCK_CHARS]))) {
+            size_t old_size = out.size();
+            out.resize(old_size + HEX_BLOCK_BYTES);
+            if (hex_decode_block_ssse3(text.data() + pos, out.data() + old_size)) {
+                pos += HEX_BLOCK_CHARS;
+                continue;
+            }
+            out.resize(old_size);
+        }
+        pos = hex_decode_token(text, pos, out);
+    }
+#else
+    hex_decode_scalar(text, out);
+#endif
+}
+
+#endif
@@ -0,0 +1,202 @@
+#pragma once
+
+#ifndef INTERN_HPP
+#define INTERN_HPP
+
+#include "arena.hpp"
+#include "stats.hpp"
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One interned string; lives as long as the StringInterner that holds it
+struct InternEntry {
+    std::string_view text;
+    size_t hash;
+};
+
+/**
+ * Handle to a string stored once by a StringInterner. Two handles from the
+ * same interner are equal exactly when they point at the same entry, and the hash is
+ * computed once at interning time, so handles are cheap keys for hash maps.
+ * Converts implicitly to std::string_view for reading.
+ */
+class InternedString {
+public:
+    InternedString()
+        : entry(&EMPTY)
+    {
+    }
+
+    std::string_view view() const { return entry->text; }
+    operator std::string_view() const { return entry->text; }
+    size_t hash() const { return entry->hash; }
+    bool empty() const { return entry->text.empty(); }
+    size_t size() const { return entry->text.size(); }
+    const char* data() const { return entry->text.data(); }
+
+    friend bool operator==(InternedString a, InternedString b) { return a.entry == b.entry; }
+    friend bool operator!=(InternedString a, InternedString b) { return a.entry != b.entry; }
+    friend bool operator==(InternedString a, std::string_view b) { return a.view() == b; }
+    friend bool operator!=(InternedString a, std::string_view b) { return a.view() != b; }
+    friend bool operator==(std::string_view a, InternedString b) { return a == b.view(); }
+    friend bool operator!=(std::string_view a, InternedString b) { return a != b.view(); }
+    friend bool operator==(InternedString a, const char* b) { return a.view() == b; }
+    friend bool operator!=(InternedString a, const char* b) { return a.view() != b; }
+    friend bool operator==(InternedString a, const std::string& b) { return a.view() == b; }
+    friend bool operator!=(InternedString a, const std::string& b) { return a.view() != b; }
+    // Orders by text, so ordered containers iterate deterministically
+    friend bool operator<(InternedString a, InternedString b) { return a.entry != b.entry && a.view() < b.view(); }
+
+    friend std::ostream& operator<<(std::ostream& os, InternedString s) { return os << s.view(); }
+    friend std::string operator+(const std::string& a, InternedString b) { return a + std::string(b.view()); }
+    friend std::string operator+(const char* a, InternedString b) { return a + std::string(b.view()); }
+
+private:
+    friend class StringInterner;
+
+    explicit InternedString(const InternEntry* entry)
+        : entry(entry)
+    {
+    }
+
+    static inline const InternEntry EMPTY { {}, std::hash<std::string_view> {}({}) };
+
+    const InternEntry* entry;
+};
+
+template <>
+struct std::hash<InternedString> {
+    size_t operator()(InternedString s) const noexcept { return s.hash(); }
+};
+
+/**
+ * String table shared by everything parsed in one generation. Lookups are
+ * split over independently locked shards, each an open-addressing table whose
+ * text lives in an Arena.
+ *
+ * intern() fills the current generation. Every FLEObject holds a reference to
+ * the generation its names came from, which keeps them valid. The current
+ * generation is never freed, so one-shot tools keep every name until exit; a
+ * long-running process such as the link server starts a new generation with
+ * renew(), and the old one's arenas go with the last object that refers to it.
+ */
+class StringInterner {
+public:
+    // The generation intern() fills
+    static const std::shared_ptr<StringInterner>& current() { return generation(); }
+
+    /**
+     * Make later intern() calls fill a fresh interner. Handles from different
+     * generations never compare equal, so objects used together must not
+     * straddle a renewal. Must not run concurrently with intern().
+     */
+    static void renew() { generation().reset(new StringInterner); }
+
+    InternedString intern(std::string_view text)
+    {
+        if (text.empty()) {
+            return {};
+        }
+        size_t hash = std::hash<std::string_view> {}(text);
+        // The top bits pick the shard and the low bits the slot, so a shard's
+        // entries are spread over all of its slots
+        Shard& shard = shards[hash >> (std::numeric_limits<size_t>::digits - SHARD_BITS)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        if (shard.slots.empty()) {
+            shard.slots.assign(INITIAL_SLOTS, nullptr);
+        }
+        size_t mask = shard.slots.size() - 1;
+        size_t probes = 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask, ++probes) {
+            const InternEntry* entry = shard.slots[i];
+            if (entry == nullptr) {
+                break;
+            }
+            if (entry->hash == hash && entry->text == text) {
+                Stats::add(Counter::InternLookups);
+                Stats::add(Counter::InternProbes, probes);
+                return InternedString(entry);
+            }
+        }
+        Stats::add(Counter::InternLookups);
+        Stats::add(Counter::InternProbes, probes);
+
+        auto* entry = static_cast<InternEntry*>(shard.arena.allocate(sizeof(InternEntry), alignof(InternEntry)));
+        new (entry) InternEntry { shard.arena.store(text), hash };
+        if (2 * (shard.count + 1) > shard.slots.size()) {
+            rehash(shard);
+        }
+        insert_slot(shard.slots, entry);
+        ++shard.count;
+        return InternedString(entry);
+    }
+
+    size_t size() const
+    {
+        size_t total = 0;
+        for (const auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total += shard.count;
+        }
+        return total;
+    }
+
+private:
+    static constexpr size_t SHARD_BITS = 4;
+    static constexpr size_t SHARD_COUNT = size_t(1) << SHARD_BITS;
+    static constexpr size_t INITIAL_SLOTS = 1024;
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::vector<const InternEntry*> slots; // Power-of-two sized, at most half full
+        size_t count = 0;
+        Arena arena;
+    };
+
+    StringInterner() = default;
+
+    static std::shared_ptr<StringInterner>& generation()
+    {
+        static std::shared_ptr<StringInterner> instance(new StringInterner);
+        return instance;
+    }
+
+    static void insert_slot(std::vector<const InternEntry*>& slots, const InternEntry* entry)
+    {
+        size_t mask = slots.size() - 1;
+        size_t i = entry->hash & mask;
+        while (slots[i] != nullptr) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = entry;
+    }
+
+    static void rehash(Shard& shard)
+    {
+        std::vector<const InternEntry*> grown(shard.slots.size() * 2, nullptr);
+        for (const InternEntry* entry : shard.slots) {
+            if (entry != nullptr) {
+                insert_slot(grown, entry);
+            }
+        }
+        shard.slots.swap(grown);
+    }
+
+    std::array<Shard, SHARD_COUNT> shards;
+};
+
+inline InternedString intern(std::string_view text)
+{
+    return StringInterner::current()->intern(text);
+}
+
+#endif
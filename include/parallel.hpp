@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Number of worker threads to use: $FLE_THREADS if set (1 disables
+ * threading), otherwise the number of hardware threads
+ */
+inline size_t default_thread_count()
+{
+    static const size_t count = [] {
+        if (const char* env = std::getenv("FLE_THREADS")) {
+            long n = std::strtol(env, nullptr, 10);
+            if (n > 0) {
+                return static_cast<size_t>(n);
+            }
+        }
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }();
+    return count;
+}
+
+/**
+ * Run fn(i) for every i in [0, n). Items are handed out dynamically to up to
+ * default_thread_count() threads, the caller being one of them. fn must only
+ * touch state that no other item touches.
+ * @throws The first exception thrown by fn, after all workers have stopped
+ */
+template <typename Fn>
+void parallel_for(size_t n, Fn&& fn)
+{
+    size_t workers = std::min(n, default_thread_count());
+    if (workers <= 1) {
+        for (size_t i = 0; i < n; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next { 0 };
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto work = [&] {
+        for (size_t i = next++; i < n; i = next++) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = n; // Stop handing out items
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t t = 1; t < workers; ++t) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+#endif
@@ -0,0 +1,419 @@
+#pragma once
+
+#ifndef RELOC_HPP
+#define RELOC_HPP
+
+#include "fle.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// ================= Relocation Traits =================
+// One specialisation per RelocationType. Everything that needs to know how a
+// relocation type behaves (size, addressing mode, FLE tag) reads it from here.
+
+template <RelocationType T>
+struct RelocTraits;
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_32> {
+    static constexpr std::string_view name = "R_X86_64_32";
+    static constexpr std::string_view tag = ".abs";
+    static constexpr std::string_view dyn_tag = ".dynabs32";
+    static constexpr size_t size = 4;
+    static constexpr bool pc_relative = false;
+    static constexpr bool is_signed = false;
+    static constexpr int64_t min = 0;
+    static constexpr int64_t max = std::numeric_limits<uint32_t>::max();
+    static constexpr std::string_view overflow_hint = "recompile with -fPIE/-fPIC, or place the target below 4GB";
+};
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_PC32> {
+    static constexpr std::string_view name = "R_X86_64_PC32";
+    static constexpr std::string_view tag = ".rel";
+    static constexpr std::string_view dyn_tag = ".dynrel";
+    static constexpr size_t size = 4;
+    static constexpr bool pc_relative = true;
+    static constexpr bool is_signed = true;
+    static constexpr int64_t min = std::numeric_limits<int32_t>::min();
+    static constexpr int64_t max = std::numeric_limits<int32_t>::max();
+    static constexpr std::string_view overflow_hint = "calls can go through a range-extension thunk; data needs -fPIC (GOT) access";
+};
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_64> {
+    static constexpr std::string_view name = "R_X86_64_64";
+    static constexpr std::string_view tag = ".abs64";
+    static constexpr std::string_view dyn_tag = ".dynabs64";
+    static constexpr size_t size = 8;
+    static constexpr bool pc_relative = false;
+    static constexpr bool is_signed = false;
+    static constexpr int64_t min = std::numeric_limits<int64_t>::min();
+    static constexpr int64_t max = std::numeric_limits<int64_t>::max();
+    static constexpr std::string_view overflow_hint = "";
+};
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_32S> {
+    static constexpr std::string_view name = "R_X86_64_32S";
+    static constexpr std::string_view tag = ".abs32s";
+    static constexpr std::string_view dyn_tag = ".dynabs32"; // No signed dynamic tag in FLE
+    static constexpr size_t size = 4;
+    static constexpr bool pc_relative = false;
+    static constexpr bool is_signed = true;
+    static constexpr int64_t min = std::numeric_limits<int32_t>::min();
+    static constexpr int64_t max = std::numeric_limits<int32_t>::max();
+    static constexpr std::string_view overflow_hint = "recompile with -fPIE/-fPIC, or place the target within +-2GB of address 0";
+};
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_GOTPCREL> {
+    static constexpr std::string_view name = "R_X86_64_GOTPCREL";
+    static constexpr std::string_view tag = ".gotpcrel";
+    static constexpr std::string_view dyn_tag = ""; // Never emitted as a dynamic relocation
+    static constexpr size_t size = 4;
+    static constexpr bool pc_relative = true;
+    static constexpr bool is_signed = true;
+    static constexpr int64_t min = std::numeric_limits<int32_t>::min();
+    static constexpr int64_t max = std::numeric_limits<int32_t>::max();
+    static constexpr std::string_view overflow_hint = "the GOT must be placed within +-2GB of the referencing code";
+};
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_GOTPCRELX> : RelocTraits<RelocationType::R_X86_64_GOTPCREL> {
+    static constexpr std::string_view name = "R_X86_64_GOTPCRELX";
+    static constexpr std::string_view tag = ".gotpcrelx";
+};
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_REX_GOTPCRELX> : RelocTraits<RelocationType::R_X86_64_GOTPCREL> {
+    static constexpr std::string_view name = "R_X86_64_REX_GOTPCRELX";
+    static constexpr std::string_view tag = ".rexgotpcrelx";
+};
+
+// The executable's slot for a shared library data object. The loader fills the
+// whole slot from the library's definition after relocation; the 8-byte field
+// is only the slot's start, so it stays inline like other dynamic relocations.
+template <>
+struct RelocTraits<RelocationType::R_X86_64_COPY> : RelocTraits<RelocationType::R_X86_64_64> {
+    static constexpr std::string_view name = "R_X86_64_COPY";
+    static constexpr std::string_view tag = ""; // Never in an object file
+    static constexpr std::string_view dyn_tag = ".dyncopy";
+};
+
+// TLS relocations go through the same engine: whoever resolves them passes the
+// variable's offset from the thread pointer (TPOFF) or from the start of its
+// module's TLS block (DTPOFF) as S, so the value is still S + A (- P).
+template <>
+struct RelocTraits<RelocationType::R_X86_64_TPOFF32> : RelocTraits<RelocationType::R_X86_64_32S> {
+    static constexpr std::string_view name = "R_X86_64_TPOFF32";
+    static constexpr std::string_view tag = ".tpoff32";
+    static constexpr std::string_view dyn_tag = ""; // Local-exec only exists in executables
+    static constexpr std::string_view overflow_hint = "the thread-local data must stay within 2GB below the thread pointer";
+};
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_GOTTPOFF> : RelocTraits<RelocationType::R_X86_64_GOTPCREL> {
+    static constexpr std::string_view name = "R_X86_64_GOTTPOFF";
+    static constexpr std::string_view tag = ".gottpoff";
+};
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_TPOFF64> : RelocTraits<RelocationType::R_X86_64_64> {
+    static constexpr std::string_view name = "R_X86_64_TPOFF64";
+    static constexpr std::string_view tag = ".tpoff64";
+    static constexpr std::string_view dyn_tag = ".dyntpoff64";
+};
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_DTPOFF32> : RelocTraits<RelocationType::R_X86_64_32S> {
+    static constexpr std::string_view name = "R_X86_64_DTPOFF32";
+    static constexpr std::string_view tag = ".dtpoff32";
+    static constexpr std::string_view dyn_tag = ""; // Known at link time
+    static constexpr std::string_view overflow_hint = "";
+};
+
+template <>
+struct RelocTraits<RelocationType::R_X86_64_DTPOFF64> : RelocTraits<RelocationType::R_X86_64_64> {
+    static constexpr std::string_view name = "R_X86_64_DTPOFF64";
+    static constexpr std::string_view tag = ".dtpoff64";
+    static constexpr std::string_view dyn_tag = ""; // Known at link time
+};
+
+// Number of RelocationType enumerators; must be kept in sync with the enum
+constexpr size_t RELOC_TYPE_COUNT = static_cast<size_t>(RelocationType::R_X86_64_DTPOFF64) + 1;
+
+// ================= Runtime Lookup Table =================
+
+// Runtime view of RelocTraits, for code that only has a RelocationType value
+struct RelocInfo {
+    RelocationType type;
+    std::string_view name; // ELF name, e.g. "R_X86_64_PC32"
+    std::string_view tag; // FLE tag, e.g. ".rel"
+    std::string_view dyn_tag; // FLE tag as a dynamic relocation, empty if not allowed
+    size_t size; // Bytes written
+    bool pc_relative; // Value is S + A - P instead of S + A
+    bool is_signed; // Field is interpreted as a signed integer
+    int64_t min; // Smallest value that fits in the field
+    int64_t max; // Largest value that fits in the field
+    std::string_view overflow_hint; // Suggested fix when a value does not fit
+};
+
+template <RelocationType T>
+constexpr RelocInfo make_reloc_info()
+{
+    using Traits = RelocTraits<T>;
+    return { T, Traits::name, Traits::tag, Traits::dyn_tag, Traits::size,
+        Traits::pc_relative, Traits::is_signed, Traits::min, Traits::max, Traits::overflow_hint };
+}
+
+template <size_t... I>
+constexpr std::array<RelocInfo, sizeof...(I)> make_reloc_table(std::index_sequence<I...>)
+{
+    return { make_reloc_info<static_cast<RelocationType>(I)>()... };
+}
+
+constexpr auto RELOC_TABLE = make_reloc_table(std::make_index_sequence<RELOC_TYPE_COUNT> {});
+
+inline const RelocInfo& reloc_info(RelocationType type)
+{
+    return RELOC_TABLE[static_cast<size_t>(type)];
+}
+
+// ================= Relocation Engine =================
+
+// A resolved relocation: everything needed to compute and store the value
+struct RelocJob {
+    uint8_t* loc; // Where the value is written
+    uint64_t S; // Symbol (or GOT/PLT entry) address
+    int64_t A; // Addend
+    uint64_t P; // Address of the relocated field
+};
+
+template <RelocationType T>
+constexpr uint64_t reloc_value(uint64_t S, int64_t A, uint64_t P)
+{
+    if constexpr (RelocTraits<T>::pc_relative) {
+        return S + A - P;
+    } else {
+        return S + A;
+    }
+}
+
+// Where a relocation came from, reported when its value does not fit
+struct RelocSite {
+    std::string_view object; // Input object or loaded module name
+    std::string_view section; // Section containing the field
+    std::string_view symbol; // Symbol being referenced
+    uint64_t offset; // Offset of the field within the section
+};
+
+template <RelocationType T>
+constexpr bool reloc_fits(uint64_t val)
+{
+    using Traits = RelocTraits<T>;
+    if constexpr (Traits::size == 8) {
+        return true;
+    } else {
+        auto v = static_cast<int64_t>(val);
+        return v >= Traits::min && v <= Traits::max;
+    }
+}
+
+// Range check over a whole group; the common case is zero. Deliberately scalar:
+// jobs are 32-byte (loc, S, A, P) records, and an AVX2 version transposing four
+// of them per step measured no faster than this branch-free loop
+template <RelocationType T>
+inline size_t count_overflows(const std::vector<RelocJob>& jobs)
+{
+    if constexpr (RelocTraits<T>::size == 8) {
+        return 0;
+    } else {
+        size_t bad = 0;
+        for (const auto& job : jobs) {
+            bad += !reloc_fits<T>(reloc_value<T>(job.S, job.A, job.P));
+        }
+        return bad;
+    }
+}
+
+inline std::string format_signed_hex(int64_t v)
+{
+    std::ostringstream ss;
+    if (v < 0) {
+        ss << "-0x" << std::hex << (~static_cast<uint64_t>(v) + 1);
+    } else {
+        ss << "0x" << std::hex << v;
+    }
+    return ss.str();
+}
+
+template <RelocationType T>
+inline void report_overflows(const std::vector<RelocJob>& jobs, const std::vector<RelocSite>& sites, std::string& out)
+{
+    using Traits = RelocTraits<T>;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        uint64_t val = reloc_value<T>(jobs[i].S, jobs[i].A, jobs[i].P);
+        if (reloc_fits<T>(val)) {
+            continue;
+        }
+        const auto& site = sites[i];
+        std::ostringstream ss;
+        ss << site.object << ":" << site.section << "+0x" << std::hex << site.offset << ": relocation "
+           << Traits::name << " against '" << site.symbol << "' out of range: "
+           << format_signed_hex(static_cast<int64_t>(val)) << " is not in ["
+           << format_signed_hex(Traits::min) << ", " << format_signed_hex(Traits::max) << "]";
+        if (!Traits::overflow_hint.empty()) {
+            ss << "; " << Traits::overflow_hint;
+        }
+        if (!out.empty()) {
+            out += "\n";
+        }
+        out += ss.str();
+    }
+}
+
+/**
+ * Make sure a relocated field lies within its section's data
+ * @param pos Offset of the field in the buffer holding the section
+ * @throws runtime_error naming the site when the field sticks out
+ */
+inline void check_reloc_bounds(RelocationType type, const RelocSite& site, size_t pos, size_t buffer_size)
+{
+    const RelocInfo& info = reloc_info(type);
+    if (pos <= buffer_size && info.size <= buffer_size - pos) {
+        return;
+    }
+    std::ostringstream ss;
+    ss << site.object << ":" << site.section << "+0x" << std::hex << site.offset << ": relocation "
+       << info.name << " against '" << site.symbol << "' offset out of range: " << std::dec << info.size
+       << "-byte field at 0x" << std::hex << pos << " does not fit in 0x" << buffer_size << " bytes";
+    throw std::runtime_error(ss.str());
+}
+
+template <RelocationType T>
+inline void apply_relocs(const RelocJob* begin, const RelocJob* end)
+{
+    for (const RelocJob* job = begin; job != end; ++job) {
+        uint64_t val = reloc_value<T>(job->S, job->A, job->P);
+        // x86-64 is little-endian, so the low bytes come first
+        std::memcpy(job->loc, &val, RelocTraits<T>::size);
+    }
+}
+
+using RelocApplyFn = void (*)(const RelocJob*, const RelocJob*);
+
+template <size_t... I>
+constexpr std::array<RelocApplyFn, sizeof...(I)> make_apply_table(std::index_sequence<I...>)
+{
+    return { &apply_relocs<static_cast<RelocationType>(I)>... };
+}
+
+// apply_relocs<T> for every RelocationType, indexed by type
+constexpr auto RELOC_APPLY_TABLE = make_apply_table(std::make_index_sequence<RELOC_TYPE_COUNT> {});
+
+/**
+ * Collects resolved relocations grouped by type and applies each group with
+ * a loop specialised for that type, so there is no per-relocation dispatch.
+ */
+class RelocBatch {
+public:
+    void add(RelocationType type, const RelocJob& job, const RelocSite& site)
+    {
+        jobs[static_cast<size_t>(type)].push_back(job);
+        sites[static_cast<size_t>(type)].push_back(site);
+    }
+
+    // Move other's relocations in after this batch's own, keeping their order
+    void merge(RelocBatch&& other)
+    {
+        for (size_t i = 0; i < RELOC_TYPE_COUNT; ++i) {
+            jobs[i].insert(jobs[i].end(), other.jobs[i].begin(), other.jobs[i].end());
+            sites[i].insert(sites[i].end(), other.sites[i].begin(), other.sites[i].end());
+            other.jobs[i].clear();
+            other.sites[i].clear();
+        }
+    }
+
+    /**
+     * Check every value against its field range
+     * @throws runtime_error listing each relocation that does not fit
+     */
+    void check() const
+    {
+        std::string errors;
+        check_all(std::make_index_sequence<RELOC_TYPE_COUNT> {}, errors);
+        if (!errors.empty()) {
+            throw std::runtime_error(errors);
+        }
+    }
+
+    /**
+     * Validate, then write; nothing is written if any value overflows.
+     * Large groups are split into chunks written by worker threads, so every
+     * job must target a distinct field.
+     */
+    void apply()
+    {
+        check();
+        struct Chunk {
+            size_t type;
+            size_t begin;
+            size_t end;
+        };
+        std::vector<Chunk> chunks;
+        size_t total = 0;
+        for (size_t i = 0; i < RELOC_TYPE_COUNT; ++i) {
+            total += jobs[i].size();
+            for (size_t begin = 0; begin < jobs[i].size(); begin += CHUNK_SIZE) {
+                chunks.push_back({ i, begin, std::min(begin + CHUNK_SIZE, jobs[i].size()) });
+            }
+        }
+        Stats::add(Counter::RelocsApplied, total);
+        auto apply_chunk = [&](size_t k) {
+            const auto& chunk = chunks[k];
+            const RelocJob* base = jobs[chunk.type].data();
+            RELOC_APPLY_TABLE[chunk.type](base + chunk.begin, base + chunk.end);
+        };
+        if (total > CHUNK_SIZE) {
+            parallel_for(chunks.size(), apply_chunk);
+        } else {
+            for (size_t k = 0; k < chunks.size(); ++k) {
+                apply_chunk(k);
+            }
+        }
+        for (size_t i = 0; i < RELOC_TYPE_COUNT; ++i) {
+            jobs[i].clear();
+            sites[i].clear();
+        }
+    }
+
+private:
+    template <size_t... I>
+    void check_all(std::index_sequence<I...>, std::string& errors) const
+    {
+        // Only groups with at least one overflow pay for the diagnostic pass
+        ((count_overflows<static_cast<RelocationType>(I)>(jobs[I]) != 0
+             ? report_overflows<static_cast<RelocationType>(I)>(jobs[I], sites[I], errors)
+             : void()),
+            ...);
+    }
+
+    // Jobs per chunk; batches smaller than this are applied on the calling thread
+    static constexpr size_t CHUNK_SIZE = 16384;
+
+    std::array<std::vector<RelocJob>, RELOC_TYPE_COUNT> jobs;
+    std::array<std::vector<RelocSite>, RELOC_TYPE_COUNT> sites;
+};
+
+#endif
@@ -0,0 +1,177 @@
+#pragma once
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include "trace.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+
+enum class Counter : size_t {
+    BytesRead,
+    BytesWritten,
+    FileSyscalls,
+    MemorySyscalls,
+    ObjectsLoaded,
+    SectionsLoaded,
+    SymbolsLoaded,
+    RelocsLoaded,
+    RelocsApplied,
+    InternLookups,
+    InternProbes,
+    Allocations,
+    AllocatedBytes,
+    COUNT
+};
+
+inline constexpr const char* COUNTER_NAMES[] = {
+    "bytes_read",
+    "bytes_written",
+    "file_syscalls", // open/stat/read/write/getdents/close issued by FLE's own file I/O
+    "memory_syscalls", // mmap/mprotect issued by exec to map and protect modules
+    "objects_loaded",
+    "sections_loaded",
+    "symbols_loaded",
+    "relocs_loaded",
+    "relocs_applied",
+    "intern_lookups",
+    "intern_probes",
+    "allocations",
+    "allocated_bytes",
+};
+static_assert(std::size(COUNTER_NAMES) == static_cast<size_t>(Counter::COUNT));
+
+/**
+ * Process-wide cost counters behind `--stats` / $FLE_STATS. Phase times come
+ * from the TraceScopes already in the tools. While disabled, add() is a single
+ * branch, so the calls stay compiled in everywhere, including operator new.
+ *
+ * $FLE_STATS=1 prints a table to stderr at exit; any other value except 0 is
+ * a file that gets one JSON object appended per run.
+ */
+class Stats {
+public:
+    static void add(Counter counter, uint64_t n = 1)
+    {
+        if (enabled) {
+            counters[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    static bool is_enabled() { return enabled; }
+
+    static uint64_t value(Counter counter)
+    {
+        return counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    }
+
+    // Turn on counting and phase timing for this run; the report is written at exit
+    static void enable(std::string_view tool_name, std::string json_file = {})
+    {
+        if (enabled) {
+            return;
+        }
+        tool() = tool_name;
+        output_file() = std::move(json_file);
+        start_time() = TimeTrace::clock::now();
+        TimeTrace::get().enable();
+        enabled = true;
+        std::atexit([] { report(); });
+    }
+
+    // Enable from $FLE_STATS when set to anything but "" or "0"
+    static void enable_from_env(std::string_view tool_name)
+    {
+        const char* env = std::getenv("FLE_STATS");
+        if (env == nullptr || *env == '\0' || std::string_view(env) == "0") {
+            return;
+        }
+        enable(tool_name, std::string_view(env) == "1" ? std::string() : std::string(env));
+    }
+
+    // Write the report once; called at exit, or by tools that never return to main
+    static void report()
+    {
+        if (!enabled || reported) {
+            return;
+        }
+        reported = true;
+
+        auto now = TimeTrace::clock::now();
+        double wall_ms = std::chrono::duration<double, std::milli>(now - start_time()).count();
+        auto phases = TimeTrace::get().phase_totals();
+        rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        uint64_t peak_rss_kb = static_cast<uint64_t>(usage.ru_maxrss);
+
+        if (output_file().empty()) {
+            std::ostream& os = std::cerr;
+            auto key = [&](const std::string& name) -> std::ostream& {
+                return os << name << std::string(name.size() < KEY_WIDTH ? KEY_WIDTH - name.size() : 1, ' ');
+            };
+            os << "=== stats: " << tool() << " ===\n"
+               << std::fixed << std::setprecision(3);
+            key("wall") << wall_ms << " ms\n";
+            for (const auto& phase : phases) {
+                key("phase " + phase.name) << phase.total_us / 1000.0 << " ms";
+                if (phase.count > 1) {
+                    os << " (" << phase.count << "x)";
+                }
+                os << '\n';
+            }
+            for (size_t i = 0; i < static_cast<size_t>(Counter::COUNT); ++i) {
+                key(COUNTER_NAMES[i]) << counters[i].load(std::memory_order_relaxed) << '\n';
+            }
+            key("peak_rss_kb") << peak_rss_kb << '\n';
+            return;
+        }
+
+        json result;
+        result["tool"] = tool();
+        result["wall_ms"] = wall_ms;
+        result["phases_ms"] = json::object();
+        for (const auto& phase : phases) {
+            result["phases_ms"][phase.name] = phase.total_us / 1000.0;
+        }
+        for (size_t i = 0; i < static_cast<size_t>(Counter::COUNT); ++i) {
+            result[COUNTER_NAMES[i]] = counters[i].load(std::memory_order_relaxed);
+        }
+        result["peak_rss_kb"] = peak_rss_kb;
+        std::ofstream out(output_file(), std::ios::app);
+        out << result.dump() << '\n';
+    }
+
+private:
+    static constexpr size_t KEY_WIDTH = 40;
+
+    static std::string& tool()
+    {
+        static std::string name;
+        return name;
+    }
+    static std::string& output_file()
+    {
+        static std::string file;
+        return file;
+    }
+    static TimeTrace::clock::time_point& start_time()
+    {
+        static TimeTrace::clock::time_point t;
+        return t;
+    }
+
+    // Constant-initialised, so counting is safe even for allocations made before main
+    static inline bool enabled = false;
+    static inline bool reported = false;
+    static inline std::atomic<uint64_t> counters[static_cast<size_t>(Counter::COUNT)] {};
+};
+
+#endif
@@ -0,0 +1,172 @@
+#pragma once
+
+#ifndef SYMBOL_INDEX_HPP
+#define SYMBOL_INDEX_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ================= Address-to-symbol index =================
+// Sorted address ranges for the symbols of every module exec has mapped,
+// published before the program starts. Lookups only binary-search plain
+// arrays and the frame walk only reads the stack, so both are safe to call
+// from signal handlers: the crash reporter and the profiler's SIGPROF handler.
+
+struct AddressRange {
+    uint64_t start;
+    uint64_t end;
+    const char* name;
+    const char* module;
+    bool local = false; // Symbols: loses to a global alias at the same address
+    bool code = false; // Regions: executable segment
+};
+
+class SymbolIndex {
+public:
+    // Defined symbol at [start, end); unsized labels should end where their section does
+    void add_symbol(uint64_t start, uint64_t end, std::string_view name, std::string_view module, bool local)
+    {
+        symbols.push_back({ start, end, store(name), store_module(module), local, false });
+    }
+
+    // Mapped segment or thunk area, the answer for addresses no symbol covers
+    void add_region(uint64_t start, uint64_t end, std::string_view name, std::string_view module, bool code)
+    {
+        regions.push_back({ start, end, store(name), store_module(module), false, code });
+    }
+
+    // Sort for lookup; call once after the last add and before publish()
+    void finish()
+    {
+        // Among aliases the global sorts last, which is the one upper_bound lands on
+        std::sort(symbols.begin(), symbols.end(), [](const AddressRange& a, const AddressRange& b) {
+            return a.start != b.start ? a.start < b.start : a.local > b.local;
+        });
+    }
+
+    void clear()
+    {
+        symbols.clear();
+        regions.clear();
+        strings.clear();
+        last_module = nullptr;
+        stack_top = 0;
+        stack_bottom = 0;
+    }
+
+    // stack_top if sp is on the main thread stack, else 0: threads the program
+    // starts itself have stacks exec knows nothing about
+    uint64_t stack_top_for(uint64_t sp) const { return sp >= stack_bottom && sp < stack_top ? stack_top : 0; }
+
+    // Innermost symbol covering addr, else its region, else nullptr
+    const AddressRange* lookup(uint64_t addr) const
+    {
+        auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+            [](uint64_t value, const AddressRange& range) { return value < range.start; });
+        if (it != symbols.begin() && addr < std::prev(it)->end) {
+            return &*std::prev(it);
+        }
+        return find_region(addr);
+    }
+
+    const AddressRange* find_region(uint64_t addr) const
+    {
+        for (const auto& region : regions) {
+            if (addr >= region.start && addr < region.end) {
+                return &region;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * Whether ret directly follows a call rel32 to the function holding rip.
+     * The word at %rsp is the caller's return address exactly when RIP is in a
+     * leaf that has not set up a frame; this tells it from stale stack data.
+     */
+    bool returns_from(uint64_t ret, uint64_t rip) const
+    {
+        const AddressRange* region = find_region(ret - 5);
+        const AddressRange* callee = lookup(rip);
+        if (region == nullptr || !region->code || ret > region->end || callee == nullptr) {
+            return false;
+        }
+        const auto* call = reinterpret_cast<const uint8_t*>(ret - 5);
+        int32_t rel;
+        std::memcpy(&rel, call + 1, sizeof(rel));
+        return call[0] == 0xe8 && lookup(ret + static_cast<int64_t>(rel)) == callee;
+    }
+
+    // The index signal handlers see; nullptr until exec has loaded a program
+    static void publish(const SymbolIndex* index) { current.store(index, std::memory_order_release); }
+    static const SymbolIndex* published() { return current.load(std::memory_order_acquire); }
+
+    uint64_t stack_top = 0; // End of the main thread stack, bounds walk_frames; 0 if unknown
+    uint64_t stack_bottom = 0; // Lowest address the main thread stack can grow down to
+
+private:
+    const char* store(std::string_view text)
+    {
+        strings.emplace_back(text);
+        return strings.back().c_str();
+    }
+
+    // Symbols arrive module by module, so one copy of each module name will do
+    const char* store_module(std::string_view module)
+    {
+        if (last_module == nullptr || module != last_module) {
+            last_module = store(module);
+        }
+        return last_module;
+    }
+
+    std::vector<AddressRange> symbols;
+    std::vector<AddressRange> regions;
+    std::deque<std::string> strings; // Stable storage for the names above
+    const char* last_module = nullptr;
+
+    static inline std::atomic<const SymbolIndex*> current { nullptr };
+};
+
+/**
+ * Return addresses of the saved-%rbp chain starting at fp, innermost first.
+ * Each frame holds the caller's %rbp and then the return address; the walk
+ * stops as soon as the chain leaves [sp, stack_top) or stops growing towards
+ * the top, so it only ever reads the live stack. read_frame(fp, words) loads
+ * the two words at fp and returns false if they cannot be read.
+ */
+template <typename ReadFrame>
+inline size_t walk_frames(uint64_t fp, uint64_t sp, uint64_t stack_top, uint64_t* out, size_t max, ReadFrame read_frame)
+{
+    size_t count = 0;
+    uint64_t saved[2];
+    while (count < max && fp >= sp && fp % 8 == 0 && fp + 16 <= stack_top && read_frame(fp, saved)) {
+        if (saved[1] == 0) {
+            break;
+        }
+        out[count++] = saved[1];
+        if (saved[0] <= fp) {
+            break;
+        }
+        fp = saved[0];
+    }
+    return count;
+}
+
+// Walk a stack whose bounds are known, reading it directly
+inline size_t walk_frames(uint64_t fp, uint64_t sp, uint64_t stack_top, uint64_t* out, size_t max)
+{
+    return walk_frames(fp, sp, stack_top, out, max, [](uint64_t addr, uint64_t* words) {
+        std::memcpy(words, reinterpret_cast<const void*>(addr), 2 * sizeof(uint64_t));
+        return true;
+    });
+}
+
+#endif
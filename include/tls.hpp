@@ -0,0 +1,99 @@
+#pragma once
+
+#ifndef TLS_HPP
+#define TLS_HPP
+
+#include <asm/prctl.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// ================= Thread-local storage =================
+// x86-64 uses TLS variant II: %fs holds the thread pointer (TP), which points
+// at the thread control block, and every module's TLS block lies below it.
+// The executable's block comes first, directly under TP, so ld can resolve
+// its offsets at link time (local-exec). Shared objects follow in load order
+// and are reached through GOT slots that exec fills (initial-exec).
+//
+// A module's TLS template is its .tdata output section followed by .tbss.
+
+// FLE sections carry no alignment, so every block gets this much
+constexpr uint64_t TLS_BLOCK_ALIGN = 16;
+
+inline bool is_tls_section(std::string_view name)
+{
+    return name == ".tdata" || name == ".tbss";
+}
+
+/**
+ * Distance from TP down to a block of size bytes placed after blocks that
+ * already take up `below` bytes under TP
+ */
+inline uint64_t tls_block_offset(uint64_t below, uint64_t size)
+{
+    return (below + size + TLS_BLOCK_ALIGN - 1) / TLS_BLOCK_ALIGN * TLS_BLOCK_ALIGN;
+}
+
+// ================= Thread control block =================
+// TP points at a thread control block. Code built by a glibc toolchain reads
+// some of its fields through %fs, so the fields below sit at the offsets of
+// glibc's x86-64 tcbhead_t; the rest of it is left zero.
+
+constexpr size_t TCB_SELF = 0x00; // tcbhead_t::tcb, the TCB's own address; %fs:0 yields TP
+constexpr size_t TCB_SELF_ALIAS = 0x10; // tcbhead_t::self, the same address again
+constexpr size_t TCB_STACK_GUARD = 0x28; // tcbhead_t::stack_guard, the -fstack-protector canary
+constexpr size_t TCB_POINTER_GUARD = 0x30; // tcbhead_t::pointer_guard, for setjmp/longjmp
+constexpr size_t TCB_SIZE = TCB_POINTER_GUARD + sizeof(uint64_t);
+
+// Bytes kept above TP for the TCB, rounded so that TP, and with it every TLS
+// block, stays TLS_BLOCK_ALIGN aligned at the top of a page-aligned area
+constexpr size_t TCB_RESERVED = (TCB_SIZE + TLS_BLOCK_ALIGN - 1) / TLS_BLOCK_ALIGN * TLS_BLOCK_ALIGN;
+static_assert(TCB_RESERVED % TLS_BLOCK_ALIGN == 0 && TCB_RESERVED >= TCB_SIZE, "TCB must not misalign TP");
+
+// ================= Thread areas for new threads =================
+// exec gives the initial thread its area. A program that starts more threads
+// gets theirs from these loader functions, which ld links like functions of a
+// shared library:
+//   void* __fle_thread_area_alloc(void)
+//       TP of a fresh area initialised from the TLS template, or null when out
+//       of memory; pass it to clone() with CLONE_SETTLS
+//   void __fle_thread_area_free(void* tp)
+//       Release an area once the thread using it has exited
+
+constexpr std::string_view THREAD_AREA_ALLOC = "__fle_thread_area_alloc";
+constexpr std::string_view THREAD_AREA_FREE = "__fle_thread_area_free";
+constexpr std::string_view LOADER_SYMBOLS[] = { THREAD_AREA_ALLOC, THREAD_AREA_FREE };
+
+// ================= Host thread pointer =================
+// exec hands %fs to the program. exec's own code can still run on that
+// thread afterwards, in signal handlers, and the C library keeps its TLS
+// under the original thread pointer, so such code switches back first.
+
+class HostThreadPointer {
+public:
+    // Make tp the calling thread's thread pointer, remembering the current one
+    static void switch_to(uint64_t tp)
+    {
+        uint64_t host = 0;
+        syscall(SYS_arch_prctl, ARCH_GET_FS, &host);
+        saved.store(host, std::memory_order_relaxed);
+        syscall(SYS_arch_prctl, ARCH_SET_FS, tp);
+    }
+
+    // Async-signal-safe; does nothing unless switch_to has run
+    static void restore()
+    {
+        uint64_t host = saved.load(std::memory_order_relaxed);
+        if (host != 0) {
+            syscall(SYS_arch_prctl, ARCH_SET_FS, host);
+        }
+    }
+
+private:
+    static inline std::atomic<uint64_t> saved { 0 };
+};
+
+#endif
@@ -0,0 +1,176 @@
+#pragma once
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include <vector>
+
+using json = nlohmann::ordered_json;
+
+/**
+ * Process-wide recorder for Chrome trace events (chrome://tracing, Perfetto).
+ * Disabled by default; a disabled TraceScope costs one clock read and a branch.
+ */
+class TimeTrace {
+public:
+    using clock = std::chrono::steady_clock;
+
+    static TimeTrace& get()
+    {
+        static TimeTrace instance;
+        return instance;
+    }
+
+    void enable() { enabled = true; }
+    bool is_enabled() const { return enabled; }
+
+    // Enable tracing and remember where flush() should write the events
+    void enable(const std::string& filename)
+    {
+        enabled = true;
+        output_file = filename;
+    }
+
+    // Drop all events and disable, so one long-lived process can trace many runs
+    void reset()
+    {
+        enabled = false;
+        output_file.clear();
+        events.clear();
+        start = clock::now();
+    }
+
+    // Write the events recorded so far, for tools that never return to main
+    void flush() const
+    {
+        if (enabled && !output_file.empty()) {
+            write_to_file(output_file);
+        }
+    }
+
+    void add(std::string_view name, std::string_view detail, clock::time_point begin, clock::time_point end)
+    {
+        events.push_back({ std::string(name), std::string(detail), micros(begin), micros(end) - micros(begin) });
+    }
+
+    void write_to_file(const std::string& filename) const
+    {
+        json trace_events = json::array();
+        for (const auto& ev : events) {
+            json ev_json;
+            ev_json["name"] = ev.name;
+            ev_json["ph"] = "X"; // Complete event: begin + duration
+            ev_json["ts"] = ev.ts;
+            ev_json["dur"] = ev.dur;
+            ev_json["pid"] = getpid();
+            ev_json["tid"] = 0;
+            if (!ev.detail.empty()) {
+                ev_json["args"]["detail"] = ev.detail;
+            }
+            trace_events.push_back(ev_json);
+        }
+
+        json result;
+        result["traceEvents"] = trace_events;
+        result["displayTimeUnit"] = "ms";
+
+        std::ofstream out(filename);
+        out << result.dump(4) << std::endl;
+    }
+
+    struct PhaseTotal {
+        std::string name;
+        int64_t total_us;
+        size_t count;
+    };
+
+    // Total time per event name, ordered by when each name first started
+    std::vector<PhaseTotal> phase_totals() const
+    {
+        std::vector<std::pair<int64_t, PhaseTotal>> firsts;
+        for (const auto& ev : events) {
+            auto it = std::find_if(firsts.begin(), firsts.end(), [&](const auto& f) { return f.second.name == ev.name; });
+            if (it == firsts.end()) {
+                firsts.push_back({ ev.ts, { ev.name, ev.dur, 1 } });
+            } else {
+                it->first = std::min(it->first, ev.ts);
+                it->second.total_us += ev.dur;
+                ++it->second.count;
+            }
+        }
+        // Phases starting in the same microsecond list the enclosing (longer) one first
+        std::stable_sort(firsts.begin(), firsts.end(), [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first < b.first : a.second.total_us > b.second.total_us;
+        });
+        std::vector<PhaseTotal> totals;
+        for (auto& f : firsts) {
+            totals.push_back(std::move(f.second));
+        }
+        return totals;
+    }
+
+private:
+    struct Event {
+        std::string name;
+        std::string detail;
+        int64_t ts; // Microseconds since the trace started
+        int64_t dur; // Microseconds
+    };
+
+    TimeTrace()
+        : start(clock::now())
+    {
+    }
+
+    int64_t micros(clock::time_point t) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(t - start).count();
+    }
+
+    bool enabled = false;
+    std::string output_file;
+    clock::time_point start;
+    std::vector<Event> events;
+};
+
+// Records the enclosing scope as one trace event; name/detail must outlive the scope
+class TraceScope {
+public:
+    explicit TraceScope(std::string_view name, std::string_view detail = {})
+        : name(name)
+        , detail(detail)
+        , begin(TimeTrace::clock::now())
+    {
+    }
+
+    ~TraceScope() { stop(); }
+
+    // End the event early, for phases that do not map onto a C++ scope
+    void stop()
+    {
+        auto& trace = TimeTrace::get();
+        if (!stopped && trace.is_enabled()) {
+            trace.add(name, detail, begin, TimeTrace::clock::now());
+        }
+        stopped = true;
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    std::string_view name;
+    std::string_view detail;
+    TimeTrace::clock::time_point begin;
+    bool stopped = false;
+};
+
+#endif
@@ -0,0 +1,217 @@
+#pragma once
+
+#ifndef VERSION_SCRIPT_HPP
+#define VERSION_SCRIPT_HPP
+
+#include "file_io.hpp"
+#include <cctype>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ================= Version scripts =================
+// The subset of GNU ld version scripts that decides what a shared library
+// exports:
+//
+//     VERS_1 { global: api_*; init; local: *; };
+//     { global: foo; };            # anonymous version
+//
+// FLE symbols carry no version, so node names and dependencies are accepted
+// and ignored; only the global/local patterns matter. Patterns support the
+// shell wildcards *, ? and [...].
+
+/**
+ * Shell-style wildcard match of name against pattern
+ */
+inline bool wildcard_match(std::string_view pattern, std::string_view name)
+{
+    size_t p = 0, n = 0;
+    size_t star = std::string_view::npos, resume = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = n;
+            continue;
+        }
+        size_t close = p < pattern.size() && pattern[p] == '[' ? pattern.find(']', p + 2) : std::string_view::npos;
+        if (close != std::string_view::npos) {
+            bool negate = pattern[p + 1] == '!' || pattern[p + 1] == '^';
+            bool found = false;
+            for (size_t i = p + 1 + negate; i < close; ++i) {
+                if (i + 2 < close && pattern[i + 1] == '-') {
+                    found |= name[n] >= pattern[i] && name[n] <= pattern[i + 2];
+                    i += 2;
+                } else {
+                    found |= name[n] == pattern[i];
+                }
+            }
+            if (found != negate) {
+                p = close + 1;
+                ++n;
+                continue;
+            }
+        } else if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+            continue;
+        }
+        if (star == std::string_view::npos) {
+            return false;
+        }
+        p = star + 1;
+        n = ++resume;
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+class VersionScript {
+public:
+    /**
+     * Parse the text of a version script
+     * @throws runtime_error on syntax the subset above does not cover
+     */
+    static VersionScript parse(std::string_view text)
+    {
+        VersionScript script;
+        Lexer lexer { text };
+        while (!lexer.at_end()) {
+            std::string token = lexer.next();
+            if (token != "{") {
+                lexer.expect("{"); // Node name
+            }
+            bool global = true;
+            for (token = lexer.next(); token != "}"; token = lexer.next()) {
+                if (token.empty()) {
+                    throw std::runtime_error("version script: unterminated version node");
+                }
+                if ((token == "global" || token == "local") && lexer.peek() == ":") {
+                    lexer.next();
+                    global = token == "global";
+                    continue;
+                }
+                if (token == "extern") {
+                    throw std::runtime_error("version script: extern blocks are not supported");
+                }
+                script.add(token, global);
+                lexer.expect(";");
+            }
+            token = lexer.next();
+            if (token != ";") {
+                lexer.expect(";"); // Dependency on an earlier node
+            }
+        }
+        return script;
+    }
+
+    // Parse the version script at path
+    static VersionScript load(const std::string& path) { return parse(read_file(path)); }
+
+    /**
+     * Whether name stays exported. As in GNU ld an exact name beats any
+     * wildcard, a lone * comes last, and a name no pattern covers is global.
+     */
+    bool exports(std::string_view name) const
+    {
+        for (const auto& rule : exact) {
+            if (rule.pattern == name) {
+                return rule.global;
+            }
+        }
+        for (const auto& rule : wildcards) {
+            if (wildcard_match(rule.pattern, name)) {
+                return rule.global;
+            }
+        }
+        return catch_all.value_or(true);
+    }
+
+private:
+    struct Rule {
+        std::string pattern;
+        bool global;
+    };
+
+    void add(const std::string& pattern, bool global)
+    {
+        if (pattern == "*") {
+            // Checked after every other pattern; local wins if both sides list it
+            catch_all = catch_all.value_or(true) && global;
+        } else if (pattern.find_first_of("*?[") == std::string::npos) {
+            exact.push_back({ pattern, global });
+        } else {
+            wildcards.push_back({ pattern, global });
+        }
+    }
+
+    // Tokens are punctuation ({ } ; :) or runs of anything else; # and /* */ start comments
+    struct Lexer {
+        std::string_view text;
+
+        bool at_end()
+        {
+            skip();
+            return text.empty();
+        }
+
+        std::string peek()
+        {
+            Lexer copy = *this;
+            return copy.next();
+        }
+
+        std::string next()
+        {
+            skip();
+            if (text.empty()) {
+                return {};
+            }
+            size_t length = 1;
+            if (std::string_view("{};:").find(text[0]) == std::string_view::npos) {
+                while (length < text.size() && !std::isspace(static_cast<unsigned char>(text[length]))
+                    && std::string_view("{};:#").find(text[length]) == std::string_view::npos) {
+                    ++length;
+                }
+            }
+            std::string token(text.substr(0, length));
+            text.remove_prefix(length);
+            return token;
+        }
+
+        void expect(std::string_view token)
+        {
+            std::string got = next();
+            if (got != token) {
+                throw std::runtime_error("version script: expected '" + std::string(token) + "', got '" + got + "'");
+            }
+        }
+
+        void skip()
+        {
+            for (;;) {
+                while (!text.empty() && std::isspace(static_cast<unsigned char>(text[0]))) {
+                    text.remove_prefix(1);
+                }
+                if (!text.empty() && text[0] == '#') {
+                    size_t end = text.find('\n');
+                    text.remove_prefix(end == std::string_view::npos ? text.size() : end);
+                } else if (text.substr(0, 2) == "/*") {
+                    size_t end = text.find("*/", 2);
+                    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 2);
+                } else {
+                    return;
+                }
+            }
+        }
+    };
+
+    std::vector<Rule> exact;
+    std::vector<Rule> wildcards;
+    std::optional<bool> catch_all; // Verdict of a bare *, if any
+};
+
+#endif
@@ -0,0 +1,984 @@
+#pragma once
+
+#ifndef X86_DECODE_HPP
+#define X86_DECODE_HPP
+
+#include "x86_length.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ================= x86-64 Instruction Decoder =================
+// A table-driven decoder for the integer subset compilers emit for ordinary
+// code, plus the common scalar/packed SSE moves and arithmetic. Text is AT&T
+// syntax formatted the way `objdump -d` prints it, so existing habits (and
+// diffs against binutils) keep working. Valid instructions outside the tables
+// (x87, AVX, ...) print as "(unknown)" but keep their real length, so the
+// stream stays in sync; invalid bytes are a one-byte "(bad)" like in objdump.
+
+namespace x86 {
+
+struct Instruction {
+    size_t length = 0; // Bytes consumed, at least 1
+    bool valid = false; // False for "(bad)" and "(unknown)"
+    std::string text; // "mov    %rsp,%rbp"
+    bool has_target = false; // Branch target or %rip-relative address below
+    bool rip_relative = false; // target comes from a %rip-relative memory operand
+    uint64_t target = 0;
+};
+
+// Append "0x" and the value in lowercase hex without leading zeros, as objdump prints numbers
+inline void append_hex(std::string& out, uint64_t value)
+{
+    char buf[16];
+    int n = 0;
+    do {
+        buf[n++] = "0123456789abcdef"[value & 0xF];
+        value >>= 4;
+    } while (value != 0);
+    out += "0x";
+    while (n > 0) {
+        out += buf[--n];
+    }
+}
+
+namespace detail {
+
+    // Operand kinds, in Intel order (destination first); printing reverses them.
+    enum Operand : uint8_t {
+        NONE,
+        Eb, Ev, Ew, Ed, Ey, M, // ModRM r/m; Ey is 32/64 by REX.W, M is memory only
+        Gb, Gv, Gy, // ModRM reg
+        Zb, Zv, // Register in the low three opcode bits
+        AL, AX, CL, // Fixed operands; AX follows the operand size
+        Ib, Is, Iz, Iv, Iw, // Immediates: byte, byte sign-extended, 16/32 sign-extended, full, word
+        Jb, Jz, // Relative branch targets
+        Ob, Ov, // moffs (absolute address)
+        Xb, Xv, Yb, Yv, // String operands %ds:(%rsi) and %es:(%rdi)
+        Vx, Wx, // SSE register / SSE register or memory
+    };
+
+    enum Flags : uint16_t {
+        DEF64 = 1 << 0, // Operand size defaults to 64 bits (push, pop, near branches)
+        STAR = 1 << 1, // Indirect branch, operand printed with '*'
+        BRANCH = 1 << 2, // F2 prints as "bnd"
+        NOSUFFIX = 1 << 3, // Never append a size suffix
+        SUFFIX = 1 << 4, // SSE entry whose GPR memory operand takes a suffix (cvtsi2sdl)
+        MOVX = 1 << 5, // movzx/movsx: suffix is source size then destination size
+        REPZ = 1 << 6, // String op that F3 turns into "repz" (cmps, scas) rather than "rep"
+        STRING = 1 << 7, // String op (rep/repz/repnz names)
+        SSE = 1 << 8, // Mandatory-prefix SSE entry: 66/F2/F3 pick the mnemonic
+        GROUP = 1 << 9, // ModRM.reg selects the real entry from Tables::groups
+    };
+
+    struct Entry {
+        const char* name = nullptr; // nullptr: not decoded
+        Operand op[3] = { NONE, NONE, NONE };
+        uint16_t flags = 0;
+        uint8_t group = 0;
+        // SSE entries: name per mandatory prefix {none, 66, F3, F2}
+        const char* sse[4] = { nullptr, nullptr, nullptr, nullptr };
+    };
+
+    using Table = std::array<Entry, 256>;
+
+    inline constexpr const char* JCC[16] = {
+        "jo", "jno", "jb", "jae", "je", "jne", "jbe", "ja", "js", "jns", "jp", "jnp", "jl", "jge", "jle", "jg"
+    };
+    inline constexpr const char* SETCC[16] = {
+        "seto", "setno", "setb", "setae", "sete", "setne", "setbe", "seta",
+        "sets", "setns", "setp", "setnp", "setl", "setge", "setle", "setg"
+    };
+    inline constexpr const char* CMOVCC[16] = {
+        "cmovo", "cmovno", "cmovb", "cmovae", "cmove", "cmovne", "cmovbe", "cmova",
+        "cmovs", "cmovns", "cmovp", "cmovnp", "cmovl", "cmovge", "cmovle", "cmovg"
+    };
+
+    inline constexpr const char* REG64[16] = {
+        "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+        "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+    };
+    inline constexpr const char* REG32[16] = {
+        "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+        "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"
+    };
+    inline constexpr const char* REG16[16] = {
+        "ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+        "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"
+    };
+    inline constexpr const char* REG8[16] = {
+        "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+        "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"
+    };
+    inline constexpr const char* REG8_LEGACY[8] = { "al", "cl", "dl", "bl", "ah", "ch", "dh", "bh" };
+
+    inline constexpr const char* SSE_SHIFTS[3][8] = {
+        { nullptr, nullptr, "psrlw", nullptr, "psraw", nullptr, "psllw", nullptr },
+        { nullptr, nullptr, "psrld", nullptr, "psrad", nullptr, "pslld", nullptr },
+        { nullptr, nullptr, "psrlq", "psrldq", nullptr, nullptr, "psllq", "pslldq" },
+    };
+
+    enum Group : uint8_t {
+        G_NONE,
+        G_ALU_EB_IB, G_ALU_EV_IZ, G_ALU_EV_IS,
+        G_SHIFT_EB_IB, G_SHIFT_EV_IB, G_SHIFT_EB_1, G_SHIFT_EV_1, G_SHIFT_EB_CL, G_SHIFT_EV_CL,
+        G_UNARY_EB, G_UNARY_EV, G_INCDEC_EB, G_INCDEC_EV, G_POP, G_MOV_EB, G_MOV_EV,
+        G_BT, G_NOP, G_PREFETCH,
+        G_COUNT
+    };
+
+    struct Tables {
+        Table one; // One-byte opcodes
+        Table two; // 0F xx
+        std::array<std::array<Entry, 8>, G_COUNT> groups;
+    };
+
+    inline const Tables& tables()
+    {
+        static const Tables t = [] {
+            Tables t;
+            auto& one = t.one;
+            auto& two = t.two;
+
+            // 00-3F: add/or/adc/sbb/and/sub/xor/cmp in their six encodings
+            const char* alu[8] = { "add", "or", "adc", "sbb", "and", "sub", "xor", "cmp" };
+            for (int i = 0; i < 8; ++i) {
+                one[i * 8 + 0] = { alu[i], { Eb, Gb } };
+                one[i * 8 + 1] = { alu[i], { Ev, Gv } };
+                one[i * 8 + 2] = { alu[i], { Gb, Eb } };
+                one[i * 8 + 3] = { alu[i], { Gv, Ev } };
+                one[i * 8 + 4] = { alu[i], { AL, Ib } };
+                one[i * 8 + 5] = { alu[i], { AX, Iz } };
+            }
+            for (int r = 0; r < 8; ++r) {
+                one[0x50 + r] = { "push", { Zv }, DEF64 };
+                one[0x58 + r] = { "pop", { Zv }, DEF64 };
+                one[0x90 + r] = { "xchg", { Zv, AX } };
+                one[0xB0 + r] = { "mov", { Zb, Ib } };
+                one[0xB8 + r] = { "mov", { Zv, Iv } };
+            }
+            one[0x63] = { "movslq", { Gv, Ed } }; // movsxd without REX.W
+            one[0x68] = { "push", { Iz }, DEF64 };
+            one[0x69] = { "imul", { Gv, Ev, Iz } };
+            one[0x6A] = { "push", { Is }, DEF64 };
+            one[0x6B] = { "imul", { Gv, Ev, Is } };
+            for (int c = 0; c < 16; ++c) {
+                one[0x70 + c] = { JCC[c], { Jb }, DEF64 | BRANCH };
+                two[0x80 + c] = { JCC[c], { Jz }, DEF64 | BRANCH };
+                two[0x90 + c] = { SETCC[c], { Eb }, NOSUFFIX };
+                two[0x40 + c] = { CMOVCC[c], { Gv, Ev } };
+            }
+            one[0x80] = { nullptr, {}, GROUP, G_ALU_EB_IB };
+            one[0x81] = { nullptr, {}, GROUP, G_ALU_EV_IZ };
+            one[0x83] = { nullptr, {}, GROUP, G_ALU_EV_IS };
+            one[0x84] = { "test", { Eb, Gb } };
+            one[0x85] = { "test", { Ev, Gv } };
+            one[0x86] = { "xchg", { Eb, Gb } };
+            one[0x87] = { "xchg", { Ev, Gv } };
+            one[0x88] = { "mov", { Eb, Gb } };
+            one[0x89] = { "mov", { Ev, Gv } };
+            one[0x8A] = { "mov", { Gb, Eb } };
+            one[0x8B] = { "mov", { Gv, Ev } };
+            one[0x8D] = { "lea", { Gv, M } };
+            one[0x8F] = { nullptr, {}, GROUP, G_POP };
+            one[0x90] = { "nop" }; // 66 90 and F3 90 are handled in Decoder::run()
+            one[0x98] = { "cwtl" }; // Operand-size variants picked in Decoder::run()
+            one[0x99] = { "cltd" };
+            one[0xA0] = { "movabs", { AL, Ob } };
+            one[0xA1] = { "movabs", { AX, Ov } };
+            one[0xA2] = { "movabs", { Ob, AL } };
+            one[0xA3] = { "movabs", { Ov, AX } };
+            one[0xA4] = { "movs", { Yb, Xb }, STRING };
+            one[0xA5] = { "movs", { Yv, Xv }, STRING };
+            one[0xA6] = { "cmps", { Xb, Yb }, STRING | REPZ };
+            one[0xA7] = { "cmps", { Xv, Yv }, STRING | REPZ };
+            one[0xA8] = { "test", { AL, Ib } };
+            one[0xA9] = { "test", { AX, Iz } };
+            one[0xAA] = { "stos", { Yb, AL }, STRING };
+            one[0xAB] = { "stos", { Yv, AX }, STRING };
+            one[0xAC] = { "lods", { AL, Xb }, STRING };
+            one[0xAD] = { "lods", { AX, Xv }, STRING };
+            one[0xAE] = { "scas", { AL, Yb }, STRING | REPZ };
+            one[0xAF] = { "scas", { AX, Yv }, STRING | REPZ };
+            one[0xC0] = { nullptr, {}, GROUP, G_SHIFT_EB_IB };
+            one[0xC1] = { nullptr, {}, GROUP, G_SHIFT_EV_IB };
+            one[0xC2] = { "ret", { Iw }, DEF64 | BRANCH };
+            one[0xC3] = { "ret", {}, DEF64 | BRANCH };
+            one[0xC6] = { nullptr, {}, GROUP, G_MOV_EB };
+            one[0xC7] = { nullptr, {}, GROUP, G_MOV_EV };
+            one[0xC9] = { "leave", {}, DEF64 };
+            one[0xCC] = { "int3" };
+            one[0xCD] = { "int", { Ib } };
+            one[0xD0] = { nullptr, {}, GROUP, G_SHIFT_EB_1 };
+            one[0xD1] = { nullptr, {}, GROUP, G_SHIFT_EV_1 };
+            one[0xD2] = { nullptr, {}, GROUP, G_SHIFT_EB_CL };
+            one[0xD3] = { nullptr, {}, GROUP, G_SHIFT_EV_CL };
+            one[0xE8] = { "call", { Jz }, DEF64 | BRANCH };
+            one[0xE9] = { "jmp", { Jz }, DEF64 | BRANCH };
+            one[0xEB] = { "jmp", { Jb }, DEF64 | BRANCH };
+            one[0xF4] = { "hlt" };
+            one[0xF5] = { "cmc" };
+            one[0xF6] = { nullptr, {}, GROUP, G_UNARY_EB };
+            one[0xF7] = { nullptr, {}, GROUP, G_UNARY_EV };
+            one[0xF8] = { "clc" };
+            one[0xF9] = { "stc" };
+            one[0xFC] = { "cld" };
+            one[0xFD] = { "std" };
+            one[0xFE] = { nullptr, {}, GROUP, G_INCDEC_EB };
+            one[0xFF] = { nullptr, {}, GROUP, G_INCDEC_EV };
+
+            two[0x05] = { "syscall" };
+            two[0x0B] = { "ud2" };
+            two[0x18] = { nullptr, {}, GROUP, G_PREFETCH };
+            two[0x1F] = { nullptr, {}, GROUP, G_NOP };
+            two[0xA2] = { "cpuid" };
+            two[0xA3] = { "bt", { Ev, Gv } };
+            two[0xA4] = { "shld", { Ev, Gv, Ib } };
+            two[0xA5] = { "shld", { Ev, Gv, CL } };
+            two[0xAB] = { "bts", { Ev, Gv } };
+            two[0xAC] = { "shrd", { Ev, Gv, Ib } };
+            two[0xAD] = { "shrd", { Ev, Gv, CL } };
+            two[0xAF] = { "imul", { Gv, Ev } };
+            two[0xB0] = { "cmpxchg", { Eb, Gb } };
+            two[0xB1] = { "cmpxchg", { Ev, Gv } };
+            two[0xB3] = { "btr", { Ev, Gv } };
+            two[0xB6] = { "movzb", { Gv, Eb }, MOVX };
+            two[0xB7] = { "movzw", { Gv, Ew }, MOVX };
+            two[0xB8] = { "popcnt", { Gv, Ev } }; // F3 only
+            two[0xBA] = { nullptr, {}, GROUP, G_BT };
+            two[0xBB] = { "btc", { Ev, Gv } };
+            two[0xBC] = { "bsf", { Gv, Ev } };
+            two[0xBD] = { "bsr", { Gv, Ev } };
+            two[0xBE] = { "movsb", { Gv, Eb }, MOVX };
+            two[0xBF] = { "movsw", { Gv, Ew }, MOVX };
+            two[0xC0] = { "xadd", { Eb, Gb } };
+            two[0xC1] = { "xadd", { Ev, Gv } };
+            for (int r = 0; r < 8; ++r) {
+                two[0xC8 + r] = { "bswap", { Zv } };
+            }
+
+            // SSE: {none, 66, F3, F2}
+            auto sse = [&](uint8_t op, Operand a, Operand b, std::array<const char*, 4> names, Operand c = NONE, uint16_t flags = 0) {
+                Entry e { "sse", { a, b, c }, static_cast<uint16_t>(SSE | ((flags & SUFFIX) ? 0 : NOSUFFIX)) };
+                for (int i = 0; i < 4; ++i) {
+                    e.sse[i] = names[i];
+                }
+                two[op] = e;
+            };
+            sse(0x10, Vx, Wx, { "movups", "movupd", "movss", "movsd" });
+            sse(0x11, Wx, Vx, { "movups", "movupd", "movss", "movsd" });
+            sse(0x12, Vx, Wx, { "movlps", "movlpd", nullptr, nullptr }); // movhlps for a register source
+            sse(0x13, Wx, Vx, { "movlps", "movlpd", nullptr, nullptr });
+            sse(0x14, Vx, Wx, { "unpcklps", "unpcklpd", nullptr, nullptr });
+            sse(0x15, Vx, Wx, { "unpckhps", "unpckhpd", nullptr, nullptr });
+            sse(0x16, Vx, Wx, { "movhps", "movhpd", nullptr, nullptr }); // movlhps for a register source
+            sse(0x17, Wx, Vx, { "movhps", "movhpd", nullptr, nullptr });
+            sse(0x28, Vx, Wx, { "movaps", "movapd", nullptr, nullptr });
+            sse(0x29, Wx, Vx, { "movaps", "movapd", nullptr, nullptr });
+            sse(0x2A, Vx, Ey, { nullptr, nullptr, "cvtsi2ss", "cvtsi2sd" }, NONE, SUFFIX);
+            sse(0x2B, Wx, Vx, { "movntps", "movntpd", nullptr, nullptr });
+            sse(0x2C, Gy, Wx, { nullptr, nullptr, "cvttss2si", "cvttsd2si" });
+            sse(0x2D, Gy, Wx, { nullptr, nullptr, "cvtss2si", "cvtsd2si" });
+            sse(0x2E, Vx, Wx, { "ucomiss", "ucomisd", nullptr, nullptr });
+            sse(0x2F, Vx, Wx, { "comiss", "comisd", nullptr, nullptr });
+            sse(0x51, Vx, Wx, { "sqrtps", "sqrtpd", "sqrtss", "sqrtsd" });
+            sse(0x54, Vx, Wx, { "andps", "andpd", nullptr, nullptr });
+            sse(0x55, Vx, Wx, { "andnps", "andnpd", nullptr, nullptr });
+            sse(0x56, Vx, Wx, { "orps", "orpd", nullptr, nullptr });
+            sse(0x57, Vx, Wx, { "xorps", "xorpd", nullptr, nullptr });
+            sse(0x58, Vx, Wx, { "addps", "addpd", "addss", "addsd" });
+            sse(0x59, Vx, Wx, { "mulps", "mulpd", "mulss", "mulsd" });
+            sse(0x5A, Vx, Wx, { "cvtps2pd", "cvtpd2ps", "cvtss2sd", "cvtsd2ss" });
+            sse(0x5B, Vx, Wx, { "cvtdq2ps", "cvtps2dq", "cvttps2dq", nullptr });
+            sse(0x5C, Vx, Wx, { "subps", "subpd", "subss", "subsd" });
+            sse(0x5D, Vx, Wx, { "minps", "minpd", "minss", "minsd" });
+            sse(0x5E, Vx, Wx, { "divps", "divpd", "divss", "divsd" });
+            sse(0x5F, Vx, Wx, { "maxps", "maxpd", "maxss", "maxsd" });
+            sse(0x6E, Vx, Ey, { nullptr, "movd", nullptr, nullptr }); // movq with REX.W
+            sse(0x6F, Vx, Wx, { nullptr, "movdqa", "movdqu", nullptr });
+            sse(0x70, Vx, Wx, { nullptr, "pshufd", "pshufhw", "pshuflw" }, Ib);
+            sse(0x7E, Ey, Vx, { nullptr, "movd", "movq", nullptr }); // F3 form is Vx, Wx; fixed in Decoder::run()
+            sse(0x7F, Wx, Vx, { nullptr, "movdqa", "movdqu", nullptr });
+            sse(0xC6, Vx, Wx, { "shufps", "shufpd", nullptr, nullptr }, Ib);
+            sse(0xD6, Wx, Vx, { nullptr, "movq", nullptr, nullptr });
+            sse(0xD7, Gy, Wx, { nullptr, "pmovmskb", nullptr, nullptr });
+            sse(0xE6, Vx, Wx, { nullptr, "cvttpd2dq", "cvtdq2pd", "cvtpd2dq" });
+            sse(0xE7, Wx, Vx, { nullptr, "movntdq", nullptr, nullptr });
+
+            // SSE2 integer arithmetic, 66 0F xx only
+            const std::pair<uint8_t, const char*> sse2[] = {
+                { 0x60, "punpcklbw" }, { 0x61, "punpcklwd" }, { 0x62, "punpckldq" }, { 0x63, "packsswb" },
+                { 0x64, "pcmpgtb" }, { 0x65, "pcmpgtw" }, { 0x66, "pcmpgtd" }, { 0x67, "packuswb" },
+                { 0x68, "punpckhbw" }, { 0x69, "punpckhwd" }, { 0x6A, "punpckhdq" }, { 0x6B, "packssdw" },
+                { 0x6C, "punpcklqdq" }, { 0x6D, "punpckhqdq" }, { 0x74, "pcmpeqb" }, { 0x75, "pcmpeqw" },
+                { 0x76, "pcmpeqd" }, { 0xD1, "psrlw" }, { 0xD2, "psrld" }, { 0xD3, "psrlq" },
+                { 0xD4, "paddq" }, { 0xD5, "pmullw" }, { 0xD8, "psubusb" }, { 0xD9, "psubusw" },
+                { 0xDA, "pminub" }, { 0xDB, "pand" }, { 0xDC, "paddusb" }, { 0xDD, "paddusw" },
+                { 0xDE, "pmaxub" }, { 0xDF, "pandn" }, { 0xE0, "pavgb" }, { 0xE1, "psraw" },
+                { 0xE2, "psrad" }, { 0xE3, "pavgw" }, { 0xE4, "pmulhuw" }, { 0xE5, "pmulhw" },
+                { 0xE8, "psubsb" }, { 0xE9, "psubsw" }, { 0xEA, "pminsw" }, { 0xEB, "por" },
+                { 0xEC, "paddsb" }, { 0xED, "paddsw" }, { 0xEE, "pmaxsw" }, { 0xEF, "pxor" },
+                { 0xF1, "psllw" }, { 0xF2, "pslld" }, { 0xF3, "psllq" }, { 0xF4, "pmuludq" },
+                { 0xF5, "pmaddwd" }, { 0xF6, "psadbw" }, { 0xF8, "psubb" }, { 0xF9, "psubw" },
+                { 0xFA, "psubd" }, { 0xFB, "psubq" }, { 0xFC, "paddb" }, { 0xFD, "paddw" },
+                { 0xFE, "paddd" },
+            };
+            for (const auto& [op, name] : sse2) {
+                sse(op, Vx, Wx, { nullptr, name, nullptr, nullptr });
+            }
+            // 66 0F 71-73: shifts by an immediate, ModRM.reg picks the operation
+            for (uint8_t op = 0x71; op <= 0x73; ++op) {
+                two[op] = { "sse", { Wx, Ib }, SSE | NOSUFFIX | GROUP };
+            }
+
+            auto& g = t.groups;
+            for (int i = 0; i < 8; ++i) {
+                g[G_ALU_EB_IB][i] = { alu[i], { Eb, Ib } };
+                g[G_ALU_EV_IZ][i] = { alu[i], { Ev, Iz } };
+                g[G_ALU_EV_IS][i] = { alu[i], { Ev, Is } };
+            }
+            const char* shifts[8] = { "rol", "ror", "rcl", "rcr", "shl", "shr", "shl", "sar" };
+            for (int i = 0; i < 8; ++i) {
+                g[G_SHIFT_EB_IB][i] = { shifts[i], { Eb, Ib } };
+                g[G_SHIFT_EV_IB][i] = { shifts[i], { Ev, Ib } };
+                g[G_SHIFT_EB_1][i] = { shifts[i], { Eb } };
+                g[G_SHIFT_EV_1][i] = { shifts[i], { Ev } };
+                g[G_SHIFT_EB_CL][i] = { shifts[i], { Eb, CL } };
+                g[G_SHIFT_EV_CL][i] = { shifts[i], { Ev, CL } };
+            }
+            const char* unary[8] = { "test", "test", "not", "neg", "mul", "imul", "div", "idiv" };
+            for (int i = 0; i < 8; ++i) {
+                g[G_UNARY_EB][i] = { unary[i], { Eb } };
+                g[G_UNARY_EV][i] = { unary[i], { Ev } };
+            }
+            g[G_UNARY_EB][0].op[1] = g[G_UNARY_EB][1].op[1] = Ib;
+            g[G_UNARY_EV][0].op[1] = g[G_UNARY_EV][1].op[1] = Iz;
+            g[G_INCDEC_EB][0] = { "inc", { Eb } };
+            g[G_INCDEC_EB][1] = { "dec", { Eb } };
+            g[G_INCDEC_EV][0] = { "inc", { Ev } };
+            g[G_INCDEC_EV][1] = { "dec", { Ev } };
+            g[G_INCDEC_EV][2] = { "call", { Ev }, DEF64 | STAR | BRANCH | NOSUFFIX };
+            g[G_INCDEC_EV][4] = { "jmp", { Ev }, DEF64 | STAR | BRANCH | NOSUFFIX };
+            g[G_INCDEC_EV][6] = { "push", { Ev }, DEF64 | NOSUFFIX };
+            g[G_POP][0] = { "pop", { Ev }, DEF64 | NOSUFFIX };
+            g[G_MOV_EB][0] = { "mov", { Eb, Ib } };
+            g[G_MOV_EV][0] = { "mov", { Ev, Iz } };
+            g[G_BT][4] = { "bt", { Ev, Ib } };
+            g[G_BT][5] = { "bts", { Ev, Ib } };
+            g[G_BT][6] = { "btr", { Ev, Ib } };
+            g[G_BT][7] = { "btc", { Ev, Ib } };
+            for (int i = 0; i < 8; ++i) {
+                g[G_NOP][i] = { "nop", { Ev } };
+            }
+            g[G_PREFETCH][0] = { "prefetchnta", { M }, NOSUFFIX };
+            g[G_PREFETCH][1] = { "prefetcht0", { M }, NOSUFFIX };
+            g[G_PREFETCH][2] = { "prefetcht1", { M }, NOSUFFIX };
+            g[G_PREFETCH][3] = { "prefetcht2", { M }, NOSUFFIX };
+            return t;
+        }();
+        return t;
+    }
+
+    inline void append_signed_hex(std::string& out, int64_t value)
+    {
+        if (value < 0) {
+            out += '-';
+            append_hex(out, 0 - static_cast<uint64_t>(value));
+        } else {
+            append_hex(out, static_cast<uint64_t>(value));
+        }
+    }
+
+    inline uint64_t mask(uint64_t value, int bits)
+    {
+        return bits >= 64 ? value : value & ((uint64_t(1) << bits) - 1);
+    }
+
+    inline char size_suffix(int bits)
+    {
+        switch (bits) {
+        case 8:
+            return 'b';
+        case 16:
+            return 'w';
+        case 32:
+            return 'l';
+        default:
+            return 'q';
+        }
+    }
+
+    // Decoding state for one instruction
+    class Decoder {
+    public:
+        Decoder(const uint8_t* code, size_t size, uint64_t address)
+            : code(code)
+            , size(size)
+            , address(address)
+        {
+        }
+
+        bool run(Instruction& insn);
+        size_t length() const { return pos; }
+
+    private:
+        bool byte(uint8_t& b)
+        {
+            if (pos >= size || pos >= 15) {
+                return false;
+            }
+            b = code[pos++];
+            return true;
+        }
+
+        bool imm(int bytes, int64_t& value)
+        {
+            if (pos + bytes > size || pos + bytes > 15) {
+                return false;
+            }
+            uint64_t v = 0;
+            for (int i = 0; i < bytes; ++i) {
+                v |= uint64_t(code[pos + i]) << (8 * i);
+            }
+            pos += bytes;
+            // Sign-extend
+            int shift = 64 - 8 * bytes;
+            value = bytes == 8 ? static_cast<int64_t>(v) : static_cast<int64_t>(v << shift) >> shift;
+            return true;
+        }
+
+        bool modrm();
+        const char* gpr(int reg, int bits) const
+        {
+            switch (bits) {
+            case 8:
+                return rex ? REG8[reg] : (reg < 8 ? REG8_LEGACY[reg] : REG8[reg]);
+            case 16:
+                return REG16[reg];
+            case 32:
+                return REG32[reg];
+            default:
+                return REG64[reg];
+            }
+        }
+        void reg_operand(std::string& out, const char* name) const
+        {
+            out += '%';
+            out += name;
+        }
+        void xmm_operand(std::string& out, int reg) const
+        {
+            out += "%xmm";
+            if (reg >= 10) {
+                out += '1';
+                reg -= 10;
+            }
+            out += static_cast<char>('0' + reg);
+        }
+        void memory_operand(std::string& out) const;
+        bool operand(Operand kind, std::string& out, Instruction& insn);
+
+        const uint8_t* code;
+        size_t size;
+        uint64_t address;
+        size_t pos = 0;
+
+        // Prefixes
+        uint8_t rex = 0;
+        bool p66 = false, p67 = false, lock = false;
+        int data16 = 0; // Number of 66 prefixes
+        uint8_t rep = 0; // 0, 0xF2 or 0xF3 (the last one wins)
+        uint8_t segment = 0; // 0x26/2E/36/3E/64/65
+
+        // ModRM/SIB
+        bool has_modrm = false;
+        uint8_t mod = 0, reg = 0, rm = 0;
+        bool has_sib = false;
+        uint8_t scale = 0, index = 0, base = 0;
+        int64_t disp = 0;
+        bool rip = false, no_base = false;
+
+        int osz = 32; // Operand size in bits
+        int64_t immediate = 0;
+    };
+
+    inline bool Decoder::modrm()
+    {
+        if (has_modrm) {
+            return true;
+        }
+        uint8_t b;
+        if (!byte(b)) {
+            return false;
+        }
+        has_modrm = true;
+        mod = b >> 6;
+        reg = ((b >> 3) & 7) | ((rex & 4) << 1);
+        rm = (b & 7) | ((rex & 1) << 3);
+        if (mod == 3) {
+            return true;
+        }
+        int disp_bytes = mod == 1 ? 1 : (mod == 2 ? 4 : 0);
+        if ((b & 7) == 4) {
+            uint8_t sib;
+            if (!byte(sib)) {
+                return false;
+            }
+            has_sib = true;
+            scale = sib >> 6;
+            index = ((sib >> 3) & 7) | ((rex & 2) << 2);
+            base = (sib & 7) | ((rex & 1) << 3);
+            if ((sib & 7) == 5 && mod == 0) {
+                no_base = true;
+                disp_bytes = 4;
+            }
+        } else if ((b & 7) == 5 && mod == 0) {
+            rip = true;
+            disp_bytes = 4;
+        } else {
+            base = rm;
+        }
+        if (disp_bytes != 0 && !imm(disp_bytes, disp)) {
+            return false;
+        }
+        return true;
+    }
+
+    inline void Decoder::memory_operand(std::string& out) const
+    {
+        if (segment == 0x64 || segment == 0x65) {
+            out += segment == 0x64 ? "%fs:" : "%gs:";
+        }
+        const char* const* regs = p67 ? REG32 : REG64;
+        if (rip) {
+            append_signed_hex(out, disp);
+            out += p67 ? "(%eip)" : "(%rip)";
+            return;
+        }
+        // An index of 4 without REX.X means none; objdump still shows it as %riz
+        // when the SIB byte was not needed for the base alone
+        bool has_index = has_sib && (index != 4 || scale != 0 || (!no_base && (base & 7) != 4));
+        if (no_base && !has_index) {
+            append_hex(out, p67 ? mask(static_cast<uint64_t>(disp), 32) : static_cast<uint64_t>(disp));
+            return;
+        }
+        if (mod != 0 || no_base) {
+            append_signed_hex(out, disp);
+        }
+        out += '(';
+        if (!no_base) {
+            out += '%';
+            out += regs[base];
+        }
+        if (has_index) {
+            out += ",%";
+            out += index == 4 ? (p67 ? "eiz" : "riz") : regs[index];
+            out += ',';
+            out += static_cast<char>('0' + (1 << scale));
+        }
+        out += ')';
+    }
+
+    inline bool Decoder::run(Instruction& insn)
+    {
+        const Tables& t = tables();
+
+        // Legacy prefixes, then an optional REX right before the opcode
+        uint8_t b;
+        for (;;) {
+            if (!byte(b)) {
+                return false;
+            }
+            if (b == 0x66) {
+                p66 = true;
+                ++data16;
+            } else if (b == 0x67) {
+                p67 = true;
+            } else if (b == 0xF0) {
+                lock = true;
+            } else if (b == 0xF2 || b == 0xF3) {
+                rep = b;
+            } else if (b == 0x26 || b == 0x2E || b == 0x36 || b == 0x3E || b == 0x64 || b == 0x65) {
+                segment = b;
+            } else {
+                break;
+            }
+        }
+        if ((b & 0xF0) == 0x40) {
+            rex = b;
+            if (!byte(b)) {
+                return false;
+            }
+        }
+        bool rex_w = rex & 8;
+
+        const Entry* entry;
+        bool two_byte = b == 0x0F;
+        uint8_t opcode = b;
+        if (two_byte) {
+            if (!byte(opcode)) {
+                return false;
+            }
+            entry = &t.two[opcode];
+        } else {
+            entry = &t.one[opcode];
+        }
+
+        // endbr64 (F3 0F 1E FA) and friends live outside the tables
+        if (two_byte && opcode == 0x1E && rep == 0xF3) {
+            uint8_t m;
+            if (!byte(m) || (m != 0xFA && m != 0xFB)) {
+                return false;
+            }
+            insn.text = m == 0xFA ? "endbr64" : "endbr32";
+            return true;
+        }
+
+        const char* name = entry->name;
+        Entry resolved;
+        uint16_t flags = entry->flags;
+        if (flags & GROUP) {
+            if (!modrm()) {
+                return false;
+            }
+            resolved = *entry;
+            if (flags & SSE) {
+                // 66 0F 71-73 /r ib: register-only SSE2 shifts
+                if (!p66 || rep != 0 || mod != 3) {
+                    return false;
+                }
+                p66 = false;
+                --data16;
+                resolved.name = SSE_SHIFTS[opcode - 0x71][reg & 7];
+                resolved.flags &= ~SSE;
+            } else {
+                resolved = t.groups[entry->group][reg & 7];
+            }
+            entry = &resolved;
+            name = entry->name;
+            flags = entry->flags;
+        }
+        if (name == nullptr) {
+            return false;
+        }
+
+        const Operand* ops = entry->op;
+        Operand sse_ops[3];
+        bool rep_consumed = false;
+        if (flags & SSE) {
+            int which = rep == 0xF3 ? 2 : (rep == 0xF2 ? 3 : (p66 ? 1 : 0));
+            name = entry->sse[which];
+            if (name == nullptr) {
+                return false;
+            }
+            rep_consumed = which >= 2;
+            if (which == 1) {
+                p66 = false; // Mandatory prefix, not an operand-size override
+                --data16;
+            }
+            std::copy(entry->op, entry->op + 3, sse_ops);
+            if (opcode == 0x7E && which == 2) {
+                sse_ops[0] = Vx;
+                sse_ops[1] = Wx;
+            } else if ((opcode == 0x6E || opcode == 0x7E) && rex_w) {
+                name = "movq";
+            } else if ((opcode == 0x12 || opcode == 0x16) && which == 0) {
+                if (!modrm()) {
+                    return false;
+                }
+                if (mod == 3) {
+                    name = opcode == 0x12 ? "movhlps" : "movlhps";
+                }
+            }
+            ops = sse_ops;
+        }
+
+        osz = rex_w ? 64 : (p66 ? 16 : ((flags & DEF64) ? 64 : 32));
+
+        // Opcodes whose name depends on prefixes or operand size
+        if (!two_byte) {
+            if (opcode == 0x90 && !(rex & 1)) {
+                if (rep == 0xF3) {
+                    insn.text = "pause";
+                    return true;
+                }
+                if (!p66) {
+                    insn.text = "nop";
+                    return true;
+                }
+                entry = &t.one[0x91]; // 66 90 is xchg %ax,%ax
+                ops = entry->op;
+                name = "xchg";
+            } else if (opcode == 0x98) {
+                name = osz == 64 ? "cltq" : (osz == 16 ? "cbtw" : "cwtl");
+            } else if (opcode == 0x99) {
+                name = osz == 64 ? "cqto" : (osz == 16 ? "cwtd" : "cltd");
+            } else if (opcode >= 0xB8 && opcode <= 0xBF && rex_w) {
+                name = "movabs";
+            } else if (opcode == 0x63 && !rex_w) {
+                name = "movsxd";
+            }
+        } else if (rep == 0xF3 && (opcode == 0xB8 || opcode == 0xBC || opcode == 0xBD)) {
+            name = opcode == 0xB8 ? "popcnt" : (opcode == 0xBC ? "tzcnt" : "lzcnt");
+            rep_consumed = true;
+        } else if (opcode == 0xB8) {
+            return false;
+        }
+
+        // Operands in Intel order, formatted as they are parsed
+        std::string text[3];
+        int count = 0;
+        for (int i = 0; i < 3 && ops[i] != NONE; ++i) {
+            if (!operand(ops[i], text[i], insn)) {
+                return false;
+            }
+            count = i + 1;
+        }
+        // %rip-relative addresses count from the end of the instruction,
+        // which is only known once the immediates have been read
+        if (rip) {
+            insn.has_target = true;
+            insn.rip_relative = true;
+            insn.target = address + pos + static_cast<uint64_t>(disp);
+            if (p67) {
+                insn.target = mask(insn.target, 32);
+            }
+        }
+
+        // Size suffix: only when no register operand already says it
+        bool memory = false, sized_register = false;
+        int memory_bits = osz;
+        for (int i = 0; i < count; ++i) {
+            switch (ops[i]) {
+            case Eb:
+                (mod == 3 ? sized_register : memory) = true;
+                memory_bits = 8;
+                break;
+            case Ev:
+            case Ew:
+            case Ed:
+            case Ey:
+                (mod == 3 ? sized_register : memory) = true;
+                break;
+            case Xb:
+            case Yb:
+                memory = true;
+                memory_bits = 8;
+                break;
+            case Xv:
+            case Yv:
+                memory = true;
+                break;
+            case Gb:
+            case Gv:
+            case Gy:
+            case Zb:
+            case Zv:
+            case AL:
+            case AX:
+                sized_register = true;
+                break;
+            default:
+                break;
+            }
+        }
+        if (ops[0] == Ey || ops[1] == Ey) {
+            memory_bits = rex_w ? 64 : 32;
+        }
+
+        std::string mnemonic;
+        if (lock) {
+            mnemonic += "lock ";
+        }
+        if (data16 > 1) {
+            for (int i = 1; i < data16; ++i) {
+                mnemonic += "data16 ";
+            }
+        }
+        if (segment != 0 && segment != 0x64 && segment != 0x65) {
+            if (segment == 0x3E && (flags & STAR)) {
+                mnemonic += "notrack ";
+            } else {
+                static constexpr const char* names[] = { "es", "cs", "ss", "ds" };
+                mnemonic += names[(segment - 0x26) >> 3];
+                mnemonic += ' ';
+            }
+        }
+        if (rep != 0 && !rep_consumed) {
+            if (flags & STRING) {
+                mnemonic += rep == 0xF2 ? "repnz " : ((flags & REPZ) ? "repz " : "rep ");
+            } else if (rep == 0xF2 && (flags & BRANCH)) {
+                mnemonic += "bnd ";
+            } else {
+                mnemonic += rep == 0xF2 ? "repnz " : "repz ";
+            }
+        }
+        mnemonic += name;
+        if (flags & MOVX) {
+            mnemonic += size_suffix(osz);
+        } else if (memory && !sized_register && !(flags & NOSUFFIX)) {
+            mnemonic += size_suffix(memory_bits);
+        }
+
+        // AT&T order: sources first
+        std::string& out = insn.text;
+        out = mnemonic;
+        if (count > 0) {
+            if (out.size() < 6) {
+                out.append(6 - out.size(), ' ');
+            }
+            out += ' ';
+            for (int i = count - 1; i >= 0; --i) {
+                if ((flags & STAR) && i == 0) {
+                    out += '*';
+                }
+                out += text[i];
+                if (i > 0) {
+                    out += ',';
+                }
+            }
+        }
+        return true;
+    }
+
+    inline bool Decoder::operand(Operand kind, std::string& out, Instruction& insn)
+    {
+        switch (kind) {
+        case Eb:
+        case Ev:
+        case Ew:
+        case Ed:
+        case Ey:
+        case M:
+        case Wx: {
+            if (!modrm()) {
+                return false;
+            }
+            if (mod != 3) {
+                memory_operand(out);
+                return true;
+            }
+            if (kind == M) {
+                return false;
+            }
+            if (kind == Wx) {
+                xmm_operand(out, rm);
+                return true;
+            }
+            int bits = kind == Eb ? 8 : (kind == Ew ? 16 : (kind == Ed ? 32 : (kind == Ey ? ((rex & 8) ? 64 : 32) : osz)));
+            reg_operand(out, gpr(rm, bits));
+            return true;
+        }
+        case Gb:
+        case Gv:
+        case Gy:
+        case Vx:
+            if (!modrm()) {
+                return false;
+            }
+            if (kind == Vx) {
+                xmm_operand(out, reg);
+            } else {
+                reg_operand(out, gpr(reg, kind == Gb ? 8 : (kind == Gy ? ((rex & 8) ? 64 : 32) : osz)));
+            }
+            return true;
+        case Zb:
+        case Zv: {
+            int r = (code[pos - 1] & 7) | ((rex & 1) << 3);
+            reg_operand(out, gpr(r, kind == Zb ? 8 : osz));
+            return true;
+        }
+        case AL:
+            out += "%al";
+            return true;
+        case AX:
+            reg_operand(out, gpr(0, osz));
+            return true;
+        case CL:
+            out += "%cl";
+            return true;
+        case Ib:
+        case Is:
+        case Iz:
+        case Iv:
+        case Iw: {
+            int bytes = kind == Iw ? 2 : (kind == Ib || kind == Is ? 1 : (kind == Iv ? osz / 8 : (osz == 16 ? 2 : 4)));
+            int64_t value;
+            if (!imm(bytes, value)) {
+                return false;
+            }
+            out += '$';
+            append_hex(out, kind == Ib ? mask(static_cast<uint64_t>(value), 8) : (kind == Iw ? mask(static_cast<uint64_t>(value), 16) : mask(static_cast<uint64_t>(value), osz)));
+            return true;
+        }
+        case Jb:
+        case Jz: {
+            int64_t rel;
+            if (!imm(kind == Jb ? 1 : 4, rel)) {
+                return false;
+            }
+            insn.has_target = true;
+            insn.target = address + pos + static_cast<uint64_t>(rel);
+            append_hex(out, insn.target);
+            return true;
+        }
+        case Ob:
+        case Ov: {
+            int64_t value;
+            if (!imm(p67 ? 4 : 8, value)) {
+                return false;
+            }
+            if (segment == 0x64 || segment == 0x65) {
+                out += segment == 0x64 ? "%fs:" : "%gs:";
+            }
+            append_hex(out, p67 ? mask(static_cast<uint64_t>(value), 32) : static_cast<uint64_t>(value));
+            return true;
+        }
+        case Xb:
+        case Xv:
+            out += segment == 0x64 ? "%fs:(%rsi)" : (segment == 0x65 ? "%gs:(%rsi)" : "%ds:(%rsi)");
+            return true;
+        case Yb:
+        case Yv:
+            out += "%es:(%rdi)";
+            return true;
+        case NONE:
+            break;
+        }
+        return true;
+    }
+
+} // namespace detail
+
+/**
+ * Decode one instruction at code[0..size). `address` is where the code is
+ * considered to live and only affects branch and %rip-relative targets.
+ * Reuse one Instruction across calls to keep its text buffer.
+ * @return insn.valid; see the top of the file for what happens otherwise
+ */
+inline bool decode(const uint8_t* code, size_t size, uint64_t address, Instruction& insn)
+{
+    insn.text.clear();
+    insn.has_target = false;
+    insn.rip_relative = false;
+    insn.target = 0;
+
+    detail::Decoder decoder(code, size, address);
+    insn.valid = decoder.run(insn);
+    if (insn.valid) {
+        insn.length = decoder.length();
+    } else {
+        size_t length = decode_length(code, size);
+        insn.text = length != 0 ? "(unknown)" : "(bad)";
+        insn.has_target = false;
+        insn.rip_relative = false;
+        insn.length = length != 0 ? length : 1;
+    }
+    return insn.valid;
+}
+
+} // namespace x86
+
+#endif
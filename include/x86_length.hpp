@@ -0,0 +1,307 @@
+#pragma once
+
+#ifndef X86_LENGTH_HPP
+#define X86_LENGTH_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// ================= x86-64 Instruction Length Decoder =================
+// Finds instruction boundaries without decoding operands: prefixes, opcode
+// map, ModRM/SIB/displacement and immediate sizes. It covers the whole 64-bit
+// mode encoding space, including x87, SSE, the 0F 38/0F 3A maps and VEX/EVEX,
+// so code the full decoder (x86_decode.hpp) does not understand can still be
+// stepped over. Whether an opcode exists is not checked beyond the encodings
+// that 64-bit mode rules out.
+
+namespace x86 {
+
+namespace length_detail {
+
+    enum : uint8_t {
+        MODRM = 1 << 0,
+        IMM8 = 1 << 1,
+        IMM16 = 1 << 2,
+        IMMZ = 1 << 3, // 2 bytes with 66, else 4
+        IMMV = 1 << 4, // 8 bytes with REX.W, 2 with 66, else 4 (mov r64, imm64)
+        REL32 = 1 << 5, // Near branch displacement, 4 bytes whatever the prefixes
+        MOFFS = 1 << 6, // 8-byte absolute address, 4 with 67
+        INVALID = 1 << 7, // Undefined in 64-bit mode
+    };
+
+    constexpr std::array<uint8_t, 256> make_one_byte_table()
+    {
+        std::array<uint8_t, 256> t {};
+        // 00-3F: eight ALU rows of Eb,Gb / Ev,Gv / Gb,Eb / Gv,Ev / AL,Ib / rAX,Iz
+        for (int row = 0; row < 8; ++row) {
+            int base = row * 8;
+            t[base + 0] = t[base + 1] = t[base + 2] = t[base + 3] = MODRM;
+            t[base + 4] = IMM8;
+            t[base + 5] = IMMZ;
+        }
+        for (int op : { 0x06, 0x07, 0x0E, 0x16, 0x17, 0x1E, 0x1F, 0x27, 0x2F, 0x37, 0x3F }) {
+            t[op] = INVALID; // Segment push/pop and BCD adjustments
+        }
+        for (int op : { 0x60, 0x61, 0x82, 0x9A, 0xCE, 0xD4, 0xD5, 0xD6, 0xEA }) {
+            t[op] = INVALID;
+        }
+        t[0x63] = MODRM;
+        t[0x68] = IMMZ;
+        t[0x69] = MODRM | IMMZ;
+        t[0x6A] = IMM8;
+        t[0x6B] = MODRM | IMM8;
+        for (int op = 0x70; op <= 0x7F; ++op) {
+            t[op] = IMM8;
+        }
+        t[0x80] = t[0x83] = MODRM | IMM8;
+        t[0x81] = MODRM | IMMZ;
+        for (int op = 0x84; op <= 0x8F; ++op) {
+            t[op] = MODRM;
+        }
+        t[0xA0] = t[0xA1] = t[0xA2] = t[0xA3] = MOFFS;
+        t[0xA8] = IMM8;
+        t[0xA9] = IMMZ;
+        for (int op = 0xB0; op <= 0xB7; ++op) {
+            t[op] = IMM8;
+        }
+        for (int op = 0xB8; op <= 0xBF; ++op) {
+            t[op] = IMMV;
+        }
+        t[0xC0] = t[0xC1] = t[0xC6] = MODRM | IMM8;
+        t[0xC7] = MODRM | IMMZ;
+        t[0xC2] = t[0xCA] = IMM16;
+        t[0xC8] = IMM16 | IMM8; // enter
+        t[0xCD] = IMM8;
+        for (int op = 0xD0; op <= 0xD3; ++op) {
+            t[op] = MODRM;
+        }
+        for (int op = 0xD8; op <= 0xDF; ++op) {
+            t[op] = MODRM; // x87
+        }
+        for (int op = 0xE0; op <= 0xE7; ++op) {
+            t[op] = IMM8; // loop/jrcxz, in/out imm8
+        }
+        t[0xE8] = t[0xE9] = REL32;
+        t[0xEB] = IMM8;
+        t[0xF6] = t[0xF7] = MODRM; // test /0 and /1 add an immediate, see below
+        t[0xFE] = t[0xFF] = MODRM;
+        return t;
+    }
+
+    constexpr std::array<uint8_t, 256> make_two_byte_table()
+    {
+        std::array<uint8_t, 256> t {};
+        for (int op = 0; op < 256; ++op) {
+            t[op] = MODRM; // Most of the 0F map
+        }
+        for (int op : { 0x05, 0x06, 0x07, 0x08, 0x09, 0x0B, 0x0E, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x37, 0x77,
+                 0xA0, 0xA1, 0xA2, 0xA8, 0xA9, 0xAA }) {
+            t[op] = 0;
+        }
+        for (int op : { 0x04, 0x0A, 0x0C, 0x24, 0x25, 0x26, 0x27, 0x36, 0x39, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+                 0x7A, 0x7B, 0xA6, 0xA7 }) {
+            t[op] = INVALID;
+        }
+        t[0x0F] = MODRM | IMM8; // 3DNow!, suffix opcode in the immediate position
+        for (int op = 0x70; op <= 0x73; ++op) {
+            t[op] = MODRM | IMM8;
+        }
+        for (int op = 0x80; op <= 0x8F; ++op) {
+            t[op] = REL32;
+        }
+        for (int op = 0xC8; op <= 0xCF; ++op) {
+            t[op] = 0; // bswap
+        }
+        t[0xA4] = t[0xAC] = t[0xBA] = t[0xC2] = t[0xC4] = t[0xC5] = t[0xC6] = MODRM | IMM8;
+        return t;
+    }
+
+    inline constexpr auto ONE_BYTE = make_one_byte_table();
+    inline constexpr auto TWO_BYTE = make_two_byte_table();
+
+    // Opcodes of VEX/EVEX map 1 (0F) that take an imm8; map 3 (0F 3A) always does
+    inline constexpr bool vex_map1_imm8(uint8_t op)
+    {
+        return (op >= 0x70 && op <= 0x73) || op == 0xC2 || (op >= 0xC4 && op <= 0xC6);
+    }
+
+    // Bytes taken by ModRM, SIB and displacement starting at p, or 0 if past end
+    inline size_t modrm_length(const uint8_t* p, const uint8_t* end)
+    {
+        if (p >= end) {
+            return 0;
+        }
+        uint8_t modrm = *p;
+        uint8_t mod = modrm >> 6, rm = modrm & 7;
+        size_t n = 1;
+        if (mod == 3) {
+            return n;
+        }
+        if (rm == 4) {
+            if (p + 1 >= end) {
+                return 0;
+            }
+            ++n;
+            if (mod == 0 && (p[1] & 7) == 5) {
+                n += 4; // No base, disp32
+            }
+        } else if (mod == 0 && rm == 5) {
+            n += 4; // %rip-relative
+        }
+        n += mod == 1 ? 1 : (mod == 2 ? 4 : 0);
+        return n;
+    }
+
+} // namespace length_detail
+
+constexpr size_t MAX_INSTRUCTION_LENGTH = 15;
+
+/**
+ * Length in bytes of the 64-bit mode instruction at code[0..size).
+ * @return 0 if the encoding is invalid in 64-bit mode, longer than 15 bytes,
+ *         or runs past size
+ */
+inline size_t decode_length(const uint8_t* code, size_t size)
+{
+    using namespace length_detail;
+    const uint8_t* p = code;
+    const uint8_t* end = code + (size < MAX_INSTRUCTION_LENGTH ? size : MAX_INSTRUCTION_LENGTH);
+
+    bool opsize = false, addrsize = false, rex_w = false;
+    uint8_t op;
+    for (;;) {
+        if (p >= end) {
+            return 0;
+        }
+        op = *p++;
+        switch (op) {
+        case 0x66:
+            opsize = true;
+            rex_w = false;
+            continue;
+        case 0x67:
+            addrsize = true;
+            rex_w = false;
+            continue;
+        case 0x26:
+        case 0x2E:
+        case 0x36:
+        case 0x3E:
+        case 0x64:
+        case 0x65:
+        case 0xF0:
+        case 0xF2:
+        case 0xF3:
+            rex_w = false; // A REX followed by another prefix is ignored
+            continue;
+        default:
+            break;
+        }
+        if ((op & 0xF0) == 0x40) {
+            rex_w = op & 8;
+            continue;
+        }
+        break;
+    }
+
+    // VEX, EVEX and XOP carry the map and REX bits in their payload
+    int vex_map = -1;
+    size_t tail = 0; // Immediate bytes after ModRM for VEX-style encodings
+    if (op == 0xC5 || op == 0xC4 || op == 0x62 || (op == 0x8F && p < end && (*p & 0x1F) >= 8)) {
+        size_t payload = op == 0xC5 ? 1 : (op == 0x62 ? 3 : 2);
+        if (p + payload >= end) {
+            return 0;
+        }
+        if (op == 0xC5) {
+            vex_map = 1;
+        } else if (op == 0x8F) {
+            vex_map = 0x10 | (p[0] & 0x1F); // XOP maps 8, 9, 0A
+        } else {
+            vex_map = p[0] & (op == 0x62 ? 0x07 : 0x1F);
+        }
+        p += payload;
+        uint8_t vop = *p++;
+        if (vex_map == 1) {
+            tail = vex_map1_imm8(vop) ? 1 : 0;
+            if (vop == 0x77 && op != 0x62) {
+                return static_cast<size_t>(p - code); // vzeroupper/vzeroall: no ModRM
+            }
+        } else if (vex_map == 2 || (op == 0x62 && (vex_map == 5 || vex_map == 6))) {
+            tail = 0; // 0F 38, and the EVEX FP16 maps
+        } else if (vex_map == 3 || vex_map == 0x18) {
+            tail = 1;
+        } else if (vex_map == 0x19) {
+            tail = 0;
+        } else if (vex_map == 0x1A) {
+            tail = 4;
+        } else {
+            return 0;
+        }
+        size_t m = modrm_length(p, end);
+        if (m == 0 || p + m + tail > end) {
+            return 0;
+        }
+        return static_cast<size_t>(p + m + tail - code);
+    }
+
+    uint8_t flags;
+    if (op == 0x0F) {
+        if (p >= end) {
+            return 0;
+        }
+        op = *p++;
+        if (op == 0x38 || op == 0x3A) {
+            if (p >= end) {
+                return 0;
+            }
+            flags = MODRM | (op == 0x3A ? IMM8 : 0);
+            ++p; // Third opcode byte
+        } else {
+            flags = TWO_BYTE[op];
+        }
+    } else {
+        flags = ONE_BYTE[op];
+        if ((op == 0xF6 || op == 0xF7) && p < end && (*p & 0x30) == 0) {
+            flags |= op == 0xF6 ? IMM8 : IMMZ; // test Eb,Ib / Ev,Iz
+        }
+    }
+    if (flags & INVALID) {
+        return 0;
+    }
+
+    if (flags & MODRM) {
+        size_t m = modrm_length(p, end);
+        if (m == 0) {
+            return 0;
+        }
+        p += m;
+    }
+    size_t imm = 0;
+    if (flags & IMM8) {
+        imm += 1;
+    }
+    if (flags & IMM16) {
+        imm += 2;
+    }
+    if (flags & IMMZ) {
+        imm += opsize && !rex_w ? 2 : 4;
+    }
+    if (flags & IMMV) {
+        imm += rex_w ? 8 : (opsize ? 2 : 4);
+    }
+    if (flags & REL32) {
+        imm += 4;
+    }
+    if (flags & MOFFS) {
+        imm += addrsize ? 4 : 8;
+    }
+    if (p + imm > end) {
+        return 0;
+    }
+    return static_cast<size_t>(p + imm - code);
+}
+
+} // namespace x86
+
+#endif
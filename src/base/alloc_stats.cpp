@@ -0,0 +1,26 @@
+#include "stats.hpp"
+#include <cstdlib>
+#include <new>
+
+// 替换全局 operator new/delete 以统计堆分配；未开启 --stats 时只多一次分支。
+// 放在单独的编译单元里，避免与调用方内联后产生 new/free 不匹配的误报。
+
+void* operator new(std::size_t size)
+{
+    Stats::add(Counter::Allocations);
+    Stats::add(Counter::AllocatedBytes, size);
+    if (void* p = std::malloc(size != 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
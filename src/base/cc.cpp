@@ -1,5 +1,6 @@
 #define FMT_HEADER_ONLY
 #include "fle.hpp"
+#include "hex.hpp"
 #include "string_utils.hpp"
 #include "utils.hpp"
 #include <algorithm>
@@ -23,18 +24,32 @@ struct Symbol {
     unsigned int offset;
     unsigned int size;
     std::string name;
+    std::string visibility; // 空表示 default
 
     // 添加构造函数使用 std::regex_match 的结果初始化
     static Symbol from_regex_match(const std::smatch& match, std::string_view section)
     {
-        return {
+        Symbol sym {
             .binding = match[2].str()[0],
             .type = match[3].str(),
             .section = std::string { section },
             .offset = static_cast<unsigned int>(std::stoul(match[1].str(), nullptr, 16)),
             .size = static_cast<unsigned int>(std::stoul(match[5].str(), nullptr, 16)),
-            .name = match[6].str()
+            .name = match[6].str(),
+            .visibility = {},
         };
+
+        // objdump 把非默认的 st_other 可见性写在名字前，如 ".hidden foo"
+        // internal 对链接器的效果和 hidden 相同
+        for (auto [prefix, visibility] : { std::pair { ".hidden "sv, "hidden"sv },
+                 std::pair { ".internal "sv, "hidden"sv }, std::pair { ".protected "sv, "protected"sv } }) {
+            if (sym.name.compare(0, prefix.size(), prefix) == 0) {
+                sym.name.erase(0, prefix.size());
+                sym.visibility = visibility;
+                break;
+            }
+        }
+        return sym;
     }
 };
 
@@ -51,8 +66,14 @@ constexpr auto RELOCATION_FORMATS = std::array {
     std::pair { "R_X86_64_32"sv, RelocationFormat { ".abs"sv, 4 } },
     std::pair { "R_X86_64_32S"sv, RelocationFormat { ".abs32s"sv, 4 } },
     std::pair { "R_X86_64_GOTPCREL"sv, RelocationFormat { ".gotpcrel"sv, 4 } },
-    std::pair { "R_X86_64_GOTPCRELX"sv, RelocationFormat { ".gotpcrel"sv, 4 } },
-    std::pair { "R_X86_64_REX_GOTPCRELX"sv, RelocationFormat { ".gotpcrel"sv, 4 } }
+    std::pair { "R_X86_64_GOTPCRELX"sv, RelocationFormat { ".gotpcrelx"sv, 4 } },
+    std::pair { "R_X86_64_REX_GOTPCRELX"sv, RelocationFormat { ".rexgotpcrelx"sv, 4 } },
+    // 线程局部变量：local-exec 和 initial-exec 模型
+    std::pair { "R_X86_64_TPOFF32"sv, RelocationFormat { ".tpoff32"sv, 4 } },
+    std::pair { "R_X86_64_GOTTPOFF"sv, RelocationFormat { ".gottpoff"sv, 4 } },
+    std::pair { "R_X86_64_TPOFF64"sv, RelocationFormat { ".tpoff64"sv, 8 } },
+    std::pair { "R_X86_64_DTPOFF32"sv, RelocationFormat { ".dtpoff32"sv, 4 } },
+    std::pair { "R_X86_64_DTPOFF64"sv, RelocationFormat { ".dtpoff64"sv, 8 } }
 };
 
 // 解析符号表
@@ -82,6 +103,12 @@ std::vector<Symbol> parse_symbols(const std::string& binary, std::string_view se
     return symbols;
 }
 
+// 非默认可见性作为符号行的第四个字段
+std::string visibility_suffix(const Symbol& sym)
+{
+    return sym.visibility.empty() ? std::string {} : " " + sym.visibility;
+}
+
 // 生成符号行
 std::string format_symbol_line(const Symbol& sym)
 {
@@ -89,9 +116,9 @@ std::string format_symbol_line(const Symbol& sym)
     case 'l':
         return fmt::format("🏷️: {} {} {}", sym.name, sym.size, sym.offset);
     case 'g':
-        return fmt::format("📤: {} {} {}", sym.name, sym.size, sym.offset);
+        return fmt::format("📤: {} {} {}{}", sym.name, sym.size, sym.offset, visibility_suffix(sym));
     case 'w':
-        return fmt::format("📎: {} {} {}", sym.name, sym.size, sym.offset);
+        return fmt::format("📎: {} {} {}{}", sym.name, sym.size, sym.offset, visibility_suffix(sym));
     default:
         throw std::runtime_error(fmt::format("Unsupported symbol binding: {}", sym.binding));
     }
@@ -171,12 +198,10 @@ std::vector<std::string> elf_to_fle(
         if (holding.empty())
             return;
 
-        std::string hex_dump;
-        hex_dump.reserve(3 * holding.size());
-        for (auto byte : holding) {
-            fmt::format_to(std::back_inserter(hex_dump), "{:02x} ", byte);
-        }
-        result.push_back(fmt::format("🔢: {}", trim(hex_dump)));
+        std::string line = "🔢: ";
+        char hex[3 * HEX_BLOCK_BYTES];
+        line.append(hex, hex_encode(holding.data(), holding.size(), hex));
+        result.push_back(std::move(line));
     };
 
     for (size_t i = 0; i < section_data.size(); ++i) {
@@ -259,7 +284,10 @@ void FLE_cc(const std::vector<std::string>& options)
 
     // 解析目标文件
     const auto objdump_output = execute_command(fmt::format("objdump -h {}", binary));
-    FLEWriter writer;
+    const std::filesystem::path input_path { binary };
+    const auto output_path = input_path.parent_path() / fmt::format("{}.fo", input_path.stem().string());
+    // std::cout << fmt::format("output_path: {}\n", output_path.string());
+    FLEWriter writer(output_path.string());
     writer.set_type(".obj");
 
     // 处理每个节
@@ -308,6 +336,10 @@ void FLE_cc(const std::vector<std::string>& options)
             sh_flags |= SHF::EXEC;
         }
 
+        if (contains(flags, "THREAD_LOCAL")) {
+            sh_flags |= SHF::TLS;
+        }
+
         const bool is_nobits = !contains(flags, "CONTENTS");
         if (is_nobits) {
             sh_flags |= SHF::NOBITS;
@@ -340,10 +372,7 @@ void FLE_cc(const std::vector<std::string>& options)
     }
 
     // 写入输出文件
-    const std::filesystem::path input_path { binary };
-    const auto output_path = input_path.parent_path() / fmt::format("{}.fo", input_path.stem().string());
-    // std::cout << fmt::format("output_path: {}\n", output_path.string());
-    writer.write_to_file(output_path.string());
+    writer.finish();
 
     std::filesystem::remove(binary);
 }
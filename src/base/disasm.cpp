@@ -1,9 +1,7 @@
 #include "fle.hpp"
-#include "string_utils.hpp"
-#include "utils.hpp"
-#include <cstdio>
-#include <filesystem>
-#include <fstream>
+#include "reloc.hpp"
+#include "x86_decode.hpp"
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <map>
@@ -11,29 +9,55 @@
 #include <stdexcept>
 #include <string>
 
-// 辅助函数：格式化地址
+// 代码段的输出先攒在缓冲里，攒够这么多再写一次
+constexpr size_t OUTPUT_CHUNK = 64 * 1024;
+
+// 辅助函数：格式化地址，至少 4 位十六进制
 std::string format_address(uint64_t addr)
 {
-    std::stringstream ss;
-    ss << std::hex << std::setw(4) << std::setfill('0') << addr;
-    return ss.str();
+    char buf[17];
+    int n = 0;
+    do {
+        buf[16 - ++n] = "0123456789abcdef"[addr & 0xF];
+        addr >>= 4;
+    } while (addr != 0 || n < 4);
+    return std::string(buf + 16 - n, static_cast<size_t>(n));
+}
+
+// 辅助函数：追加一个字节的两位十六进制
+void append_hex_byte(std::string& out, uint8_t byte)
+{
+    out += "0123456789abcdef"[byte >> 4];
+    out += "0123456789abcdef"[byte & 0xF];
+}
+
+// 辅助函数：用空格补齐到指定列，已经超过则不补
+void pad_to(std::string& out, size_t column)
+{
+    if (out.size() < column) {
+        out.append(column - out.size(), ' ');
+    }
+}
+
+// 辅助函数：追加一条重定位注释，如 "R_X86_64_PC32 get_value-4 "
+void append_reloc(std::string& out, const Relocation& reloc)
+{
+    out += reloc_info(reloc.type).name;
+    out += ' ';
+    out += std::string_view(reloc.symbol);
+    if (reloc.addend != 0) {
+        if (reloc.addend > 0) {
+            out += '+';
+        }
+        out += std::to_string(reloc.addend);
+    }
+    out += ' ';
 }
 
 // 辅助函数：获取重定位类型的字符串表示
 std::string get_reloc_type_str(RelocationType type)
 {
-    switch (type) {
-    case RelocationType::R_X86_64_32:
-        return "R_X86_64_32";
-    case RelocationType::R_X86_64_PC32:
-        return "R_X86_64_PC32";
-    case RelocationType::R_X86_64_64:
-        return "R_X86_64_64";
-    case RelocationType::R_X86_64_32S:
-        return "R_X86_64_32S";
-    default:
-        return "UNKNOWN";
-    }
+    return std::string(reloc_info(type).name);
 }
 
 // 辅助函数：判断是否是代码段
@@ -182,121 +206,68 @@ void FLE_disasm(const FLEObject& obj, const std::string& section_name)
         return;
     }
 
-    // 对于代码段，使用 objdump 反汇编
-    // 创建临时文件来存储段数据
-    std::filesystem::path temp_dir = std::filesystem::temp_directory_path();
-    std::string temp_file = (temp_dir / "section.bin").string();
-
-    // 写入段数据
-    std::ofstream out(temp_file, std::ios::binary);
-    out.write(reinterpret_cast<const char*>(data.data()), data.size());
-    out.close();
-
-    // 构造 objdump 命令
-    std::stringstream cmd;
-    cmd << "objdump -D -b binary -m i386:x86-64 " << temp_file;
-
-    try {
-        std::string output = execute_command(cmd.str());
-
-        std::istringstream iss(output);
-        std::string line;
-        bool start_processing = false;
-        uint64_t next_addr = 0;
-
-        while (std::getline(iss, line)) {
-            if (line.find("Disassembly of section") != std::string::npos) {
-                start_processing = true;
-                continue;
+    // 对于代码段，逐条解码；重定位和符号都按偏移排好序，随解码位置一起前进
+    std::vector<const Relocation*> relocs;
+    for (const auto& [offset, list] : reloc_map) {
+        relocs.insert(relocs.end(), list.begin(), list.end());
+    }
+    auto next_symbol = symbol_map.begin();
+    size_t next_reloc = 0;
+
+    std::string out;
+    out.reserve(OUTPUT_CHUNK + 256);
+    x86::Instruction insn;
+    for (uint64_t addr = 0; addr < data.size(); addr += insn.length) {
+        x86::decode(data.data() + addr, data.size() - addr, addr, insn);
+
+        // 检查是否有符号在这个地址
+        if (obj.type == ".obj") {
+            while (next_symbol != symbol_map.end() && next_symbol->first < addr) {
+                ++next_symbol;
             }
+            if (next_symbol != symbol_map.end() && next_symbol->first == addr) {
+                out += '\n'; // 在符号前添加空行
+                out += next_symbol->second->name;
+                out += ":\n";
+            }
+        }
 
-            if (!start_processing || line.empty() || line.find('>') != std::string::npos)
-                continue;
-
-            line = trim(line);
-            if (line.empty() || !std::isxdigit(line[0]))
-                continue;
-
-            size_t colon_pos = line.find(':');
-            if (colon_pos != std::string::npos) {
-                // 提取当前指令的地址
-                std::string addr_str = line.substr(0, colon_pos);
-                uint64_t addr;
-                std::stringstream ss;
-                ss << std::hex << addr_str;
-                ss >> addr;
-
-                // 检查是否有符号在这个地址
-                if (obj.type == ".obj") {
-                    auto sym_it = symbol_map.find(addr);
-                    if (sym_it != symbol_map.end()) {
-                        std::cout << std::endl; // 在符号前添加空行
-                        std::cout << sym_it->second->name << ":" << std::endl;
-                    }
-                }
-
-                // 提取机器码和指令
-                std::string rest = line.substr(colon_pos + 1);
-                rest = trim(rest);
-
-                size_t instr_pos = rest.find_first_not_of("0123456789abcdef ");
-                if (instr_pos != std::string::npos) {
-                    std::string bytes = trim(rest.substr(0, instr_pos));
-                    std::string instr = trim(rest.substr(instr_pos));
-
-                    // 如果是.obj文件，去掉objdump的注释
-                    if (obj.type == ".obj") {
-                        size_t comment_pos = instr.find('#');
-                        if (comment_pos != std::string::npos) {
-                            instr = trim(instr.substr(0, comment_pos));
-                        }
-                    }
-
-                    // 计算指令长度
-                    std::istringstream byte_stream(bytes);
-                    std::string byte;
-                    size_t instr_len = 0;
-                    while (byte_stream >> byte) {
-                        if (byte.length() == 2)
-                            instr_len++;
-                    }
-                    next_addr = addr + instr_len;
-
-                    // 基本输出
-                    std::cout << format_address(addr) << ": "
-                              << std::left << std::setfill(' ') << std::setw(30) << bytes
-                              << std::left << std::setw(30) << instr;
-
-                    // 检查这条指令范围内的重定位信息
-                    if (obj.type == ".obj") {
-                        bool has_reloc = false;
-                        for (uint64_t offset = addr; offset < next_addr; offset++) {
-                            auto reloc_it = reloc_map.find(offset);
-                            if (reloc_it != reloc_map.end()) {
-                                if (!has_reloc) {
-                                    std::cout << "# ";
-                                    has_reloc = true;
-                                }
-                                for (const auto* reloc : reloc_it->second) {
-                                    std::cout << get_reloc_type_str(reloc->type) << " "
-                                              << reloc->symbol;
-                                    if (reloc->addend != 0) {
-                                        std::cout << std::showpos << std::dec << reloc->addend;
-                                    }
-                                    std::cout << " ";
-                                }
-                            }
-                        }
-                    }
-                    std::cout << std::endl;
-                }
+        // 地址、机器码、指令
+        out += format_address(addr);
+        out += ": ";
+        size_t column = out.size();
+        for (size_t i = 0; i < insn.length; ++i) {
+            if (i > 0) {
+                out += ' ';
             }
+            append_hex_byte(out, data[addr + i]);
         }
+        pad_to(out, std::max(column + 30, out.size() + 1)); // 超长指令至少留一个空格
+        column = out.size();
+        out += insn.text;
+        if (insn.rip_relative && obj.type != ".obj") {
+            out += "        # ";
+            x86::append_hex(out, insn.target);
+        }
+        pad_to(out, column + 30);
 
-        std::filesystem::remove(temp_file);
+        // 这条指令范围内的重定位信息
+        while (next_reloc < relocs.size() && relocs[next_reloc]->offset < addr) {
+            ++next_reloc;
+        }
+        if (next_reloc < relocs.size() && relocs[next_reloc]->offset < addr + insn.length) {
+            out += "# ";
+            for (; next_reloc < relocs.size() && relocs[next_reloc]->offset < addr + insn.length; ++next_reloc) {
+                append_reloc(out, *relocs[next_reloc]);
+            }
+        }
+        out += '\n';
 
-    } catch (const std::exception& e) {
-        std::filesystem::remove(temp_file);
-        throw;
+        if (out.size() >= OUTPUT_CHUNK) {
+            std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
     }
-}
\ No newline at end of file
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    std::cout.flush();
+}
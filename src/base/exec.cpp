@@ -1,13 +1,32 @@
+#include "file_io.hpp"
 #include "fle.hpp"
+#include "parallel.hpp"
+#include "reloc.hpp"
+#include "stats.hpp"
 #include "string_utils.hpp"
+#include "symbol_index.hpp"
+#include "tls.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <csignal>
 #include <cstdint>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <stdexcept>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <ucontext.h>
 #include <unistd.h>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -17,293 +36,1040 @@ struct LoadedModule {
     std::string name;
     FLEObject obj;
     uint64_t load_base;
-    std::map<std::string, uint64_t> section_addrs;
+    std::map<std::string, uint64_t, std::less<>> section_addrs;
+
+    // Range-extension thunks, mapped right after the module image so that
+    // every rel32 branch in the module can reach them
+    uint64_t thunk_base = 0;
+    size_t thunk_capacity = 0;
+    std::map<uint64_t, uint64_t> thunks; // Branch target -> thunk address
+
+    // Static TLS block: the template at tls_image holds tls_file_size bytes of
+    // .tdata out of tls_size; each thread's copy sits at TP - tls_offset
+    uint64_t tls_image = 0;
+    uint64_t tls_file_size = 0;
+    uint64_t tls_size = 0;
+    uint64_t tls_offset = 0;
 };
 
+// Thunk layout: jmp *0(%rip) followed by the 8-byte absolute target
+constexpr size_t THUNK_SIZE = 16;
+constexpr uint64_t PAGE_SIZE = 4096;
+
+uint64_t page_align_up(uint64_t addr)
+{
+    return (addr + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+}
+
+uint64_t page_align_down(uint64_t addr)
+{
+    return addr & ~(PAGE_SIZE - 1);
+}
+
+// A page-aligned run of memory with one set of permissions
+struct MemoryRange {
+    uint64_t start;
+    uint64_t end;
+    int prot;
+};
+
+int segment_prot(uint32_t flags)
+{
+    return (flags & PHF::R ? PROT_READ : 0) | (flags & PHF::W ? PROT_WRITE : 0) | (flags & PHF::X ? PROT_EXEC : 0);
+}
+
+// Page-aligned [start, end) covering every non-empty segment, relative to the load base; {0, 0} if none
+std::pair<uint64_t, uint64_t> image_extent(const FLEObject& obj)
+{
+    uint64_t start = UINT64_MAX;
+    uint64_t end = 0;
+    for (const auto& phdr : obj.phdrs) {
+        if (phdr.size > 0) {
+            start = std::min(start, page_align_down(phdr.vaddr));
+            end = std::max(end, page_align_up(phdr.vaddr + phdr.size));
+        }
+    }
+    return end == 0 ? std::pair<uint64_t, uint64_t> { 0, 0 } : std::pair { start, end };
+}
+
+// Whether the rel32 field at data[pos] is the operand of a call/jmp/jcc rel32,
+// i.e. a reference that a thunk can stand in for
+bool is_branch_rel32(const std::vector<uint8_t>& data, size_t pos)
+{
+    if (pos >= 1 && pos <= data.size() && (data[pos - 1] == 0xe8 || data[pos - 1] == 0xe9))
+        return true;
+    return pos >= 2 && pos <= data.size() && data[pos - 2] == 0x0f && (data[pos - 1] & 0xf0) == 0x80;
+}
+
+// Same as above for a dynamic relocation, whose offset is a segment vaddr
+bool is_branch_dyn_reloc(const FLEObject& obj, const Relocation& reloc)
+{
+    for (const auto& phdr : obj.phdrs) {
+        if (reloc.offset < phdr.vaddr || reloc.offset >= phdr.vaddr + phdr.size)
+            continue;
+        auto it = obj.sections.find(phdr.name);
+        return it != obj.sections.end() && is_branch_rel32(it->second.data, reloc.offset - phdr.vaddr);
+    }
+    return false;
+}
+
+// Upper bound on the thunks a module can need: one per PC32 branch
+size_t count_thunk_candidates(const FLEObject& obj)
+{
+    size_t count = 0;
+    for (const auto& reloc : obj.dyn_relocs) {
+        if (reloc.type == RelocationType::R_X86_64_PC32 && is_branch_dyn_reloc(obj, reloc))
+            count++;
+    }
+    for (const auto& [name, section] : obj.sections) {
+        for (const auto& reloc : section.relocs) {
+            if (reloc.type == RelocationType::R_X86_64_PC32 && is_branch_rel32(section.data, reloc.offset))
+                count++;
+        }
+    }
+    return count;
+}
+
+// Map the main executable's thunk area at addr, never clobbering an existing
+// mapping. Shared objects carve theirs out of the module reservation instead.
+void map_thunk_area(LoadedModule& mod, uint64_t addr)
+{
+    if (mod.thunk_capacity == 0)
+        return;
+
+    size_t size = page_align_up(mod.thunk_capacity * THUNK_SIZE);
+    void* res = mmap((void*)addr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    Stats::add(Counter::MemorySyscalls);
+    if (res == MAP_FAILED) {
+        throw std::runtime_error("Failed to map thunk area for " + mod.name + ": " + strerror(errno));
+    }
+    mod.thunk_base = (uint64_t)res;
+}
+
+// Return a thunk in mod that jumps to target, creating it on first use
+uint64_t get_thunk(LoadedModule& mod, uint64_t target)
+{
+    auto it = mod.thunks.find(target);
+    if (it != mod.thunks.end())
+        return it->second;
+
+    if (mod.thunks.size() >= mod.thunk_capacity) {
+        throw std::runtime_error("Out of range-extension thunks in " + mod.name);
+    }
+
+    static constexpr uint8_t jmp_rip[] = { 0xff, 0x25, 0x00, 0x00, 0x00, 0x00 };
+    uint64_t addr = mod.thunk_base + mod.thunks.size() * THUNK_SIZE;
+    memcpy((void*)addr, jmp_rip, sizeof(jmp_rip));
+    memcpy((void*)(addr + sizeof(jmp_rip)), &target, sizeof(target));
+    mod.thunks[target] = addr;
+    return addr;
+}
+
+// S for a PC32 relocation: if the branch target is beyond rel32 reach,
+// send it through a thunk placed next to the module instead
+uint64_t pc32_branch_target(LoadedModule& mod, uint64_t S, int64_t A, uint64_t P)
+{
+    const auto& info = reloc_info(RelocationType::R_X86_64_PC32);
+    auto disp = static_cast<int64_t>(S + A - P);
+    if (disp >= info.min && disp <= info.max)
+        return S;
+
+    // rel32 is the last field of the branch, so it lands on S + A - P + (P + 4)
+    uint64_t target = S + A + 4;
+    uint64_t thunk = get_thunk(mod, target);
+    return thunk - 4 - A;
+}
+
 // Global list of loaded modules to maintain loading order
 // Order: Main Execution -> Dependency 1 -> Dependency 2 ...
 std::vector<LoadedModule> loaded_modules;
 std::unordered_set<std::string> loaded_module_names;
 
-// Flag: true if any SO has PC32 dyn_relocs (requires all SOs in low address space)
+// Flag: true if any SO has 32-bit dyn_relocs that a thunk cannot fix
+// (PC32 data references, absolute 32-bit), which requires all SOs in low address space
 bool need_low_address = false;
-std::unordered_set<std::string> scanned_names;
+std::unordered_map<std::string, FLEObject> scanned_modules; // Parsed by the pre-scan, not yet loaded
 
-// Helper to load FLE from file (searches FLE_LIBRARY_PATH)
-FLEObject load_fle_with_path(const std::string& filename)
+// Directories from $FLE_LIBRARY_PATH, split once per process
+const std::vector<std::string>& library_search_path()
 {
-    // Try direct path
-    try {
-        return load_fle(filename);
-    } catch (...) {
-    }
+    static const std::vector<std::string> dirs = [] {
+        const char* env = std::getenv("FLE_LIBRARY_PATH");
+        return env != nullptr ? split_search_path(env) : std::vector<std::string> {};
+    }();
+    return dirs;
+}
 
-    try {
-        return load_fle(filename + ".fle");
-    } catch (...) {
+// Where a dependency lives: the name itself, name + ".fle", then each
+// FLE_LIBRARY_PATH directory by basename and by the full name. Existence is
+// answered from cached directory listings, so failed candidates cost nothing.
+std::optional<std::string> find_module(const std::string& filename)
+{
+    DirectoryCache& dir_cache = DirectoryCache::get();
+    if (dir_cache.is_regular_file(filename)) {
+        return filename;
+    }
+    if (dir_cache.is_regular_file(filename + ".fle")) {
+        return filename + ".fle";
     }
 
-    // Search in FLE_LIBRARY_PATH
-    const char* lib_path_env = std::getenv("FLE_LIBRARY_PATH");
-    if (lib_path_env != nullptr) {
-        std::string lib_path(lib_path_env);
-        std::string basename = filename;
-        size_t last_slash = filename.rfind('/');
-        if (last_slash != std::string::npos) {
-            basename = filename.substr(last_slash + 1);
-        }
-
-        std::vector<std::string> paths;
-        size_t start = 0;
-        size_t end = lib_path.find(':');
-        while (end != std::string::npos) {
-            if (end > start)
-                paths.push_back(lib_path.substr(start, end - start));
-            start = end + 1;
-            end = lib_path.find(':', start);
-        }
-        if (start < lib_path.size())
-            paths.push_back(lib_path.substr(start));
-
-        for (const auto& path : paths) {
-            try {
-                return load_fle(path + "/" + basename);
-            } catch (...) {
-            }
-            try {
-                return load_fle(path + "/" + filename);
-            } catch (...) {
+    std::string basename = get_basename(filename);
+    for (const auto& dir : library_search_path()) {
+        for (const auto& candidate : { dir + "/" + basename, dir + "/" + filename }) {
+            if (dir_cache.is_regular_file(candidate)) {
+                return candidate;
             }
         }
     }
-    throw std::runtime_error("Could not load: " + filename);
+    return std::nullopt;
 }
 
-// Pre-scan dependencies to check if any SO has PC32 dyn_relocs
-void scan_dependencies_recursive(const std::string& filename)
+// Helper to load FLE from file (searches FLE_LIBRARY_PATH)
+FLEObject load_fle_with_path(const std::string& filename)
 {
-    if (scanned_names.count(filename))
-        return;
+    auto path = find_module(filename);
+    if (!path) {
+        throw std::runtime_error("Could not load: " + filename);
+    }
+    return load_fle(*path);
+}
 
-    FLEObject obj;
-    try {
-        obj = load_fle_with_path(filename);
-    } catch (...) {
-        return; // Will fail later during actual load
+// Pre-scan: parse every module reachable from roots and check whether any SO
+// needs low address placement. The files of one dependency level do not
+// depend on each other, so each level is found and parsed concurrently.
+void scan_dependencies(const std::vector<std::string>& roots)
+{
+    std::unordered_set<std::string> queued;
+    std::vector<std::string> level;
+    for (const auto& root : roots) {
+        if (queued.insert(root).second) {
+            level.push_back(root);
+        }
     }
 
-    scanned_names.insert(filename);
+    while (!level.empty()) {
+        std::vector<std::optional<FLEObject>> parsed(level.size());
+        parallel_for(level.size(), [&](size_t i) {
+            try {
+                parsed[i] = load_fle_with_path(level[i]);
+            } catch (...) {
+                // Will fail later during actual load
+            }
+        });
 
-    // Check for PC32 dyn_relocs
-    if (obj.type == ".so") {
-        for (const auto& reloc : obj.dyn_relocs) {
-            if (reloc.type == RelocationType::R_X86_64_PC32) {
-                need_low_address = true;
-                break;
+        std::vector<std::string> next;
+        for (size_t i = 0; i < level.size(); ++i) {
+            if (!parsed[i]) {
+                continue;
+            }
+            // Kept for collect_modules, so every module is parsed once
+            FLEObject& obj = scanned_modules[level[i]] = std::move(*parsed[i]);
+
+            // PC32 branches get thunks; other 32-bit dyn_relocs still need low addresses
+            if (obj.type == ".so") {
+                for (const auto& reloc : obj.dyn_relocs) {
+                    bool is_pc32_branch = reloc.type == RelocationType::R_X86_64_PC32 && is_branch_dyn_reloc(obj, reloc);
+                    if (reloc_info(reloc.type).size == 4 && !is_pc32_branch) {
+                        need_low_address = true;
+                        break;
+                    }
+                }
             }
-        }
-    }
 
-    // Recurse into dependencies
-    for (const auto& dep : obj.needed) {
-        scan_dependencies_recursive(dep);
+            for (const auto& dep : obj.needed) {
+                if (queued.insert(dep).second) {
+                    next.push_back(dep);
+                }
+            }
+        }
+        level = std::move(next);
     }
 }
 
-// Helper to resolve a symbol across all loaded modules
-uint64_t resolve_symbol(const std::string& name)
+struct GlobalSymbol {
+    uint64_t address;
+    size_t size;
+    const LoadedModule* tls_module; // Defining module if the symbol is thread-local, else nullptr
+    SymbolVisibility visibility; // PROTECTED: the defining module binds its own references to it
+};
+
+// Exported symbols of all modules in load order; the first definition of a
+// name wins, which is what a search through loaded_modules would find
+std::unordered_map<InternedString, GlobalSymbol> global_symbols;
+
+void publish_global_symbols()
 {
+    global_symbols.clear();
     for (const auto& mod : loaded_modules) {
+        // Only shared objects export: the symbol table an executable carries is for tools and profiling
+        if (mod.obj.type == ".exe") {
+            continue;
+        }
         for (const auto& sym : mod.obj.symbols) {
             // We search for GLOBAL or WEAK symbols that are defined (not UNDEFINED)
-            if (sym.name == name && (sym.type == SymbolType::GLOBAL || sym.type == SymbolType::WEAK)) {
-                auto it = mod.section_addrs.find(sym.section);
+            if (sym.type == SymbolType::GLOBAL || sym.type == SymbolType::WEAK) {
+                auto it = mod.section_addrs.find(sym.section.view());
                 if (it != mod.section_addrs.end()) {
-                    return it->second + sym.offset;
+                    global_symbols.emplace(sym.name,
+                        GlobalSymbol { it->second + sym.offset, sym.size, is_tls_section(it->first) ? &mod : nullptr,
+                            sym.visibility });
                 }
             }
         }
     }
-    throw std::runtime_error("Symbol not found: " + name);
 }
 
-void load_module_recursive(const std::string& filename)
+// Helper to resolve a symbol across all loaded modules
+uint64_t resolve_symbol(InternedString name)
 {
-    if (loaded_module_names.count(filename)) {
-        return;
+    auto it = global_symbols.find(name);
+    if (it == global_symbols.end()) {
+        throw std::runtime_error("Symbol not found: " + name);
     }
+    return it->second.address;
+}
 
-    // Load FLE file
-    // Try direct path first, then search in FLE_LIBRARY_PATH
-    FLEObject obj;
-    bool loaded = false;
-
-    // Try direct path
-    try {
-        obj = load_fle(filename);
-        loaded = true;
-    } catch (...) {
-        // Try with extensions
-        try {
-            obj = load_fle(filename + ".fle");
-            loaded = true;
-        } catch (...) {
-            // Continue to search in library path
-        }
-    }
-
-    // If not found, search in FLE_LIBRARY_PATH
-    if (!loaded) {
-        const char* lib_path_env = std::getenv("FLE_LIBRARY_PATH");
-        if (lib_path_env != nullptr) {
-            std::string lib_path(lib_path_env);
-            std::string basename = filename;
-            // Extract basename from path if it contains directory separators
-            size_t last_slash = filename.rfind('/');
-            if (last_slash != std::string::npos) {
-                basename = filename.substr(last_slash + 1);
-            }
+// S for a dynamic relocation of mod: one of mod's own output sections (a
+// base-relative address, with the offset in the addend) or a global symbol
+uint64_t resolve_dyn_symbol(const LoadedModule& mod, InternedString name)
+{
+    auto section = mod.section_addrs.find(name.view());
+    if (section != mod.section_addrs.end()) {
+        return section->second;
+    }
+    return resolve_symbol(name);
+}
 
-            // Split FLE_LIBRARY_PATH by ':'
-            std::vector<std::string> paths;
-            size_t start = 0;
-            size_t end = lib_path.find(':');
-            while (end != std::string::npos) {
-                if (end > start) {
-                    paths.push_back(lib_path.substr(start, end - start));
-                }
-                start = end + 1;
-                end = lib_path.find(':', start);
-            }
-            if (start < lib_path.size()) {
-                paths.push_back(lib_path.substr(start));
-            }
+// Offset from the thread pointer of the thread-local variable whose template
+// copy is at addr in mod
+uint64_t tp_offset(const LoadedModule& mod, uint64_t addr)
+{
+    return addr - mod.tls_image - mod.tls_offset;
+}
 
-            // Try each path
-            for (const auto& path : paths) {
-                std::string full_path = path + "/" + basename;
-                try {
-                    obj = load_fle(full_path);
-                    loaded = true;
-                    break;
-                } catch (...) {
-                    // Try original filename (maybe it's a relative path)
-                    try {
-                        obj = load_fle(path + "/" + filename);
-                        loaded = true;
-                        break;
-                    } catch (...) {
-                        // Continue searching
-                    }
-                }
-            }
+// S for a TPOFF relocation of mod: a TLS output section of mod itself
+// (.tdata/.tbss, with the offset in the addend) or an exported TLS symbol
+uint64_t resolve_tp_offset(const LoadedModule& mod, InternedString name)
+{
+    auto section = mod.section_addrs.find(name.view());
+    if (is_tls_section(name.view()) && section != mod.section_addrs.end()) {
+        return tp_offset(mod, section->second);
+    }
+    auto it = global_symbols.find(name);
+    if (it == global_symbols.end()) {
+        throw std::runtime_error("Symbol not found: " + name);
+    }
+    if (it->second.tls_module == nullptr) {
+        throw std::runtime_error("TLS relocation against non-TLS symbol: " + name);
+    }
+    return tp_offset(*it->second.tls_module, it->second.address);
+}
+
+// A shared library data object and the executable's slot for it
+struct CopyJob {
+    uint64_t slot;
+    uint64_t source;
+    size_t size;
+};
+
+// Make each slot named by the executable's copy relocations the definition
+// every module binds to. The library originals are copied in by the caller
+// once relocation has settled their contents.
+std::vector<CopyJob> redirect_copied_symbols(const LoadedModule& exe)
+{
+    std::vector<CopyJob> jobs;
+    for (const auto& reloc : exe.obj.dyn_relocs) {
+        if (reloc.type != RelocationType::R_X86_64_COPY) {
+            continue;
+        }
+        auto it = global_symbols.find(reloc.symbol);
+        if (it == global_symbols.end()) {
+            throw std::runtime_error("Symbol not found: " + reloc.symbol);
+        }
+        // The library would keep using its original, so the two would drift apart
+        if (it->second.visibility == SymbolVisibility::PROTECTED) {
+            throw std::runtime_error("Copy relocation against protected symbol " + reloc.symbol
+                + ": its library now accesses it directly; relink the executable");
+        }
+        // The addend is the size ld reserved; a library rebuilt with a larger
+        // object would otherwise be copied over whatever follows the slot
+        if (it->second.size > static_cast<uint64_t>(reloc.addend)) {
+            throw std::runtime_error("Copy relocation against " + reloc.symbol + ": symbol size "
+                + std::to_string(it->second.size) + " exceeds the " + std::to_string(reloc.addend)
+                + " bytes reserved in the executable; relink the executable");
         }
+        jobs.push_back({ reloc.offset, it->second.address, it->second.size });
+        it->second.address = reloc.offset;
     }
+    return jobs;
+}
 
-    if (!loaded) {
-        throw std::runtime_error("Could not load dependency: " + filename);
+// Append filename and its dependencies to loaded_modules depth-first, which
+// fixes the symbol search order; nothing is mapped yet
+void collect_modules(const std::string& filename)
+{
+    if (loaded_module_names.count(filename)) {
+        return;
+    }
+
+    // Reuse the object parsed by the pre-scan; only modules it could not load are searched again
+    FLEObject obj;
+    auto scanned = scanned_modules.find(filename);
+    if (scanned != scanned_modules.end()) {
+        obj = std::move(scanned->second);
+        scanned_modules.erase(scanned);
+    } else {
+        auto path = find_module(filename);
+        if (!path) {
+            throw std::runtime_error("Could not load dependency: " + filename);
+        }
+        obj = load_fle(*path);
     }
 
     loaded_module_names.insert(filename);
 
-    // Prepare LoadedModule structure
+    std::vector<std::string> needed = obj.needed;
     LoadedModule mod;
     mod.name = filename;
-    mod.obj = obj;
+    mod.obj = std::move(obj);
+    loaded_modules.push_back(std::move(mod));
+
+    // Recursively collect dependencies
+    for (const auto& dep : needed) {
+        collect_modules(dep);
+    }
+}
+
+// Copy each segment's section data into place and record where it landed
+void copy_segments(LoadedModule& mod)
+{
+    for (const auto& phdr : mod.obj.phdrs) {
+        if (phdr.size == 0)
+            continue;
+
+        auto it = mod.obj.sections.find(phdr.name);
+        if (it == mod.obj.sections.end()) {
+            throw std::runtime_error("Section data not found for segment: " + phdr.name);
+        }
+
+        // Skip BSS copying; the anonymous mapping is already zero
+        auto* target_addr = reinterpret_cast<uint8_t*>(mod.load_base + phdr.vaddr);
+        if (phdr.name != ".bss" && !starts_with(phdr.name, ".bss.")) {
+            memcpy(target_addr, it->second.data.data(), std::min<size_t>(it->second.data.size(), phdr.size));
+        }
+
+        // Record section address
+        mod.section_addrs[phdr.name] = (uint64_t)target_addr;
+    }
+}
+
+// Map a module's image as one read-write mapping and copy its segments in.
+// Protect narrows the permissions afterwards. Shared objects each get their
+// own reservation, so several can be mapped at once.
+void map_module(LoadedModule& mod)
+{
+    const FLEObject& obj = mod.obj;
+    auto [image_start, image_end] = image_extent(obj);
 
-    // Determine load base and map memory
     if (obj.type == ".exe") {
         mod.load_base = 0; // Exe has absolute addresses usually
+        if (image_end > 0) {
+            void* addr = mmap((void*)image_start, image_end - image_start, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
+            Stats::add(Counter::MemorySyscalls);
+            if (addr == MAP_FAILED) {
+                throw std::runtime_error(std::string("mmap failed: ") + strerror(errno));
+            }
+        }
+
+        // The executable sits at a fixed low address, so calls into shared libraries
+        // loaded anywhere may need a thunk; put the thunk area right after the image
+        mod.thunk_capacity = count_thunk_candidates(obj);
+        map_thunk_area(mod, image_end);
+    } else if (image_end > 0) {
+        // Reserve the image plus its thunk area in one go so thunks stay within rel32 reach.
+        // Without a hint the kernel picks (and randomises) the base.
+        mod.thunk_capacity = count_thunk_candidates(obj);
+        uint64_t image_size = image_end - image_start;
+        uint64_t total_size = image_size + page_align_up(mod.thunk_capacity * THUNK_SIZE);
+
+        void* addr;
+        if (need_low_address) {
+            // Use MAP_32BIT for 32-bit text relocations that thunks cannot redirect
+            addr = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+            if (addr == MAP_FAILED) {
+                // Fallback without MAP_32BIT
+                addr = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            }
+        } else {
+            // PIC code (GOT/PLT with R_X86_64_64) can be loaded anywhere
+            addr = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        Stats::add(Counter::MemorySyscalls);
+
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("Failed to reserve memory for shared library");
+        }
+        mod.load_base = (uint64_t)addr - image_start;
+        if (mod.thunk_capacity > 0) {
+            mod.thunk_base = (uint64_t)addr + image_size;
+        }
     } else {
-        // For shared objects, we need to find a space.
-        // Calculate total size required
-        uint64_t min_vaddr = UINT64_MAX;
-        uint64_t max_end = 0;
-        bool has_segments = false;
-
-        for (const auto& phdr : obj.phdrs) {
-            if (phdr.size > 0) {
-                if (phdr.vaddr < min_vaddr)
-                    min_vaddr = phdr.vaddr;
-                uint64_t end = phdr.vaddr + phdr.size;
-                if (end > max_end)
-                    max_end = end;
-                has_segments = true;
+        mod.load_base = 0;
+    }
+
+    copy_segments(mod);
+}
+
+/**
+ * Final permissions of mod's image and thunk area, in address order.
+ * A page shared by two segments gets the permissions of both. Gaps between
+ * segments become inaccessible. Neighbours with equal permissions are merged,
+ * so each range is one mprotect and ends up as one VMA.
+ */
+std::vector<MemoryRange> protection_ranges(const LoadedModule& mod)
+{
+    std::vector<MemoryRange> segments;
+    for (const auto& phdr : mod.obj.phdrs) {
+        if (phdr.size > 0) {
+            uint64_t addr = mod.load_base + phdr.vaddr;
+            segments.push_back({ page_align_down(addr), page_align_up(addr + phdr.size), segment_prot(phdr.flags) });
+        }
+    }
+    std::sort(segments.begin(), segments.end(),
+        [](const MemoryRange& a, const MemoryRange& b) { return a.start < b.start; });
+    if (mod.thunk_base != 0) {
+        // Right after the image, so the order holds
+        uint64_t size = page_align_up(mod.thunk_capacity * THUNK_SIZE);
+        segments.push_back({ mod.thunk_base, mod.thunk_base + size, PROT_READ | PROT_EXEC });
+    }
+
+    // Pages must take one set of permissions, so overlapping segments are unioned first
+    std::vector<MemoryRange> pages;
+    for (const auto& segment : segments) {
+        if (!pages.empty() && segment.start < pages.back().end) {
+            pages.back().end = std::max(pages.back().end, segment.end);
+            pages.back().prot |= segment.prot;
+        } else {
+            pages.push_back(segment);
+        }
+    }
+
+    std::vector<MemoryRange> ranges;
+    for (const auto& range : pages) {
+        if (!ranges.empty() && range.start > ranges.back().end) {
+            ranges.push_back({ ranges.back().end, range.start, PROT_NONE });
+        }
+        if (!ranges.empty() && range.prot == ranges.back().prot) {
+            ranges.back().end = range.end;
+        } else {
+            ranges.push_back(range);
+        }
+    }
+    return ranges;
+}
+
+// Resolve every relocation of mod into batch. Symbol lookups only read
+// global_symbols and thunks are per module, so modules can run concurrently.
+void relocate_module(LoadedModule& mod, RelocBatch& batch)
+{
+    // A. Dynamic Relocations (Bonus 1 - Text Relocations for SO, Bonus 2 - GOT for EXE)
+    // For .so: dyn_relocs.offset is relative to merged section data (typically .text)
+    // For .exe: dyn_relocs.offset is VMA (already resolved during linking)
+    for (const auto& reloc : mod.obj.dyn_relocs) {
+        if (reloc.type == RelocationType::R_X86_64_COPY) {
+            continue; // See redirect_copied_symbols
+        }
+        uint64_t reloc_addr;
+
+        if (mod.obj.type == ".exe") {
+            // For executables, offset is the VMA
+            reloc_addr = reloc.offset;
+        } else {
+            // For shared objects, offset is VMA relative to Load Base
+            reloc_addr = mod.load_base + reloc.offset;
+        }
+
+        uint64_t sym_addr;
+        if (reloc.type == RelocationType::R_X86_64_TPOFF64) {
+            sym_addr = resolve_tp_offset(mod, reloc.symbol);
+        } else {
+            sym_addr = resolve_dyn_symbol(mod, reloc.symbol);
+        }
+        if (reloc.type == RelocationType::R_X86_64_PC32 && is_branch_dyn_reloc(mod.obj, reloc)) {
+            sym_addr = pc32_branch_target(mod, sym_addr, reloc.addend, reloc_addr);
+        }
+        batch.add(reloc.type, { reinterpret_cast<uint8_t*>(reloc_addr), sym_addr, reloc.addend, reloc_addr },
+            { mod.name, "dyn_relocs", reloc.symbol, reloc.offset });
+    }
+
+    // B. Section Relocations (Bonus 1 - Text Relocations)
+    // Iterate over sections to find relocations
+    for (const auto& [name, section] : mod.obj.sections) {
+        // Check if this section is loaded.
+        auto addr_it = mod.section_addrs.find(name);
+        if (addr_it == mod.section_addrs.end())
+            continue;
+
+        // In FLE, section relocs have offset relative to the section start.
+        // section_addrs holds the absolute runtime address: the VMA itself for
+        // the executable (load_base 0), load_base + vaddr for a shared object.
+        uint64_t section_runtime_addr = addr_it->second;
+
+        for (const auto& reloc : section.relocs) {
+            uint64_t sym_addr = resolve_symbol(reloc.symbol);
+            uint64_t reloc_addr = section_runtime_addr + reloc.offset;
+            if (reloc.type == RelocationType::R_X86_64_PC32 && is_branch_rel32(section.data, reloc.offset)) {
+                sym_addr = pc32_branch_target(mod, sym_addr, reloc.addend, reloc_addr);
             }
+            batch.add(reloc.type, { reinterpret_cast<uint8_t*>(reloc_addr), sym_addr, reloc.addend, reloc_addr },
+                { mod.name, name, reloc.symbol, reloc.offset });
         }
+    }
+}
 
-        if (has_segments) {
-            uint64_t total_size = max_end;
+// ================= Thread-local storage =================
+// Every module's TLS block lives in one static area below the thread pointer,
+// the executable's first, then shared objects in load order. The template is
+// that area as a new thread must start out: each block's .tdata after
+// relocation, zeros for .tbss. Every thread's area is a copy of it followed
+// by a thread control block.
 
-            void* addr;
-            if (need_low_address) {
-                // Use MAP_32BIT for PC32 text relocations (can only reach ±2GB)
-                std::cerr << "Warning: Loading " << filename << " into low 32-bit address space due to PC32 relocations." << std::endl;
-                addr = mmap(NULL, total_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
-                if (addr == MAP_FAILED) {
-                    // Fallback without MAP_32BIT
-                    addr = mmap(NULL, total_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-                }
-            } else {
-                // PIC code (GOT/PLT with R_X86_64_64) can be loaded anywhere
-                addr = mmap(NULL, total_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+struct TlsTemplate {
+    std::vector<uint8_t> image; // Ends at the thread pointer
+    uint64_t stack_guard = 0; // The C library's values, which the
+    uint64_t pointer_guard = 0; // program's code may compare against
+
+    size_t area_size() const { return page_align_up(image.size() + TCB_RESERVED); }
+};
+
+TlsTemplate tls_template;
+
+// Find each module's TLS template and give it an offset below the thread pointer
+void layout_tls()
+{
+    uint64_t below = 0;
+    for (auto& mod : loaded_modules) {
+        uint64_t start = UINT64_MAX;
+        uint64_t end = 0;
+        for (const auto& phdr : mod.obj.phdrs) {
+            if (!is_tls_section(phdr.name) || phdr.size == 0)
+                continue;
+            start = std::min(start, phdr.vaddr);
+            end = std::max(end, phdr.vaddr + phdr.size);
+            if (phdr.name == ".tdata")
+                mod.tls_file_size = phdr.size;
+        }
+        if (end == 0)
+            continue;
+
+        mod.tls_image = mod.load_base + start;
+        mod.tls_size = end - start;
+        mod.tls_offset = below = tls_block_offset(below, mod.tls_size);
+    }
+    tls_template.image.assign(below, 0);
+}
+
+// Snapshot every block once relocation has settled the .tdata contents
+void build_tls_template()
+{
+    auto& image = tls_template.image;
+    for (const auto& mod : loaded_modules) {
+        if (mod.tls_size != 0) {
+            memcpy(image.data() + image.size() - mod.tls_offset, (const void*)mod.tls_image, mod.tls_file_size);
+        }
+    }
+
+    uint64_t host_tp = 0;
+    syscall(SYS_arch_prctl, ARCH_GET_FS, &host_tp);
+    const auto* host_tcb = reinterpret_cast<const uint8_t*>(host_tp);
+    uint64_t self = 0;
+    memcpy(&self, host_tcb + TCB_SELF, sizeof(self));
+    if (self != host_tp) {
+        throw std::runtime_error("Unexpected thread control block layout in the C library");
+    }
+    memcpy(&tls_template.stack_guard, host_tcb + TCB_STACK_GUARD, sizeof(uint64_t));
+    memcpy(&tls_template.pointer_guard, host_tcb + TCB_POINTER_GUARD, sizeof(uint64_t));
+}
+
+// System call that leaves errno alone. The thread area functions run on the
+// program's threads, where %fs does not lead to the C library's TLS; on
+// failure the result is -errno.
+long raw_syscall(long nr, long a1 = 0, long a2 = 0, long a3 = 0, long a4 = 0, long a5 = 0, long a6 = 0)
+{
+    register long r10 asm("r10") = a4;
+    register long r8 asm("r8") = a5;
+    register long r9 asm("r9") = a6;
+    long ret;
+    asm volatile("syscall"
+        : "=a"(ret)
+        : "a"(nr), "D"(a1), "S"(a2), "d"(a3), "r"(r10), "r"(r8), "r"(r9)
+        : "rcx", "r11", "memory");
+    return ret;
+}
+
+/**
+ * Map a thread area initialised from tmpl and return its thread pointer, or 0
+ * if the mapping fails. Uses neither the C library's TLS nor exceptions, so
+ * the program's threads can call it.
+ */
+uint64_t map_thread_area(const TlsTemplate& tmpl)
+{
+    size_t size = tmpl.area_size();
+    long area = raw_syscall(SYS_mmap, 0, static_cast<long>(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area < 0) {
+        return 0;
+    }
+
+    uint64_t tp = static_cast<uint64_t>(area) + size - TCB_RESERVED;
+    memcpy(reinterpret_cast<void*>(tp - tmpl.image.size()), tmpl.image.data(), tmpl.image.size());
+
+    auto* tcb = reinterpret_cast<uint8_t*>(tp);
+    memcpy(tcb + TCB_SELF, &tp, sizeof(tp));
+    memcpy(tcb + TCB_SELF_ALIAS, &tp, sizeof(tp));
+    memcpy(tcb + TCB_STACK_GUARD, &tmpl.stack_guard, sizeof(uint64_t));
+    memcpy(tcb + TCB_POINTER_GUARD, &tmpl.pointer_guard, sizeof(uint64_t));
+    return tp;
+}
+
+// The initial thread's area, mapped before the program starts
+uint64_t create_thread_area(const TlsTemplate& tmpl)
+{
+    Stats::add(Counter::MemorySyscalls);
+    uint64_t tp = map_thread_area(tmpl);
+    if (tp == 0) {
+        throw std::runtime_error("Failed to map thread area");
+    }
+    return tp;
+}
+
+// __fle_thread_area_alloc / __fle_thread_area_free, see tls.hpp
+void* thread_area_alloc()
+{
+    return reinterpret_cast<void*>(map_thread_area(tls_template));
+}
+
+void thread_area_free(void* tp)
+{
+    if (tp != nullptr) {
+        size_t size = tls_template.area_size();
+        raw_syscall(SYS_munmap, static_cast<long>(reinterpret_cast<uint64_t>(tp) + TCB_RESERVED - size), static_cast<long>(size));
+    }
+}
+
+// Make the loader's own functions resolvable like exports of a shared object
+void publish_loader_symbols()
+{
+    global_symbols[intern(THREAD_AREA_ALLOC)] = { reinterpret_cast<uint64_t>(&thread_area_alloc), 0, nullptr, SymbolVisibility::DEFAULT };
+    global_symbols[intern(THREAD_AREA_FREE)] = { reinterpret_cast<uint64_t>(&thread_area_free), 0, nullptr, SymbolVisibility::DEFAULT };
+}
+
+// ================= Symbol index =================
+
+SymbolIndex symbol_index; // Published for the crash reporter and the profiler
+
+// Bounds of the main thread stack: the upper end of the [stack] mapping and
+// the lowest address RLIMIT_STACK lets it grow down to (128 MiB below if
+// unlimited). The kernel keeps that range free for the stack, so no other
+// thread's stack can sit inside. Both stay 0 if the mapping cannot be found.
+void find_main_stack(SymbolIndex& index)
+{
+    constexpr uint64_t UNLIMITED_STACK_REACH = uint64_t(128) << 20;
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+        if (line.size() >= 7 && line.compare(line.size() - 7, 7, "[stack]") == 0) {
+            uint64_t top = std::strtoull(line.c_str() + line.find('-') + 1, nullptr, 16);
+            rlimit limit {};
+            uint64_t reach = UNLIMITED_STACK_REACH;
+            if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+                reach = limit.rlim_cur;
             }
+            index.stack_top = top;
+            index.stack_bottom = top > reach ? top - reach : 0;
+            return;
+        }
+    }
+}
 
-            if (addr == MAP_FAILED) {
-                throw std::runtime_error("Failed to reserve memory for shared library");
+// Index every defined symbol, segment and thunk area of loaded_modules
+void build_symbol_index()
+{
+    symbol_index.clear();
+    for (const auto& mod : loaded_modules) {
+        std::unordered_map<std::string_view, uint64_t> section_ends;
+        for (const auto& phdr : mod.obj.phdrs) {
+            uint64_t start = mod.load_base + phdr.vaddr;
+            section_ends[phdr.name] = start + phdr.size;
+            symbol_index.add_region(start, start + phdr.size, "[" + mod.name + "]", mod.name, phdr.flags & PHF::X);
+        }
+        if (mod.thunk_base != 0) {
+            symbol_index.add_region(mod.thunk_base, mod.thunk_base + mod.thunk_capacity * THUNK_SIZE, "[thunk]",
+                mod.name, true);
+        }
+
+        for (const auto& sym : mod.obj.symbols) {
+            auto it = mod.section_addrs.find(sym.section.view());
+            if (sym.type == SymbolType::UNDEFINED || it == mod.section_addrs.end()) {
+                continue;
             }
-            mod.load_base = (uint64_t)addr;
-        } else {
-            mod.load_base = 0;
+            // Without a size, a label covers the rest of its section up to the next symbol
+            uint64_t start = it->second + sym.offset;
+            uint64_t end = sym.size != 0 ? start + sym.size : section_ends[sym.section.view()];
+            symbol_index.add_symbol(start, end, sym.name.view(), mod.name, sym.type == SymbolType::LOCAL);
         }
     }
+    symbol_index.finish();
+    find_main_stack(symbol_index);
+}
 
-    // Map segments
-    for (const auto& phdr : obj.phdrs) {
-        if (phdr.size == 0)
-            continue;
+// ================= Sampling profiler =================
+// `exec --profile`: the program runs in a forked child with an ITIMER_PROF
+// timer. The SIGPROF handler appends RIP and the saved-%rbp chain to a buffer
+// shared with the parent, which waits for the child, maps every address back
+// to an FLE symbol through symbol_index and writes the report. The fork is
+// what lets the report be written at all: programs leave through a raw exit
+// syscall, so nothing runs in their own process after the last sample.
+
+constexpr size_t PROFILE_MAX_DEPTH = 64;
+constexpr size_t PROFILE_BUFFER_WORDS = size_t(8) << 20; // 64 MiB, only touched pages are committed
+
+struct ProfileBuffer {
+    // Updated from SIGPROF handlers that can run on several threads at once
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> dropped; // Samples that did not fit
+    std::atomic<uint64_t> used; // Words of frames[] reserved
+    // Per sample: depth, then depth words: RIP, the word at %rsp (the caller if
+    // RIP is in a frameless leaf, checked when symbolising), then the return
+    // addresses of the %rbp chain, innermost first. A slot the program exited
+    // before filling stays zero, and readers skip zero depths.
+    uint64_t frames[PROFILE_BUFFER_WORDS];
+};
 
-        void* target_addr = (void*)(mod.load_base + phdr.vaddr);
-        void* map_res = mmap(target_addr, phdr.size,
-            PROT_READ | PROT_WRITE, // Always RW initially for copying and relocation
-            MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
+ProfileBuffer* profile_buffer = nullptr;
 
-        if (map_res == MAP_FAILED) {
-            throw std::runtime_error("Failed to map segment " + phdr.name);
+// Read size bytes at addr without faulting if they are unmapped; for stacks
+// whose bounds exec does not know
+bool read_checked(uint64_t addr, void* out, size_t size)
+{
+    iovec local { out, size };
+    iovec remote { reinterpret_cast<void*>(addr), size };
+    long pid = raw_syscall(SYS_getpid);
+    return raw_syscall(SYS_process_vm_readv, pid, reinterpret_cast<long>(&local), 1, reinterpret_cast<long>(&remote), 1, 0)
+        == static_cast<long>(size);
+}
+
+// Async-signal-safe: on the main thread reads only the interrupted stack,
+// between %rsp and its top; on other threads every read is checked
+void profile_handler(int, siginfo_t*, void* ctx)
+{
+    const auto* gregs = static_cast<ucontext_t*>(ctx)->uc_mcontext.gregs;
+    auto sp = static_cast<uint64_t>(gregs[REG_RSP]);
+    auto fp = static_cast<uint64_t>(gregs[REG_RBP]);
+    uint64_t stack_top = symbol_index.stack_top_for(sp);
+    uint64_t frame[PROFILE_MAX_DEPTH];
+    frame[0] = static_cast<uint64_t>(gregs[REG_RIP]);
+    size_t depth = 2;
+    if (stack_top != 0) {
+        frame[1] = sp % 8 == 0 && sp + 8 <= stack_top ? *reinterpret_cast<const uint64_t*>(sp) : 0;
+        depth += walk_frames(fp, sp, stack_top, frame + 2, PROFILE_MAX_DEPTH - 2);
+    } else {
+        if (sp % 8 != 0 || !read_checked(sp, &frame[1], sizeof(uint64_t))) {
+            frame[1] = 0;
         }
+        depth += walk_frames(fp, sp, UINT64_MAX, frame + 2, PROFILE_MAX_DEPTH - 2,
+            [](uint64_t addr, uint64_t* words) { return read_checked(addr, words, 2 * sizeof(uint64_t)); });
+    }
 
-        // Copy section data
-        auto it = obj.sections.find(phdr.name);
-        if (it != obj.sections.end()) {
-            // Skip BSS copying
-            if (phdr.name != ".bss" && !starts_with(phdr.name, ".bss.")) {
-                if (it->second.data.size() > phdr.size) {
-                    // Should not happen if FLE is valid, but safety check
-                    memcpy(target_addr, it->second.data.data(), phdr.size);
-                } else {
-                    memcpy(target_addr, it->second.data.data(), it->second.data.size());
-                }
+    // Reserve the words first so that concurrent handlers never share a slot
+    ProfileBuffer& buffer = *profile_buffer;
+    uint64_t start = buffer.used.load(std::memory_order_relaxed);
+    do {
+        if (start + depth + 1 > PROFILE_BUFFER_WORDS) {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } while (!buffer.used.compare_exchange_weak(start, start + depth + 1, std::memory_order_relaxed));
+    buffer.frames[start] = depth;
+    memcpy(&buffer.frames[start + 1], frame, depth * sizeof(uint64_t));
+    buffer.samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+const char* profile_name(const AddressRange* range)
+{
+    return range != nullptr ? range->name : "[unknown]";
+}
+
+/**
+ * Symbolised stack of one sample, outermost frame first; nullptr stands for
+ * an unknown address. The word at %rsp is kept only if it returns from a
+ * direct call to the sampled function, and frames above the program's first
+ * one belong to exec itself.
+ */
+std::vector<const AddressRange*> profile_stack(const uint64_t* frame, uint64_t depth)
+{
+    std::vector<const AddressRange*> entries;
+    for (uint64_t i = depth; i-- > 0;) {
+        if (i == 1 && !symbol_index.returns_from(frame[1], frame[0])) {
+            continue;
+        }
+        // Return addresses are looked up inside the call, not after it
+        const AddressRange* entry = symbol_index.lookup(i == 0 ? frame[0] : frame[i] - 1);
+        if (entries.empty() && entry == nullptr) {
+            continue;
+        }
+        entries.push_back(entry);
+    }
+    if (entries.empty()) {
+        entries.push_back(symbol_index.lookup(frame[0]));
+    }
+    return entries;
+}
+
+// Flat profile: self and total (inclusive) samples per symbol, hottest first
+void write_flat_profile(std::ostream& out, const ProfileBuffer& buffer, const std::string& program, double cpu_ms)
+{
+    struct Counts {
+        uint64_t self = 0;
+        uint64_t total = 0;
+    };
+    std::unordered_map<const AddressRange*, Counts> counts;
+    std::unordered_set<const AddressRange*> seen;
+    for (uint64_t pos = 0; pos < buffer.used; pos += buffer.frames[pos] + 1) {
+        if (buffer.frames[pos] == 0) {
+            continue;
+        }
+        auto stack = profile_stack(&buffer.frames[pos + 1], buffer.frames[pos]);
+        seen.clear();
+        for (const auto* entry : stack) {
+            if (seen.insert(entry).second) {
+                counts[entry].total++; // Once per sample, however deep the recursion
             }
-        } else {
-            throw std::runtime_error("Section data not found for segment: " + phdr.name);
         }
+        counts[symbol_index.lookup(buffer.frames[pos + 1])].self++;
+    }
 
-        // Record section address
-        mod.section_addrs[phdr.name] = (uint64_t)target_addr;
+    std::vector<std::pair<const AddressRange*, Counts>> rows(counts.begin(), counts.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        if (a.second.self != b.second.self) {
+            return a.second.self > b.second.self;
+        }
+        if (a.second.total != b.second.total) {
+            return a.second.total > b.second.total;
+        }
+        return std::strcmp(profile_name(a.first), profile_name(b.first)) < 0;
+    });
+
+    double samples = static_cast<double>(std::max<uint64_t>(buffer.samples.load(), 1));
+    out << "# FLE profile of " << program << ": " << buffer.samples.load() << " samples over " << std::fixed
+        << std::setprecision(1) << cpu_ms << " ms of CPU time";
+    if (buffer.dropped.load() != 0) {
+        out << ", " << buffer.dropped.load() << " dropped";
+    }
+    out << "\n#  self%     self  total%    total  symbol [module]\n"
+        << std::fixed << std::setprecision(2);
+    for (const auto& [entry, count] : rows) {
+        out << std::setw(7) << 100.0 * count.self / samples << std::setw(9) << count.self
+            << std::setw(8) << 100.0 * count.total / samples << std::setw(9) << count.total
+            << "  " << profile_name(entry);
+        if (entry != nullptr) {
+            out << " [" << entry->module << "]";
+        }
+        out << '\n';
     }
+}
 
-    // Add to specific list location (Global symbol resolution order)
-    loaded_modules.push_back(mod);
+// Folded stacks ("outer;inner count" per line), the input format of flame graph tools
+void write_folded_profile(std::ostream& out, const ProfileBuffer& buffer)
+{
+    std::map<std::string, uint64_t> stacks;
+    std::string stack;
+    for (uint64_t pos = 0; pos < buffer.used; pos += buffer.frames[pos] + 1) {
+        if (buffer.frames[pos] == 0) {
+            continue;
+        }
+        stack.clear();
+        for (const auto* entry : profile_stack(&buffer.frames[pos + 1], buffer.frames[pos])) {
+            stack += stack.empty() ? "" : ";";
+            stack += profile_name(entry);
+        }
+        stacks[stack]++;
+    }
+    for (const auto& [line, count] : stacks) {
+        out << line << ' ' << count << '\n';
+    }
+}
 
-    // Recursively load dependencies
-    for (const auto& dep : obj.needed) {
-        load_module_recursive(dep);
+/**
+ * Fork for a profiled run. Returns in the child with the SIGPROF timer armed;
+ * the parent waits, writes the profile and exits with the child's status.
+ */
+void start_profiling(const std::string& program, const ExecOptions& options)
+{
+    if (options.profileHz <= 0 || options.profileHz > 1000000) {
+        throw std::runtime_error("Invalid profile frequency: " + std::to_string(options.profileHz));
+    }
+    void* mem = mmap(nullptr, sizeof(ProfileBuffer), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED) {
+        throw std::runtime_error(std::string("Failed to map profile buffer: ") + strerror(errno));
+    }
+    profile_buffer = static_cast<ProfileBuffer*>(mem); // Zero-filled by mmap
+
+    std::cout.flush();
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error(std::string("fork failed: ") + strerror(errno));
+    }
+
+    if (pid == 0) {
+        struct sigaction sa {};
+        sa.sa_sigaction = profile_handler;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGPROF, &sa, nullptr);
+        suseconds_t interval = std::max(1000000 / options.profileHz, 1);
+        itimerval timer { { 0, interval }, { 0, interval } };
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        return;
+    }
+
+    // Ctrl-C reaches the child too; keep going so the profile is still written
+    signal(SIGINT, SIG_IGN);
+    int status = 0;
+    rusage usage {};
+    while (wait4(pid, &status, 0, &usage) < 0) {
+        if (errno != EINTR) {
+            throw std::runtime_error(std::string("waitpid failed: ") + strerror(errno));
+        }
+    }
+
+    std::ofstream out(options.profileFile);
+    if (!out) {
+        throw std::runtime_error("Cannot write profile " + options.profileFile);
+    }
+    if (options.profileFolded) {
+        write_folded_profile(out, *profile_buffer);
+    } else {
+        double cpu_ms = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+        write_flat_profile(out, *profile_buffer, program, cpu_ms);
+    }
+    out.close();
+    std::cerr << "exec: " << profile_buffer->samples.load() << " samples written to " << options.profileFile << std::endl;
+
+    // Leave the way the program did
+    if (WIFSIGNALED(status)) {
+        signal(WTERMSIG(status), SIG_DFL);
+        raise(WTERMSIG(status));
     }
+    std::exit(WIFEXITED(status) ? WEXITSTATUS(status) : 1);
 }
 
 } // namespace
 
-void FLE_exec(const FLEObject& obj)
+void FLE_exec(const FLEObject& obj, const ExecOptions& options)
 {
     if (obj.type != ".exe") {
         throw std::runtime_error("File is not an executable FLE.");
@@ -312,173 +1078,130 @@ void FLE_exec(const FLEObject& obj)
     // Clear globals for fresh execution
     loaded_modules.clear();
     loaded_module_names.clear();
-    scanned_names.clear();
+    scanned_modules.clear();
     need_low_address = false;
 
+    TraceScope startup("FLE_exec startup", obj.name);
+
     // Pre-scan all dependencies to check if any SO has PC32 dyn_relocs
     // This must be done BEFORE loading so we know whether to use MAP_32BIT
-    for (const auto& dep : obj.needed) {
-        scan_dependencies_recursive(dep);
-    }
+    TraceScope scan_phase("Scan dependencies");
+    scan_dependencies(obj.needed);
+    scan_phase.stop();
 
     // 1. Load Main Executable (Manual setup for the main object provided)
-    // We treat the passed object as the first module but we need its name.
-    // Since we don't have the filename here, we use a placeholder or obj.name if valid.
-
-    // Actually, recursive loader expects loading from disk.
-    // But we already have the main object in memory.
-    // We should initialize the main module manually.
-
+    // We already have the main object in memory, so it is set up by hand
+    // rather than through collect_modules.
+    TraceScope map_phase("Map modules");
     LoadedModule main_mod;
     main_mod.name = obj.name.empty() ? "main" : obj.name;
     main_mod.obj = obj;
-    main_mod.load_base = 0;
-
-    // Map Main Executable segments
-    for (const auto& phdr : obj.phdrs) {
-        if (phdr.size == 0)
-            continue;
+    map_module(main_mod);
 
-        void* addr = mmap((void*)phdr.vaddr, phdr.size,
-            PROT_READ | PROT_WRITE, // RW for relocations
-            MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
-
-        if (addr == MAP_FAILED) {
-            throw std::runtime_error(std::string("mmap failed: ") + strerror(errno));
-        }
+    loaded_modules.push_back(std::move(main_mod));
+    loaded_module_names.insert(loaded_modules.front().name);
 
-        auto it = obj.sections.find(phdr.name);
-        if (it == obj.sections.end()) {
-            throw std::runtime_error("Section not found: " + phdr.name);
-        }
+    // Fix the load order (and with it the symbol search order) before mapping
+    for (const auto& dep : obj.needed) {
+        collect_modules(dep);
+    }
 
-        if (phdr.name != ".bss" && !starts_with(phdr.name, ".bss.")) {
-            memcpy(addr, it->second.data.data(), phdr.size);
+    // Warn here rather than in map_module so the messages keep load order
+    if (need_low_address) {
+        for (size_t i = 1; i < loaded_modules.size(); ++i) {
+            const auto& phdrs = loaded_modules[i].obj.phdrs;
+            if (std::none_of(phdrs.begin(), phdrs.end(), [](const auto& phdr) { return phdr.size > 0; })) {
+                continue;
+            }
+            std::cerr << "Warning: Loading " << loaded_modules[i].name
+                      << " into low 32-bit address space due to 32-bit relocations." << std::endl;
         }
-
-        main_mod.section_addrs[phdr.name] = phdr.vaddr;
     }
 
-    loaded_modules.push_back(main_mod);
-    loaded_module_names.insert(main_mod.name);
+    // Shared objects get their own reservations, so they map independently
+    parallel_for(loaded_modules.size() - 1, [&](size_t i) { map_module(loaded_modules[i + 1]); });
 
-    // Load dependencies of main
-    for (const auto& dep : obj.needed) {
-        load_module_recursive(dep);
-    }
+    map_phase.stop();
 
     // 2. Perform Relocations for ALL modules
-    for (auto& mod : loaded_modules) {
-
-        // A. Dynamic Relocations (Bonus 1 - Text Relocations for SO, Bonus 2 - GOT for EXE)
-        // For .so: dyn_relocs.offset is relative to merged section data (typically .text)
-        // For .exe: dyn_relocs.offset is VMA (already resolved during linking)
-        for (const auto& reloc : mod.obj.dyn_relocs) {
-            uint64_t reloc_addr;
-
-            if (mod.obj.type == ".exe") {
-                // For executables, offset is the VMA
-                reloc_addr = reloc.offset;
-            } else {
-                // For shared objects, offset is VMA relative to Load Base
-                reloc_addr = mod.load_base + reloc.offset;
-            }
-
-            uint64_t sym_addr = resolve_symbol(reloc.symbol);
-
-            switch (reloc.type) {
-            case RelocationType::R_X86_64_64:
-                *(uint64_t*)reloc_addr = sym_addr + reloc.addend;
-                break;
-            case RelocationType::R_X86_64_32:
-                *(uint32_t*)reloc_addr = (uint32_t)(sym_addr + reloc.addend);
-                break;
-            case RelocationType::R_X86_64_32S:
-                *(int32_t*)reloc_addr = (int32_t)(sym_addr + reloc.addend);
-                break;
-            case RelocationType::R_X86_64_PC32:
-                // S + A - P
-                *(uint32_t*)reloc_addr = (uint32_t)(sym_addr + reloc.addend - reloc_addr);
-                break;
-            case RelocationType::R_X86_64_GOTPCREL:
-                *(uint32_t*)reloc_addr = (uint32_t)(sym_addr + reloc.addend - reloc_addr);
-                break;
-            }
+    TraceScope reloc_phase("Relocate");
+    layout_tls(); // TP offsets are relocation values
+    publish_global_symbols();
+    publish_loader_symbols();
+    std::vector<CopyJob> copies = redirect_copied_symbols(loaded_modules.front());
+
+    // Each module resolves into its own batch; the first error in load order wins
+    std::vector<RelocBatch> batches(loaded_modules.size());
+    std::vector<std::string> errors(loaded_modules.size());
+    parallel_for(loaded_modules.size(), [&](size_t i) {
+        try {
+            relocate_module(loaded_modules[i], batches[i]);
+        } catch (const std::exception& e) {
+            errors[i] = e.what();
         }
+    });
+    for (const auto& error : errors) {
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
 
-        // B. Section Relocations (Bonus 1 - Text Relocations)
-        // Iterate over sections to find relocations
-        for (const auto& kv : mod.obj.sections) {
-            const auto& name = kv.first;
-            const auto& section = kv.second;
+    RelocBatch batch;
+    for (auto& module_batch : batches) {
+        batch.merge(std::move(module_batch));
+    }
 
-            // Check if this section is loaded.
-            auto addr_it = mod.section_addrs.find(name);
-            if (addr_it == mod.section_addrs.end())
-                continue;
+    // Symbols are resolved; range-check and write every relocation, one specialised loop per type
+    batch.apply();
 
-            // In FLE, section relocs have offset relative to the section start
-            // phdr.vaddr corresponds to the section start VMA relative to Load Base (for SO) or Absolute (for EXE)
-            // Wait, for .so, phdr.vaddr is offset from base.
-            // But we stored the Absolute Runtime Address in section_addrs.
-            // But apply_reloc adds load_base + section_base ...
-
-            // Let's adjust logic.
-            // For Main (.exe), load_base = 0. section_addr is absolute.
-            // For .so, load_base = allocated. section_addr is absolute = load_base + vaddr.
-
-            // Reloc offset is relative to section start.
-            // address = section_absolute_start + reloc.offset.
-            // We can pass `section_absolute_start - load_base` as 2nd arg?
-            // Or just calculate address and adapt lambda.
-
-            uint64_t section_runtime_addr = addr_it->second;
-
-            for (const auto& reloc : section.relocs) {
-                uint64_t sym_addr = resolve_symbol(reloc.symbol);
-                uint64_t reloc_addr = section_runtime_addr + reloc.offset;
-
-                switch (reloc.type) {
-                case RelocationType::R_X86_64_64:
-                    *(uint64_t*)reloc_addr = sym_addr + reloc.addend;
-                    break;
-                case RelocationType::R_X86_64_32:
-                    *(uint32_t*)reloc_addr = (uint32_t)(sym_addr + reloc.addend);
-                    break;
-                case RelocationType::R_X86_64_32S:
-                    *(int32_t*)reloc_addr = (int32_t)(sym_addr + reloc.addend);
-                    break;
-                case RelocationType::R_X86_64_PC32:
-                    *(uint32_t*)reloc_addr = (uint32_t)(sym_addr + reloc.addend - reloc_addr);
-                    break;
-                case RelocationType::R_X86_64_GOTPCREL:
-                    *(uint32_t*)reloc_addr = (uint32_t)(sym_addr + reloc.addend - reloc_addr);
-                    break;
-                }
-            }
-        }
+    // Copy after relocation so that pointers inside the objects are already final
+    for (const auto& copy : copies) {
+        memcpy((void*)copy.slot, (const void*)copy.source, copy.size);
+    }
+    build_tls_template();
+    reloc_phase.stop();
+
+    // Only programs with thread-local variables get their own thread pointer
+    uint64_t thread_pointer = 0;
+    if (!tls_template.image.empty()) {
+        TraceScope tls_phase("Thread area");
+        thread_pointer = create_thread_area(tls_template);
     }
 
     // 3. Set Permissions (after all relocations are done)
+    TraceScope protect_phase("Protect");
     for (const auto& mod : loaded_modules) {
-        for (const auto& phdr : mod.obj.phdrs) {
-            if (phdr.size == 0)
-                continue;
+        for (const auto& range : protection_ranges(mod)) {
+            mprotect((void*)range.start, range.end - range.start, range.prot);
+            Stats::add(Counter::MemorySyscalls);
+        }
+    }
 
-            // Find runtime address
-            uint64_t addr = mod.load_base + phdr.vaddr;
+    protect_phase.stop();
 
-            mprotect((void*)addr, phdr.size,
-                (phdr.flags & PHF::R ? PROT_READ : 0)
-                    | (phdr.flags & PHF::W ? PROT_WRITE : 0)
-                    | (phdr.flags & PHF::X ? PROT_EXEC : 0));
-        }
+    // Crash reports and profiles name the program's own symbols
+    TraceScope index_phase("Symbol index");
+    build_symbol_index();
+    SymbolIndex::publish(&symbol_index);
+    index_phase.stop();
+    startup.stop();
+
+    // The program exits without returning here, so write the trace and stats now
+    TimeTrace::get().flush();
+    Stats::report();
+
+    if (!options.profileFile.empty()) {
+        start_profiling(obj.name, options);
     }
 
     // 4. Jump to Entry
     using FuncType = int (*)();
     // Entry is VMA. Main EXE base is 0. So entry is absolute.
     FuncType func = reinterpret_cast<FuncType>(obj.entry);
+    // Nothing may touch the C library's TLS from here on
+    if (thread_pointer != 0) {
+        HostThreadPointer::switch_to(thread_pointer);
+    }
     func();
 
     // Should not reach here
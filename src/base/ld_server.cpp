@@ -0,0 +1,365 @@
+#include "file_io.hpp"
+#include "fle.hpp"
+#include "string_utils.hpp"
+#include "trace.hpp"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// 链接服务协议：客户端连上 Unix socket，发送一个 JSON 请求后关闭写端；
+// 服务端处理完写回一个 JSON 响应并关闭连接。
+//   请求 {"command": "link", "cwd": ..., "args": [...]} 或 {"command": "stop"}
+//   响应 {"status": 退出码, "stdout": ..., "stderr": ...}
+// 请求逐个串行处理，链接本身已经在 FLE_ld 内部并行。链接会切换工作目录、
+// 重定向标准输出，本来就不能同时进行；为了不让一个卡住的客户端拖住整个服务，
+// 每个连接的读写都有时限。
+
+namespace {
+
+namespace fs = std::filesystem;
+
+sockaddr_un make_address(const std::string& socket_path)
+{
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + socket_path);
+    }
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return addr;
+}
+
+// 连接服务，失败返回 -1
+int connect_to(const std::string& socket_path)
+{
+    sockaddr_un addr = make_address(socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 服务端等待客户端发完请求、收下响应的最长时间
+constexpr int CLIENT_TIMEOUT_SECONDS = 10;
+
+void write_all(int fd, std::string_view data)
+{
+    while (!data.empty()) {
+        ssize_t n = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                throw std::runtime_error("ld server: timed out sending to the peer");
+            }
+            throw std::runtime_error(std::string("ld server: send failed: ") + std::strerror(errno));
+        }
+        data.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
+std::string read_all(int fd)
+{
+    std::string data;
+    char buffer[64 * 1024];
+    for (;;) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                throw std::runtime_error("ld server: timed out reading from the peer");
+            }
+            throw std::runtime_error(std::string("ld server: read failed: ") + std::strerror(errno));
+        }
+        if (n == 0) {
+            return data;
+        }
+        data.append(buffer, static_cast<size_t>(n));
+    }
+}
+
+// 发送请求并等待响应
+json round_trip(int fd, const json& request)
+{
+    write_all(fd, request.dump());
+    shutdown(fd, SHUT_WR);
+    std::string reply = read_all(fd);
+    close(fd);
+    return json::parse(reply);
+}
+
+/**
+ * 已解析输入的缓存，以规范化后的绝对路径为键。
+ * mtime 和大小都没变时直接复用，不再读文件；变了就重新读取并解析。
+ *
+ * 名字驻留在 StringInterner 的当前一代里，被替换掉的输入留下的名字不会单独释放。
+ * 每次链接结束后检查：名字数涨到本代第一次链接后的 GROWTH_LIMIT 倍以上，
+ * 就清空缓存、开始新的一代，旧一代的内存随最后一个引用它的对象一起释放，
+ * 下一次链接重新解析全部输入。
+ */
+class InputCache {
+public:
+    FLEObject load(const std::string& path)
+    {
+        std::string key = fs::absolute(path).lexically_normal().string();
+        struct stat st;
+        Stats::add(Counter::FileSyscalls);
+        if (stat(key.c_str(), &st) != 0) {
+            cache.erase(key);
+            return load_fle(path); // 让 load_fle 报告原本的错误
+        }
+        int64_t mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        uint64_t size = static_cast<uint64_t>(st.st_size);
+
+        auto it = cache.find(key);
+        if (it != cache.end() && it->second.mtime_ns == mtime_ns && it->second.size == size) {
+            ++hits;
+            return it->second.obj;
+        }
+
+        ++misses;
+        Entry entry { mtime_ns, size, parse_fle(read_file(key), get_basename(path)) };
+        return cache.insert_or_assign(key, std::move(entry)).first->second.obj;
+    }
+
+    // 两次链接之间调用，此时不能有其他线程在驻留名字；开始了新的一代时返回 true
+    bool end_link()
+    {
+        size_t names = StringInterner::current()->size();
+        if (baseline == 0) {
+            baseline = names;
+            return false;
+        }
+        if (names <= GROWTH_LIMIT * baseline) {
+            return false;
+        }
+        cache.clear();
+        StringInterner::renew();
+        baseline = 0;
+        return true;
+    }
+
+    size_t hits = 0;
+    size_t misses = 0;
+
+private:
+    static constexpr size_t GROWTH_LIMIT = 2;
+
+    struct Entry {
+        int64_t mtime_ns;
+        uint64_t size;
+        FLEObject obj;
+    };
+
+    std::unordered_map<std::string, Entry> cache;
+    size_t baseline = 0; // 本代第一次链接后的名字数，0 表示还没有链接过
+};
+
+// 无法执行的请求也要有响应，客户端照常把 stderr 转给用户
+json error_reply(const std::string& message)
+{
+    json reply;
+    reply["status"] = 1;
+    reply["stdout"] = "";
+    reply["stderr"] = "Error: ld server: " + message + "\n";
+    return reply;
+}
+
+/**
+ * 一次链接期间把 std::cout / std::cerr 换成内存缓冲，并记住服务自己的工作目录。
+ * 析构时无论链接怎样结束都换回原来的输出、回到原目录，
+ * 否则一次异常就会让后续日志写进已经销毁的缓冲，退出时的相对路径也会指错地方。
+ */
+class LinkScope {
+public:
+    LinkScope()
+        : old_out(std::cout.rdbuf(out.rdbuf()))
+        , old_err(std::cerr.rdbuf(err.rdbuf()))
+        , server_cwd(fs::current_path())
+    {
+    }
+
+    ~LinkScope()
+    {
+        std::cout.rdbuf(old_out);
+        std::cerr.rdbuf(old_err);
+        std::error_code ec;
+        fs::current_path(server_cwd, ec);
+    }
+
+    LinkScope(const LinkScope&) = delete;
+    LinkScope& operator=(const LinkScope&) = delete;
+
+    std::ostringstream out, err;
+
+private:
+    std::streambuf* old_out;
+    std::streambuf* old_err;
+    fs::path server_cwd;
+};
+
+// 在服务进程内执行一次链接，捕获 ld 的标准输出和错误输出
+json serve_link(const json& request, InputCache& cache)
+{
+    LinkScope scope;
+
+    int status;
+    try {
+        std::string cwd = request.at("cwd").get<std::string>();
+        if (chdir(cwd.c_str()) != 0) {
+            throw std::runtime_error("cannot enter " + cwd + ": " + std::strerror(errno));
+        }
+        TimeTrace::get().reset();
+        DirectoryCache::get().clear(); // 目录内容在两次链接之间可能变化
+        status = FLE_ld_main(request.at("args").get<std::vector<std::string>>(),
+            [&](const std::string& path) { return cache.load(path); });
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        status = 1;
+    } catch (...) {
+        std::cerr << "Error: unknown exception during link" << std::endl;
+        status = 1;
+    }
+
+    json reply;
+    reply["status"] = status;
+    reply["stdout"] = scope.out.str();
+    reply["stderr"] = scope.err.str();
+    return reply;
+}
+
+} // namespace
+
+int FLE_ld_serve(const std::string& requested_path)
+{
+    // 每次链接都会进入客户端的目录，socket 路径先定成绝对路径，退出时才删得对
+    std::string socket_path = fs::absolute(requested_path).lexically_normal().string();
+
+    // 已有服务在监听就不要抢占；否则是上次遗留的 socket 文件，删掉重建
+    int probe = connect_to(socket_path);
+    if (probe >= 0) {
+        close(probe);
+        std::cerr << "Error: a link server is already listening on " << socket_path << std::endl;
+        return 1;
+    }
+    unlink(socket_path.c_str());
+
+    sockaddr_un addr = make_address(socket_path);
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+        || listen(listen_fd, 16) != 0) {
+        std::cerr << "Error: cannot listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    std::cerr << "ld server listening on " << socket_path << std::endl;
+
+    InputCache cache;
+    size_t links = 0;
+    for (bool running = true; running;) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        timeval timeout { CLIENT_TIMEOUT_SECONDS, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        try {
+            std::string text = read_all(fd);
+            if (text.empty()) {
+                // 只是探测服务是否存在的连接
+                close(fd);
+                continue;
+            }
+            json reply;
+            try {
+                json request = json::parse(text);
+                if (request.at("command").get<std::string>() == "stop") {
+                    running = false;
+                    reply["status"] = 0;
+                } else {
+                    size_t hits = cache.hits, misses = cache.misses;
+                    auto begin = std::chrono::steady_clock::now();
+                    reply = serve_link(request, cache);
+                    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+                    std::cerr << "link #" << ++links << ": status " << reply["status"].get<int>()
+                              << ", " << cache.hits - hits << " cached / " << cache.misses - misses << " parsed inputs, "
+                              << elapsed.count() << " ms" << std::endl;
+                    if (cache.end_link()) {
+                        std::cerr << "name table outgrew the cached inputs; cache dropped" << std::endl;
+                    }
+                }
+            } catch (const json::exception& e) {
+                // 请求本身不合法（链接中的错误已由 serve_link 写进响应）
+                std::cerr << "Error: malformed request: " << e.what() << std::endl;
+                reply = error_reply(std::string("malformed request: ") + e.what());
+            }
+            write_all(fd, reply.dump());
+        } catch (const std::exception& e) {
+            // 客户端超时或中途断开只影响这一个连接
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+        close(fd);
+    }
+
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    return 0;
+}
+
+int FLE_ld_serve_stop(const std::string& socket_path)
+{
+    int fd = connect_to(socket_path);
+    if (fd < 0) {
+        std::cerr << "Error: no link server on " << socket_path << std::endl;
+        return 1;
+    }
+    json request;
+    request["command"] = "stop";
+    return round_trip(fd, request).value("status", 1);
+}
+
+std::optional<int> FLE_ld_remote(const std::string& socket_path, const std::vector<std::string>& args)
+{
+    int fd = connect_to(socket_path);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    json request;
+    request["command"] = "link";
+    request["cwd"] = fs::current_path().string();
+    request["args"] = args;
+    json reply = round_trip(fd, request);
+
+    std::cout << reply.value("stdout", "");
+    std::cerr << reply.value("stderr", "");
+    return reply.value("status", 1);
+}
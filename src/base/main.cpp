@@ -1,67 +1,197 @@
 #include "argparse.hpp"
+#include "file_io.hpp"
 #include "fle.hpp"
+#include "hex.hpp"
+#include "reloc.hpp"
+#include "stats.hpp"
 #include "string_utils.hpp"
+#include "symbol_index.hpp"
+#include "tls.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <charconv>
 #include <csignal>
 #include <cstdint>
 #include <cstdio>
-#include <execinfo.h>
 #include <fstream>
 #include <iostream>
 #include <regex>
 #include <string>
+#include <unistd.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 using namespace std::string_literals;
 
-void segv_handler(int sig, siginfo_t* si, void* ctx)
+// 崩溃报告只能用异步信号安全的调用：先拼进栈上的缓冲区，再一次 write 出去
+class CrashWriter {
+public:
+    CrashWriter& operator<<(const char* text)
+    {
+        while (*text != '\0' && used < sizeof(buffer)) {
+            buffer[used++] = *text++;
+        }
+        return *this;
+    }
+
+    CrashWriter& hex(uint64_t value)
+    {
+        char digits[16];
+        int count = 0;
+        do {
+            digits[count++] = "0123456789abcdef"[value & 0xf];
+            value >>= 4;
+        } while (value != 0);
+        *this << "0x";
+        while (count > 0 && used < sizeof(buffer)) {
+            buffer[used++] = digits[--count];
+        }
+        return *this;
+    }
+
+    CrashWriter& dec(int64_t value)
+    {
+        if (value < 0) {
+            *this << "-";
+            return decimal(0 - static_cast<uint64_t>(value));
+        }
+        return decimal(static_cast<uint64_t>(value));
+    }
+
+    void flush()
+    {
+        for (size_t done = 0; done < used;) {
+            ssize_t n = write(STDERR_FILENO, buffer + done, used - done);
+            if (n <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        used = 0;
+    }
+
+private:
+    CrashWriter& decimal(uint64_t value)
+    {
+        char digits[20];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (count > 0 && used < sizeof(buffer)) {
+            buffer[used++] = digits[--count];
+        }
+        return *this;
+    }
+
+    char buffer[512];
+    size_t used = 0;
+};
+
+// 写出 "地址 符号+偏移 (模块)"。返回地址指向 call 之后，用 lookup_addr = 地址 - 1 查符号
+void describe_address(CrashWriter& out, uint64_t addr, uint64_t lookup_addr)
+{
+    out.hex(addr);
+    const SymbolIndex* index = SymbolIndex::published();
+    const AddressRange* range = index != nullptr ? index->lookup(lookup_addr) : nullptr;
+    if (range != nullptr) {
+        out << " " << range->name;
+        if (addr != range->start) {
+            out << "+";
+            out.hex(addr - range->start);
+        }
+        out << " (" << range->module << ")";
+    }
+}
+
+const char* signal_name(int sig)
+{
+    switch (sig) {
+    case SIGSEGV:
+        return "SIGSEGV";
+    case SIGBUS:
+        return "SIGBUS";
+    case SIGILL:
+        return "SIGILL";
+    case SIGFPE:
+        return "SIGFPE";
+    default:
+        return "signal";
+    }
+}
+
+void crash_handler(int sig, siginfo_t* si, void* ctx)
 {
-    fprintf(stderr, "Caught SIGSEGV at address: %p\n", si->si_addr);
-    fflush(stderr);
-    fprintf(stderr, "Error code: %d\n", si->si_code);
-    fflush(stderr);
+    // 程序可能已换掉 %fs；下面要调用 C 库，先换回 exec 自己的线程指针
+    HostThreadPointer::restore();
+
+    CrashWriter out;
+    out << "Caught " << signal_name(sig) << " at address: ";
+    out.hex(reinterpret_cast<uint64_t>(si->si_addr)) << "\nError code: ";
+    out.dec(si->si_code) << "\n";
+    out.flush();
 
     auto uctx = reinterpret_cast<ucontext_t*>(ctx);
 
-    // 发生段错误的指令地址
-    auto rip = uctx->uc_mcontext.gregs[REG_RIP];
+    // 发生错误的指令地址
+    auto rip = static_cast<uint64_t>(uctx->uc_mcontext.gregs[REG_RIP]);
+    auto rsp = static_cast<uint64_t>(uctx->uc_mcontext.gregs[REG_RSP]);
+    auto rbp = static_cast<uint64_t>(uctx->uc_mcontext.gregs[REG_RBP]);
+
+    // 崩在主线程栈上时栈顶已知，读栈前先检查范围；否则（没有索引或在程序自建线程的栈上）只要求 rsp 非空，也不回溯帧链
+    const SymbolIndex* index = SymbolIndex::published();
+    uint64_t stack_top = index != nullptr ? index->stack_top_for(rsp) : 0;
+    bool rsp_readable = stack_top != 0 ? rsp % 8 == 0 && rsp + 8 <= stack_top : rsp != 0;
 
     // call 指令前，会先往栈里压入返回地址，RSP 指向栈顶。
-    // 这里尝试从栈顶读取 8 字节（对于 x86_64）当作返回地址
-    auto rsp = uctx->uc_mcontext.gregs[REG_RSP];
-    void* call_site_next = 0;
-    // 这里要确保 rsp 是可读，且内存布局正常
-    // 对于因为错误跳转而崩溃的大多数场景，下面的读取通常可行
-    if (rsp != 0) {
-        // 取到栈顶存放的返回地址
-        call_site_next = reinterpret_cast<void*>(*reinterpret_cast<uint64_t*>(rsp));
-    }
-
-    fprintf(stderr, "Instruction at: %p\n", reinterpret_cast<void*>(rip));
-    fflush(stderr);
+    // 在还没建立栈帧的函数（叶子函数、函数入口）里崩溃时，栈顶的 8 字节就是返回地址
+    uint64_t call_site_next = rsp_readable ? *reinterpret_cast<const uint64_t*>(rsp) : 0;
+
+    out << "Instruction at: ";
+    describe_address(out, rip, rip);
+    out << "\n";
     // call_site_next 是 call 指令推入的“返回地址”，即 call 指令自身之后的那条指令地址
-    // 它通常比 call 指令的开头多 5~7 个字节（具体看是否是 call rel32 或 call r/m64 等）
-    // 因此可用 call_site_next - offset 推算出 call 指令的开头
-    fprintf(stderr, "Likely return address: %p\n", call_site_next);
-    fflush(stderr);
+    out << "Likely return address: ";
+    describe_address(out, call_site_next, call_site_next - 1);
+    out << "\n";
+    out.flush();
+
+    // 沿帧指针链回溯；栈顶的返回地址只有确实来自对当前函数的 call 时才算作一帧
+    if (index != nullptr) {
+        constexpr size_t MAX_FRAMES = 64;
+        uint64_t frames[MAX_FRAMES];
+        size_t depth = 0;
+        frames[depth++] = rip;
+        if (index->returns_from(call_site_next, rip)) {
+            frames[depth++] = call_site_next;
+        }
+        depth += walk_frames(rbp, rsp, stack_top, frames + depth, MAX_FRAMES - depth);
+        // 程序最外层之上的帧属于 exec 自己
+        while (depth > 1 && index->lookup(frames[depth - 1] - 1) == nullptr) {
+            --depth;
+        }
+
+        out << "Backtrace:\n";
+        out.flush();
+        for (size_t i = 0; i < depth; ++i) {
+            out << "  #";
+            out.dec(static_cast<int64_t>(i)) << " ";
+            describe_address(out, frames[i], i == 0 ? frames[i] : frames[i] - 1);
+            out << "\n";
+            out.flush();
+        }
+    }
 
     // 恢复默认的信号处理程序
-    signal(SIGSEGV, SIG_DFL);
+    signal(sig, SIG_DFL);
     // 重新抛出信号
     raise(sig);
 }
 
 namespace fs = std::filesystem;
 
-/**
- * 检查文件是否存在
- */
-bool file_exists(const std::string& path)
-{
-    std::error_code ec;
-    return fs::exists(path, ec) && fs::is_regular_file(path, ec);
-}
-
 // 辅助函数：解析程序头
 static void parse_program_headers(const json& j, FLEObject& obj)
 {
@@ -94,41 +224,85 @@ static void parse_section_headers(const json& j, FLEObject& obj)
     }
 }
 
+// 辅助函数：去掉首尾空白，不复制字符串
+static std::string_view trim_view(std::string_view s)
+{
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
 // 辅助函数：解析重定位类型
-static RelocationType parse_relocation_type(const std::string& type_str)
+static RelocationType parse_relocation_type(std::string_view type_str)
 {
-    if (type_str == "rel" || type_str == "dynrel")
-        return RelocationType::R_X86_64_PC32;
-    if (type_str == "abs64" || type_str == "dynabs64")
-        return RelocationType::R_X86_64_64;
-    if (type_str == "abs" || type_str == "dynabs32" || type_str == "abs32")
+    if (type_str == "abs32")
         return RelocationType::R_X86_64_32;
-    if (type_str == "abs32s")
-        return RelocationType::R_X86_64_32S;
-    if (type_str == "gotpcrel")
-        return RelocationType::R_X86_64_GOTPCREL;
-    throw std::runtime_error("Invalid relocation type: " + type_str);
+    // 按枚举顺序匹配，".dynabs32" 因此解析为 R_X86_64_32
+    for (const auto& info : RELOC_TABLE) {
+        if ((!info.tag.empty() && info.tag.substr(1) == type_str) || (!info.dyn_tag.empty() && info.dyn_tag.substr(1) == type_str))
+            return info.type;
+    }
+    throw std::runtime_error("Invalid relocation type: " + std::string(type_str));
 }
-static int64_t parse_addend_literal(std::string literal)
+static int64_t parse_addend_literal(std::string_view literal)
 {
-    literal = trim(literal);
+    literal = trim_view(literal);
     if (literal.empty()) {
         throw std::runtime_error("Empty relocation addend");
     }
 
     if (literal.size() > 2 && literal[0] == '0' && (literal[1] == 'x' || literal[1] == 'X')) {
-        literal = literal.substr(2);
+        literal.remove_prefix(2);
     }
 
-    try {
-        return std::stoll(literal, nullptr, 16);
-    } catch (const std::invalid_argument&) {
-        return std::stoll(literal, nullptr, 10);
+    int64_t value = 0;
+    auto [end, ec] = std::from_chars(literal.data(), literal.data() + literal.size(), value, 16);
+    if (ec != std::errc() || end != literal.data() + literal.size()) {
+        throw std::runtime_error("Invalid relocation addend: " + std::string(literal));
     }
+    return value;
 }
 
+// 辅助函数：取出下一个以空白分隔的词
+static std::string_view next_token(std::string_view& s)
+{
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string_view::npos) {
+        s = {};
+        return {};
+    }
+    size_t end = s.find_first_of(" \t\r\n", begin);
+    if (end == std::string_view::npos) {
+        end = s.size();
+    }
+    std::string_view token = s.substr(begin, end - begin);
+    s.remove_prefix(end);
+    return token;
+}
 
+static size_t parse_size_field(std::string_view& s, std::string_view line)
+{
+    std::string_view token = next_token(s);
+    size_t value = 0;
+    auto [end, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (token.empty() || ec != std::errc() || end != token.data() + token.size()) {
+        throw std::runtime_error("Invalid symbol line: " + std::string(line));
+    }
+    return value;
+}
 
+static bool is_metadata_key(std::string_view key)
+{
+    return key == "type" || key == "entry" || key == "phdrs" || key == "shdrs" || key == "members" || key == "name" || key == "needed" || key == "dyn_relocs";
+}
+
+/*
+解析一个FLE对象。所有名字（符号、重定位目标、节名）都在全局字符串表中驻留，
+Symbol/Relocation/FLESection 只保存句柄，比较名字只需比较指针
+*/
 static FLEObject parse_fle_from_json(const json& j, const std::string& name)
 {
     FLEObject obj;
@@ -168,13 +342,11 @@ static FLEObject parse_fle_from_json(const json& j, const std::string& name)
         }
     }
 
-    std::vector<Relocation> legacy_dyn_relocs;
-    std::vector<Relocation> inline_dyn_relocs;
-
     parse_section_headers(j, obj);
 
-    std::unordered_map<std::string, Symbol> symbol_table;
-    std::unordered_map<std::string, uint64_t> section_base_addrs;
+    std::unordered_set<InternedString> known_symbols;
+    std::unordered_map<std::string_view, uint64_t> section_base_addrs;
+    std::vector<InternedString> section_names; // 按 j.items() 的顺序
 
     for (const auto& shdr : obj.shdrs) {
         section_base_addrs[shdr.name] = shdr.addr;
@@ -183,99 +355,129 @@ static FLEObject parse_fle_from_json(const json& j, const std::string& name)
         section_base_addrs.emplace(phdr.name, phdr.vaddr);
     }
 
+    // 把一行拆成前缀和内容，不复制字符串
+    auto split_line = [](const std::string& line) {
+        std::string_view view = line;
+        size_t colon_pos = view.find(':');
+        if (colon_pos == std::string_view::npos) {
+            return std::make_pair(view, std::string_view {});
+        }
+        return std::make_pair(view.substr(0, colon_pos), view.substr(colon_pos + 1));
+    };
+
     // 第一遍：收集所有符号定义并计算偏移量
     for (auto& [key, value] : j.items()) {
-        if (key == "type" || key == "entry" || key == "phdrs" || key == "shdrs" || key == "members" || key == "name" || key == "needed" || key == "dyn_relocs")
+        if (is_metadata_key(key))
             continue;
 
-        // size_t current_offset = 0;
+        InternedString section_name = intern(key);
+        section_names.push_back(section_name);
+
         for (const auto& line : value) {
-            std::string line_str = line.get<std::string>();
-            size_t colon_pos = line_str.find(':');
-            std::string prefix = line_str.substr(0, colon_pos);
-            std::string content = line_str.substr(colon_pos + 1);
+            const auto& line_str = line.get_ref<const std::string&>();
+            auto [prefix, content] = split_line(line_str);
 
             if (prefix == "🏷️" || prefix == "📎" || prefix == "📤") {
-                std::string name;
-                size_t size, offset;
-                std::istringstream ss(content);
-                ss >> name >> size >> offset;
+                std::string_view rest = content;
+                std::string_view sym_name = next_token(rest);
+                size_t size = parse_size_field(rest, line_str);
+                size_t offset = parse_size_field(rest, line_str);
+
+                // 可选的第四个字段是可见性，省略即 default
+                SymbolVisibility visibility = SymbolVisibility::DEFAULT;
+                std::string_view visibility_field = next_token(rest);
+                if (visibility_field == "hidden") {
+                    visibility = SymbolVisibility::HIDDEN;
+                } else if (visibility_field == "protected") {
+                    visibility = SymbolVisibility::PROTECTED;
+                } else if (!visibility_field.empty()) {
+                    throw std::runtime_error("Invalid symbol line: " + line_str);
+                }
 
-                name = trim(name);
                 SymbolType type = prefix == "🏷️" ? SymbolType::LOCAL : prefix == "📎" ? SymbolType::WEAK
                                                                                       : SymbolType::GLOBAL;
 
                 Symbol sym {
                     type,
-                    std::string(key),
+                    section_name,
                     offset,
                     size,
-                    name
+                    intern(sym_name),
+                    visibility
                 };
 
-                symbol_table[name] = sym;
+                known_symbols.insert(sym.name);
                 obj.symbols.push_back(sym);
             }
         }
     }
 
     // 第二遍：处理节的内容和重定位
+    size_t section_index = 0;
     for (auto& [key, value] : j.items()) {
-        if (key == "type" || key == "entry" || key == "phdrs" || key == "shdrs" || key == "members" || key == "name" || key == "needed" || key == "dyn_relocs")
+        if (is_metadata_key(key))
             continue;
 
+        InternedString section_name = section_names[section_index++];
         FLESection section;
+        section.name = section_name;
         section.has_symbols = false;
 
+        // 预估数据和重定位的大小，一次分配到位
+        size_t data_estimate = 0;
+        size_t reloc_count = 0;
+        for (const auto& line : value) {
+            auto [prefix, content] = split_line(line.get_ref<const std::string&>());
+            if (prefix == "🔢") {
+                data_estimate += (content.size() + 1) / 3;
+            } else if (prefix == "❓") {
+                data_estimate += 8;
+                ++reloc_count;
+            }
+        }
+        section.data.reserve(data_estimate);
+        section.relocs.reserve(reloc_count);
+
         for (const auto& line : value) {
-            std::string line_str = line.get<std::string>();
-            size_t colon_pos = line_str.find(':');
-            std::string prefix = line_str.substr(0, colon_pos);
-            std::string content = line_str.substr(colon_pos + 1);
+            const auto& line_str = line.get_ref<const std::string&>();
+            auto [prefix, content] = split_line(line_str);
 
             if (prefix == "🔢") {
-                std::stringstream ss(content);
-                uint32_t byte;
-                while (ss >> std::hex >> byte) {
-                    section.data.push_back(static_cast<uint8_t>(byte));
-                }
+                hex_decode(content, section.data);
             } else if (prefix == "❓") {
-                std::string reloc_str = trim(content);
-                std::regex reloc_pattern(R"(\.(rel|abs64|abs|abs32s|gotpcrel|dynrel|dynabs64|dynabs32)\(([\w.@$]+)\s*([-+])\s*([0-9a-fA-FxX]+)\))");
-                std::smatch match;
+                std::string_view reloc_str = trim_view(content);
+                static const std::regex reloc_pattern(R"(\.([a-z0-9]+)\(([\w.@$]+)\s*([-+])\s*([0-9a-fA-FxX]+)\))");
+                std::cmatch match;
 
-                if (!std::regex_match(reloc_str, match, reloc_pattern)) {
-                    throw std::runtime_error("Invalid relocation: " + reloc_str);
+                if (!std::regex_match(reloc_str.data(), reloc_str.data() + reloc_str.size(), match, reloc_pattern)) {
+                    throw std::runtime_error("Invalid relocation: " + std::string(reloc_str));
                 }
 
-                RelocationType type = parse_relocation_type(match[1].str());
-                std::string symbol_name = match[2].str();
-                std::string sign = match[3].str();
-                int64_t append_value = parse_addend_literal(match[4].str());
-                if (sign == "-") {
+                auto group = [&](int i) {
+                    return std::string_view(match[i].first, static_cast<size_t>(match[i].length()));
+                };
+                std::string_view tag = group(1);
+                RelocationType type = parse_relocation_type(tag);
+                int64_t append_value = parse_addend_literal(group(4));
+                if (group(3) == "-") {
                     append_value = -append_value;
                 }
 
-                auto ensure_symbol_exists = [&](const std::string& name) {
-                    auto it = symbol_table.find(name);
-                    if (it == symbol_table.end()) {
-                        Symbol sym {
-                            SymbolType::UNDEFINED,
-                            "",
-                            0,
-                            0,
-                            name
-                        };
-                        symbol_table[name] = sym;
-                        obj.symbols.push_back(sym);
-                    }
-                };
+                // 未定义的符号第一次出现时记入符号表
+                InternedString symbol_name = intern(group(2));
+                if (known_symbols.insert(symbol_name).second) {
+                    obj.symbols.push_back(Symbol {
+                        SymbolType::UNDEFINED,
+                        {},
+                        0,
+                        0,
+                        symbol_name
+                    });
+                }
 
-                bool is_dynamic_reloc = match[1].str().rfind("dyn", 0) == 0;
+                bool is_dynamic_reloc = tag.rfind("dyn", 0) == 0;
                 if (is_dynamic_reloc) {
-                    ensure_symbol_exists(symbol_name);
-
-                    auto base_it = section_base_addrs.find(key);
+                    auto base_it = section_base_addrs.find(section_name);
                     if (base_it == section_base_addrs.end()) {
                         throw std::runtime_error("Dynamic relocation section has no base address: " + key);
                     }
@@ -287,9 +489,9 @@ static FLEObject parse_fle_from_json(const json& j, const std::string& name)
                         append_value
                     };
 
-                    inline_dyn_relocs.push_back(reloc);
+                    obj.dyn_relocs.push_back(reloc);
 
-                    size_t size = (type == RelocationType::R_X86_64_64) ? 8 : 4;
+                    size_t size = reloc_info(type).size;
                     section.data.insert(section.data.end(), size, 0);
                     continue;
                 }
@@ -301,43 +503,47 @@ static FLEObject parse_fle_from_json(const json& j, const std::string& name)
                     append_value
                 };
 
-                ensure_symbol_exists(symbol_name);
-
                 section.relocs.push_back(reloc);
 
                 // 根据重定位类型预留空间
-                size_t size = (type == RelocationType::R_X86_64_64) ? 8 : 4;
+                size_t size = reloc_info(type).size;
                 section.data.insert(section.data.end(), size, 0);
             } else if (prefix == "🏷️" || prefix == "📎" || prefix == "📤") {
                 section.has_symbols = true;
             }
         }
 
-        section.name = key;
-        obj.sections[key] = section;
+        obj.sections[key] = std::move(section);
     }
 
-    if (!inline_dyn_relocs.empty()) {
-        obj.dyn_relocs = std::move(inline_dyn_relocs);
-    } else {
-        obj.dyn_relocs = std::move(legacy_dyn_relocs);
+    if (Stats::is_enabled()) {
+        size_t relocs = obj.dyn_relocs.size();
+        for (const auto& [_, section] : obj.sections) {
+            relocs += section.relocs.size();
+        }
+        Stats::add(Counter::ObjectsLoaded);
+        Stats::add(Counter::SectionsLoaded, obj.sections.size());
+        Stats::add(Counter::SymbolsLoaded, obj.symbols.size());
+        Stats::add(Counter::RelocsLoaded, relocs);
     }
 
     return obj;
 }
 
-FLEObject load_fle(const std::string& file)
+FLEObject parse_fle(std::string_view content, const std::string& name)
 {
-    std::ifstream infile(file);
-    std::string content((std::istreambuf_iterator<char>(infile)),
-        std::istreambuf_iterator<char>());
-
     if (content.substr(0, 2) == "#!") {
-        content = content.substr(content.find('\n') + 1);
+        size_t newline = content.find('\n');
+        content.remove_prefix(newline == std::string_view::npos ? content.size() : newline + 1);
     }
 
     json j = json::parse(content);
-    return parse_fle_from_json(j, get_basename(file));
+    return parse_fle_from_json(j, name);
+}
+
+FLEObject load_fle(const std::string& file)
+{
+    return parse_fle(read_file(file), get_basename(file));
 }
 
 /**
@@ -358,6 +564,8 @@ std::string find_library(const std::string& lib_name,
     std::string static_name = "lib" + lib_name + ".fa";
 
     // 2. 遍历搜索路径
+    // 每个目录只列一次，之后的 -l 都在内存里的目录表中查找，不再逐个 stat
+    DirectoryCache& dir_cache = DirectoryCache::get();
     for (const auto& dir_str : library_paths) {
         fs::path dir(dir_str); // 使用 fs::path 自动处理路径分隔符
 
@@ -371,7 +579,7 @@ std::string find_library(const std::string& lib_name,
         // 策略 A: 强制静态链接 (-static)
         // 只找 .ar，完全忽略 .so
         if (force_static) {
-            if (file_exists(static_full_path.string())) {
+            if (dir_cache.is_regular_file(static_full_path.string())) {
                 return static_full_path.string();
             }
             // 当前目录没找到 .ar，去下一个目录找
@@ -381,13 +589,10 @@ std::string find_library(const std::string& lib_name,
         // 策略 B: 默认模式 (Dynamic Mode)
         // 优先找 .so，其次找 .ar
         // 注意：ld 的行为是在同一个目录下，.so 优先级高于 .ar
-        bool has_so = file_exists(dylib_full_path.string());
-        bool has_ar = file_exists(static_full_path.string());
-
-        if (has_so) {
+        if (dir_cache.is_regular_file(dylib_full_path.string())) {
             return dylib_full_path.string();
         }
-        if (has_ar) {
+        if (dir_cache.is_regular_file(static_full_path.string())) {
             // 虽然是默认模式，但只找到了静态库，那也可以用
             return static_full_path.string();
         }
@@ -436,6 +641,107 @@ struct InputItem {
     std::string value;
 };
 
+int FLE_ld_main(const std::vector<std::string>& args, const InputLoader& load)
+{
+    LinkerOptions options;
+    std::vector<InputItem> ordered_inputs;
+    std::vector<std::string> lib_paths;
+    bool time_trace = false;
+    std::string time_trace_file;
+
+    ArgParser parser("ld");
+
+    parser.add_option(options.outputFile, "-o, --output", "Output file");
+    parser.add_option(options.entryPoint, "-e, --entry", "Entry point");
+    parser.add_flag(options.shared, "-shared", "Create shared library");
+    parser.add_flag(options.is_static, "-static", "Static linking");
+    parser.add_flag(options.strip, "-s, --strip-all", "Omit the symbol table from executables");
+    parser.add_multi_option(lib_paths, "-L", "Add library search path");
+    parser.add_option(options.mapFile, "-Map, --Map", "Write a link map to file");
+    parser.add_option(options.versionScript, "--version-script", "Export only the symbols a version script lists as global");
+    parser.add_flag_cb("-Bsymbolic", "Bind references to a shared library's own globals at link time",
+        [&]() { options.binding = SymbolBinding::Direct; });
+    parser.add_flag_cb("-Bsymbolic-functions", "Bind only functions at link time; data can be interposed",
+        [&]() { options.binding = SymbolBinding::Functions; });
+    parser.add_flag_cb("-Bno-symbolic", "Let exported default symbols be interposed, as ELF does by default",
+        [&]() { options.binding = SymbolBinding::Interposable; });
+    parser.add_flag(time_trace, "--time-trace", "Write per-phase timings as Chrome trace JSON");
+    parser.add_option(time_trace_file, "--time-trace-file", "Trace output file (default: <output>.time-trace.json)");
+
+    parser.add_option_cb("-l", "Link library", [&](std::string lib_name) {
+        ordered_inputs.push_back({ InputItem::Library, lib_name });
+    });
+
+    parser.on_positional([&](std::string file_path) {
+        ordered_inputs.push_back({ InputItem::File, file_path });
+    });
+
+    try {
+        parser.parse(args);
+    } catch (const ArgParser::HelpRequested&) {
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (ordered_inputs.empty()) {
+        std::cerr << "Error: No inputs\n";
+        return 1;
+    }
+
+    if (!time_trace_file.empty()) {
+        time_trace = true;
+    } else if (time_trace) {
+        time_trace_file = options.outputFile + ".time-trace.json";
+    }
+    if (time_trace) {
+        TimeTrace::get().enable();
+    }
+
+    std::vector<FLEObject> objects;
+    lib_paths.push_back("./");
+
+    {
+        TraceScope total("Total link");
+        {
+            TraceScope load_phase("Load inputs");
+            for (const auto& item : ordered_inputs) {
+                if (item.type == InputItem::File) {
+                    TraceScope scope("Load", item.value);
+                    objects.push_back(load(item.value));
+                } else if (item.type == InputItem::Library) {
+                    std::string path = find_library(item.value, lib_paths, options.is_static);
+                    TraceScope scope("Load", path);
+                    objects.push_back(load(path));
+                }
+            }
+        }
+
+        FLEObject result;
+        {
+            TraceScope link("FLE_ld");
+            result = FLE_ld(objects, options);
+        }
+
+        FLEWriter writer(options.outputFile);
+        {
+            TraceScope serialise("FLE_objdump", options.outputFile);
+            FLE_objdump(result, writer);
+        }
+        {
+            TraceScope write("FLEWriter::finish", options.outputFile);
+            writer.finish();
+        }
+    }
+
+    if (time_trace) {
+        TimeTrace::get().write_to_file(time_trace_file);
+    }
+
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
     // singlestack
@@ -448,11 +754,14 @@ int main(int argc, char* argv[])
     sigaltstack(&sigstack, NULL);
 
     struct sigaction sa;
+    sigemptyset(&sa.sa_mask);
     sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
-    sa.sa_sigaction = segv_handler;
-    if (sigaction(SIGSEGV, &sa, NULL) == -1) {
-        std::cerr << "Failed to set up signal handler for SIGSEGV" << std::endl;
-        return 1;
+    sa.sa_sigaction = crash_handler;
+    for (int sig : { SIGSEGV, SIGBUS, SIGILL, SIGFPE }) {
+        if (sigaction(sig, &sa, NULL) == -1) {
+            std::cerr << "Failed to set up signal handler for " << signal_name(sig) << std::endl;
+            return 1;
+        }
     }
 
     if (argc < 2) {
@@ -461,7 +770,7 @@ int main(int argc, char* argv[])
                   << "  objdump <input>                  Display contents of FLE file\n"
                   << "  nm <input>                       Display symbol table\n"
                   << "  ld [-o output] input1 input2...  Link FLE files (.fo/.fa/.fle)\n"
-                  << "  exec <input.fle>                 Execute FLE file\n"
+                  << "  exec [--profile file] <input.fle> Execute FLE file\n"
                   << "  cc [-o output.o] input.c...      Compile C files (outputs .fo)\n"
                   << "  ar <output.fa> <input.fo>...     Create static archive\n"
                   << "  readfle <input>                  Display FLE file information\n"
@@ -472,77 +781,103 @@ int main(int argc, char* argv[])
     std::string tool = "FLE_"s + get_basename(argv[0]);
     std::vector<std::string> args(argv + 1, argv + argc);
 
+    // --stats 对所有工具通用，在分派前取出；FLE_STATS 环境变量效果相同
+    auto stats_flag = std::find(args.begin(), args.end(), "--stats");
+    if (stats_flag != args.end()) {
+        args.erase(stats_flag);
+        Stats::enable(get_basename(argv[0]));
+    } else {
+        Stats::enable_from_env(get_basename(argv[0]));
+    }
+
     try {
         if (tool == "FLE_objdump") {
             if (args.size() != 1) {
                 throw std::runtime_error("Usage: objdump <input>");
             }
-            FLEWriter writer;
-            FLE_objdump(load_fle(args[0]), writer);
-            writer.write_to_file(args[0] + ".objdump");
+            FLEObject obj;
+            {
+                TraceScope load("Load inputs", args[0]);
+                obj = load_fle(args[0]);
+            }
+            FLEWriter writer(args[0] + ".objdump");
+            {
+                TraceScope serialise("FLE_objdump");
+                FLE_objdump(obj, writer);
+            }
+            TraceScope write("FLEWriter::finish");
+            writer.finish();
         } else if (tool == "FLE_nm") {
             if (args.size() != 1) {
                 throw std::runtime_error("Usage: nm <input>");
             }
-            FLE_nm(load_fle(args[0]));
-        } else if (tool == "FLE_exec") {
-            if (args.size() != 1) {
-                throw std::runtime_error("Usage: exec <input.fle>");
+            FLEObject obj;
+            {
+                TraceScope load("Load inputs", args[0]);
+                obj = load_fle(args[0]);
             }
-            FLE_exec(load_fle(args[0]));
-        } else if (tool == "FLE_ld") {
-            LinkerOptions options;
-            std::vector<InputItem> ordered_inputs;
-            std::vector<std::string> lib_paths;
-
-            ArgParser parser("ld");
-
-            parser.add_option(options.outputFile, "-o, --output", "Output file");
-            parser.add_option(options.entryPoint, "-e, --entry", "Entry point");
-            parser.add_flag(options.shared, "-shared", "Create shared library");
-            parser.add_flag(options.is_static, "-static", "Static linking");
-            parser.add_multi_option(lib_paths, "-L", "Add library search path");
-
-            parser.add_option_cb("-l", "Link library", [&](std::string lib_name) {
-                ordered_inputs.push_back({ InputItem::Library, lib_name });
+            TraceScope nm("FLE_nm");
+            FLE_nm(obj);
+        } else if (tool == "FLE_exec") {
+            std::vector<std::string> inputs;
+            std::string time_trace_file;
+            ExecOptions options;
+            std::string profile_format = "flat";
+
+            ArgParser parser("exec");
+            parser.add_option(time_trace_file, "--time-trace-file", "Write startup timings as Chrome trace JSON");
+            parser.add_option(options.profileFile, "--profile", "Sample the program and write a profile to file");
+            parser.add_option(profile_format, "--profile-format", "Profile format: flat (default) or folded stacks");
+            parser.add_option_cb("--profile-hz", "Samples per second of CPU time (default 1000)", [&](std::string hz) {
+                auto [end, ec] = std::from_chars(hz.data(), hz.data() + hz.size(), options.profileHz);
+                if (hz.empty() || ec != std::errc() || end != hz.data() + hz.size()) {
+                    throw std::runtime_error("Invalid value for --profile-hz: '" + hz + "' (expected samples per second)");
+                }
             });
-
             parser.on_positional([&](std::string file_path) {
-                ordered_inputs.push_back({ InputItem::File, file_path });
+                inputs.push_back(file_path);
             });
-
             try {
                 parser.parse(args);
             } catch (const ArgParser::HelpRequested&) {
                 return 0;
-            } catch (const std::exception& e) {
-                std::cerr << "Error: " << e.what() << "\n";
-                return 1;
             }
-
-            if (ordered_inputs.empty()) {
-                std::cerr << "Error: No inputs\n";
-                return 1;
+            if (inputs.size() != 1) {
+                throw std::runtime_error("Usage: exec [--time-trace-file <file>] [--profile <file>] <input.fle>");
             }
+            if (profile_format != "flat" && profile_format != "folded") {
+                throw std::runtime_error("Unknown profile format: " + profile_format);
+            }
+            options.profileFolded = profile_format == "folded";
 
-            std::vector<FLEObject> objects;
-            lib_paths.push_back("./");
-
-            for (const auto& item : ordered_inputs) {
-                if (item.type == InputItem::File) {
-                    objects.push_back(load_fle(item.value));
-                } else if (item.type == InputItem::Library) {
-                    std::string path = find_library(item.value, lib_paths, options.is_static);
-                    objects.push_back(load_fle(path));
+            // 程序不会返回 main，跟踪文件由 FLE_exec 在跳转到入口前写出
+            if (!time_trace_file.empty()) {
+                TimeTrace::get().enable(time_trace_file);
+            }
+            FLEObject program;
+            {
+                TraceScope load("Load program", inputs[0]);
+                program = load_fle(inputs[0]);
+            }
+            FLE_exec(program, options);
+        } else if (tool == "FLE_ld") {
+            // 常驻链接服务：ld --serve <socket> 启动，ld --serve-stop <socket> 停止
+            if (args.size() == 2 && args[0] == "--serve") {
+                return FLE_ld_serve(args[1]);
+            }
+            if (args.size() == 2 && args[0] == "--serve-stop") {
+                return FLE_ld_serve_stop(args[1]);
+            }
+            // 设置了 FLE_LD_SERVER 时交给服务链接；连不上服务则照常在本进程内链接
+            const char* server = std::getenv("FLE_LD_SERVER");
+            if (server != nullptr && *server != '\0') {
+                if (auto status = FLE_ld_remote(server, args)) {
+                    return *status;
                 }
             }
-
-            FLEObject result = FLE_ld(objects, options);
-
-            FLEWriter writer;
-            FLE_objdump(result, writer);
-            writer.write_to_file(options.outputFile);
+            return FLE_ld_main(args, load_fle);
         } else if (tool == "FLE_cc") {
+            TraceScope cc("FLE_cc");
             FLE_cc(args);
         } else if (tool == "FLE_readfle") {
             if (args.size() != 1) {
@@ -555,6 +890,7 @@ int main(int argc, char* argv[])
             }
             FLE_disasm(load_fle(args[0]), args[1]);
         } else if (tool == "FLE_ar") {
+            TraceScope ar("FLE_ar");
             FLE_ar(args);
         } else {
             std::cerr << "Unknown tool: " << tool << std::endl;
@@ -1,4 +1,6 @@
 #include "fle.hpp"
+#include "hex.hpp"
+#include "reloc.hpp"
 #include <algorithm>
 #include <cstdlib>
 #include <iomanip>
@@ -33,7 +35,7 @@ void FLE_objdump(const FLEObject& obj, FLEWriter& writer)
     }
 
     // 预处理：构建符号表索引
-    std::map<std::string, std::map<size_t, std::vector<Symbol>>> symbol_index;
+    std::map<std::string_view, std::map<size_t, std::vector<Symbol>>> symbol_index;
     for (const auto& sym : obj.symbols) {
         if (sym.type != SymbolType::UNDEFINED) {
             symbol_index[sym.section][sym.offset].push_back(sym);
@@ -117,57 +119,54 @@ void FLE_objdump(const FLEObject& obj, FLEWriter& writer)
         breaks.erase(std::unique(breaks.begin(), breaks.end()), breaks.end());
 
         auto format_reloc = [](const RelocForOutput& entry) -> std::string {
-            auto type_to_tag = [&](RelocationType type, bool dynamic) -> std::string {
-                switch (type) {
-                case RelocationType::R_X86_64_PC32:
-                    return dynamic ? ".dynrel" : ".rel";
-                case RelocationType::R_X86_64_64:
-                    return dynamic ? ".dynabs64" : ".abs64";
-                case RelocationType::R_X86_64_32:
-                    return dynamic ? ".dynabs32" : ".abs";
-                case RelocationType::R_X86_64_32S:
-                    return dynamic ? ".dynabs32" : ".abs32s";
-                case RelocationType::R_X86_64_GOTPCREL:
-                    if (!dynamic)
-                        return ".gotpcrel";
-                    break;
-                }
+            const auto& info = reloc_info(entry.reloc.type);
+            const auto tag = entry.dynamic ? info.dyn_tag : info.tag;
+            if (tag.empty()) {
                 throw std::runtime_error("Unsupported relocation type in objdump");
-            };
-
-            const auto tag = type_to_tag(entry.reloc.type, entry.dynamic);
+            }
             const char sign = entry.reloc.addend < 0 ? '-' : '+';
             auto abs_addend = static_cast<uint64_t>(std::llabs(entry.reloc.addend));
 
             std::ostringstream ss;
-            ss << "❓: " << tag << "(" << entry.reloc.symbol << " " << sign << " " << abs_addend << ")";
+            // 加数按十六进制书写，和 cc 的输出以及 load_fle 的解析一致
+            ss << "❓: " << tag << "(" << entry.reloc.symbol << " " << sign << " " << std::hex << abs_addend << ")";
             return ss.str();
         };
 
+        auto section_it = symbol_index.find(name);
+        auto write_symbols = [&](const std::vector<Symbol>& symbols) {
+            for (const auto& sym : symbols) {
+                std::string line;
+                switch (sym.type) {
+                case SymbolType::LOCAL:
+                    line = "🏷️: ";
+                    break;
+                case SymbolType::WEAK:
+                    line = "📎: ";
+                    break;
+                case SymbolType::GLOBAL:
+                    line = "📤: ";
+                    break;
+                default:
+                    [[unlikely]] throw std::runtime_error("unknown symbol type");
+                }
+                line.append(sym.name);
+                line += " " + std::to_string(sym.size) + " " + std::to_string(sym.offset);
+                if (sym.visibility == SymbolVisibility::HIDDEN) {
+                    line += " hidden";
+                } else if (sym.visibility == SymbolVisibility::PROTECTED) {
+                    line += " protected";
+                }
+                writer.write_line(line);
+            }
+        };
+
         size_t pos = 0;
         while (pos < section.data.size()) {
-            auto section_it = symbol_index.find(name);
             if (section_it != symbol_index.end()) {
                 auto offset_it = section_it->second.find(pos);
                 if (offset_it != section_it->second.end()) {
-                    for (const auto& sym : offset_it->second) {
-                        std::string line;
-                        switch (sym.type) {
-                        case SymbolType::LOCAL:
-                            line = "🏷️: " + sym.name;
-                            break;
-                        case SymbolType::WEAK:
-                            line = "📎: " + sym.name;
-                            break;
-                        case SymbolType::GLOBAL:
-                            line = "📤: " + sym.name;
-                            break;
-                        default:
-                            [[unlikely]] throw std::runtime_error("unknown symbol type");
-                        }
-                        line += " " + std::to_string(sym.size) + " " + std::to_string(sym.offset);
-                        writer.write_line(line);
-                    }
+                    write_symbols(offset_it->second);
                 }
             }
 
@@ -175,8 +174,7 @@ void FLE_objdump(const FLEObject& obj, FLEWriter& writer)
             if (reloc_it != reloc_index.end()) {
                 for (const auto& reloc_entry : reloc_it->second) {
                     writer.write_line(format_reloc(reloc_entry));
-                    size_t reloc_size = (reloc_entry.reloc.type == RelocationType::R_X86_64_64) ? 8 : 4;
-                    pos += reloc_size;
+                    pos += reloc_info(reloc_entry.reloc.type).size;
                 }
                 continue;
             }
@@ -188,26 +186,27 @@ void FLE_objdump(const FLEObject& obj, FLEWriter& writer)
             }
 
             while (pos < next_break) {
-                std::stringstream ss;
-                ss << "🔢: ";
                 size_t chunk_size = std::min({
-                    size_t(16),
+                    HEX_BLOCK_BYTES,
                     next_break - pos,
                     section.data.size() - pos
                 });
 
-                for (size_t i = 0; i < chunk_size; ++i) {
-                    ss << std::hex << std::setw(2) << std::setfill('0')
-                       << static_cast<int>(section.data[pos + i]);
-                    if (i < chunk_size - 1) {
-                        ss << " ";
-                    }
-                }
-                writer.write_line(ss.str());
+                std::string line = "🔢: ";
+                char hex[3 * HEX_BLOCK_BYTES];
+                line.append(hex, hex_encode(section.data.data() + pos, chunk_size, hex));
+                writer.write_line(line);
                 pos += chunk_size;
             }
         }
 
+        // 数据之后的符号：可执行文件里不占数据的 .bss，以及节末尾的标签
+        if (section_it != symbol_index.end()) {
+            for (auto it = section_it->second.lower_bound(section.data.size()); it != section_it->second.end(); ++it) {
+                write_symbols(it->second);
+            }
+        }
+
         writer.end_section();
     }
 }
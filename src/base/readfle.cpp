@@ -1,4 +1,5 @@
 #include "fle.hpp"
+#include "reloc.hpp"
 #include <iomanip>
 #include <iostream>
 
@@ -7,7 +8,7 @@ size_t get_max_symbol_name_length(const std::vector<Symbol>& symbols)
 {
     size_t max_len = 0;
     for (const auto& sym : symbols) {
-        max_len = std::max(max_len, sym.name.length());
+        max_len = std::max(max_len, sym.name.size());
     }
     return max_len;
 }
@@ -72,6 +73,8 @@ void FLE_readfle(const FLEObject& obj)
             flags.push_back("EXEC");
         if (shdr.flags & SHF::NOBITS)
             flags.push_back("NOBITS");
+        if (shdr.flags & SHF::TLS)
+            flags.push_back("TLS");
 
         std::string flag_str;
         for (size_t i = 0; i < flags.size(); i++) {
@@ -145,21 +148,7 @@ void FLE_readfle(const FLEObject& obj)
                 std::cout << "  " << std::left << std::setw(10) << format_hex(reloc.offset, 2);
 
                 // 打印重定位类型
-                std::string type_str;
-                switch (reloc.type) {
-                case RelocationType::R_X86_64_32:
-                    type_str = "R_X86_64_32";
-                    break;
-                case RelocationType::R_X86_64_PC32:
-                    type_str = "R_X86_64_PC32";
-                    break;
-                case RelocationType::R_X86_64_64:
-                    type_str = "R_X86_64_64";
-                    break;
-                case RelocationType::R_X86_64_32S:
-                    type_str = "R_X86_64_32S";
-                    break;
-                }
+                std::string type_str(reloc_info(reloc.type).name);
                 std::cout << std::left << std::setw(15) << type_str
                           << std::left << std::setw(max_symbol_name_len) << reloc.symbol
                           << " " << format_hex(reloc.addend, 8) << std::endl;
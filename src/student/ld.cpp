@@ -1,23 +1,24 @@
 #include "fle.hpp"
+#include "parallel.hpp"
+#include "reloc.hpp"
+#include "tls.hpp"
+#include "trace.hpp"
+#include "version_script.hpp"
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <stdexcept>
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <fstream>
+#include <iomanip>
 #include <set>
-
-/*
-辅助函数：将数值以小端序写入字节数组
-*/
-void write_le(std::vector<uint8_t>& data, size_t offset, uint64_t value, size_t size) {
-    for (size_t i = 0; i < size; ++i) {
-        if (offset + i < data.size()) {
-            data[offset + i] = (value >> (i * 8)) & 0xff;
-        }
-    }
-}
+#include <unordered_map>
+#include <unordered_set>
+#include <sstream>
 
 /*
 辅助函数：判断前缀
@@ -26,6 +27,12 @@ static bool starts_with(const std::string& str, const std::string& prefix) {
     return str.size() >= prefix.size() && str.compare(0, prefix.size(), prefix) == 0;
 }
 
+//合并后数据量达到这个大小才值得启动工作线程
+static constexpr size_t PARALLEL_COPY_THRESHOLD = 1 << 20;
+
+//归档成员数达到这个数量才并行检查
+static constexpr size_t PARALLEL_SCAN_THRESHOLD = 256;
+
 static uint64_t align_up(uint64_t addr, uint64_t align = 4096) {
     if (align == 0) return addr;
     return (addr + align - 1) / align * align;
@@ -39,9 +46,164 @@ static std::string get_output_section_name(const std::string& name) {
     if (starts_with(name, ".rodata")) return ".rodata";
     if (starts_with(name, ".data")) return ".data";
     if (starts_with(name, ".bss")) return ".bss";
+    if (starts_with(name, ".tdata")) return ".tdata";
+    if (starts_with(name, ".tbss")) return ".tbss";
     return ".data"; 
 }
 
+/*
+辅助函数：判断GOTPCRELX重定位能否松弛为直接的PC相对寻址
+  mov foo@GOTPCREL(%rip), %reg  (8b /r) -> lea foo(%rip), %reg (8d /r)
+  call *foo@GOTPCREL(%rip)      (ff 15) -> addr32 call foo     (67 e8)
+  jmp *foo@GOTPCREL(%rip)       (ff 25) -> jmp foo; nop        (e9 .. 90)
+普通的GOTPCREL不保证前面是这几种指令，不能改写
+*/
+static bool can_relax_gotpcrel(const std::vector<uint8_t>& data, const Relocation& reloc) {
+    if (reloc.type == RelocationType::R_X86_64_GOTPCREL) return false;
+    if (reloc.offset < 2 || reloc.offset + 4 > data.size()) return false;
+
+    uint8_t op = data[reloc.offset - 2];
+    uint8_t modrm = data[reloc.offset - 1];
+    //只接受 RIP 相对寻址 (mod=00, r/m=101)
+    if (op == 0x8b) return (modrm & 0xc7) == 0x05;
+    if (reloc.type == RelocationType::R_X86_64_GOTPCRELX && op == 0xff) {
+        return modrm == 0x15 || modrm == 0x25;
+    }
+    return false;
+}
+
+/*
+辅助函数：判断GOTTPOFF重定位能否松弛为立即数（initial-exec -> local-exec）
+  mov foo@GOTTPOFF(%rip), %reg  (REX.W 8b /r) -> mov $tpoff, %reg  (REX.W c7 /0)
+  add foo@GOTTPOFF(%rip), %reg  (REX.W 03 /r) -> add $tpoff, %reg  (REX.W 81 /0)
+*/
+static bool can_relax_gottpoff(const std::vector<uint8_t>& data, const Relocation& reloc) {
+    if (reloc.offset < 3 || reloc.offset + 4 > data.size()) return false;
+    uint8_t rex = data[reloc.offset - 3];
+    uint8_t op = data[reloc.offset - 2];
+    uint8_t modrm = data[reloc.offset - 1];
+    return (rex == 0x48 || rex == 0x4c) && (op == 0x8b || op == 0x03) && (modrm & 0xc7) == 0x05;
+}
+
+static void relax_gottpoff(std::vector<uint8_t>& buffer, size_t pos) {
+    uint8_t& rex = buffer[pos - 3];
+    uint8_t& op = buffer[pos - 2];
+    uint8_t& modrm = buffer[pos - 1];
+    //寄存器从 ModRM.reg 移到 ModRM.rm，REX.R 随之变为 REX.B
+    rex = rex == 0x4c ? 0x49 : 0x48;
+    op = op == 0x8b ? 0xc7 : 0x81;
+    modrm = 0xc0 | ((modrm >> 3) & 7);
+}
+
+/*
+辅助函数：判断data[pos]处的rel32是否是 call/jmp/jcc rel32 的操作数，只有这类引用能改走PLT
+*/
+static bool is_branch_rel32(const std::vector<uint8_t>& data, size_t pos) {
+    if (pos >= 1 && pos <= data.size() && (data[pos - 1] == 0xe8 || data[pos - 1] == 0xe9)) return true;
+    return pos >= 2 && pos <= data.size() && data[pos - 2] == 0x0f && (data[pos - 1] & 0xf0) == 0x80;
+}
+
+/*
+辅助函数：原地改写指令，pos为重定位字段在buffer中的位置
+返回值为改写后重定位字段相对原位置的偏移（jmp改写后前移1字节）
+*/
+static int64_t relax_gotpcrel(std::vector<uint8_t>& buffer, size_t pos) {
+    uint8_t& op = buffer[pos - 2];
+    uint8_t& modrm = buffer[pos - 1];
+    if (op == 0x8b) {
+        op = 0x8d;
+        return 0;
+    }
+    if (modrm == 0x15) {
+        op = 0x67;
+        modrm = 0xe8;
+        return 0;
+    }
+    op = 0xe9;
+    buffer[pos + 3] = 0x90;
+    return -1;
+}
+
+/*
+-Map 输出：每个输入节在输出节中的最终位置
+*/
+struct InputPlacement {
+    size_t obj_index;
+    std::string in_sec_name;
+    std::string out_sec_name;
+    uint64_t offset_in_out_sec;
+    uint64_t size;
+};
+
+static std::string map_hex(uint64_t value) {
+    std::ostringstream ss;
+    ss << "0x" << std::hex << std::setw(16) << std::setfill('0') << value;
+    return ss.str();
+}
+
+static void write_link_map(const std::string& filename,
+                           const std::vector<FLEObject>& selected_objects,
+                           const std::vector<std::string>& object_labels,
+                           const std::vector<std::pair<std::string, std::string>>& archive_reasons,
+                           const std::vector<InputPlacement>& placements,
+                           const std::vector<std::string>& out_sec_order,
+                           std::map<std::string, uint64_t>& out_sec_vaddrs,
+                           std::map<std::string, uint64_t>& out_sec_virtual_sizes,
+                           const std::vector<InternedString>& plt_symbols,
+                           const std::vector<InternedString>& got_symbols) {
+    std::ofstream out(filename);
+    if (!out) throw std::runtime_error("Cannot open map file: " + filename);
+
+    if (!archive_reasons.empty()) {
+        out << "Archive member included to satisfy reference by symbol\n\n";
+        for (const auto& [member, symbol] : archive_reasons) {
+            out << member << "\n" << std::string(24, ' ') << "(" << symbol << ")\n";
+        }
+        out << "\n";
+    }
+
+    out << "Linker script and memory map\n\n";
+    out << std::left << std::setw(24) << "Section" << std::setw(20) << "Address"
+        << std::setw(20) << "Size" << "Input\n";
+
+    for (const auto& name : out_sec_order) {
+        if (!out_sec_virtual_sizes.count(name) || out_sec_virtual_sizes[name] == 0) continue;
+        uint64_t base = out_sec_vaddrs[name];
+        out << "\n" << std::left << std::setw(24) << name << std::setw(20) << map_hex(base)
+            << map_hex(out_sec_virtual_sizes[name]) << "\n";
+
+        //链接器生成的节
+        if (name == ".plt" || name == ".got") {
+            const auto& entries = name == ".plt" ? plt_symbols : got_symbols;
+            size_t entry_size = name == ".plt" ? 6 : 8;
+            for (size_t k = 0; k < entries.size(); ++k) {
+                out << std::string(24, ' ') << std::setw(20) << map_hex(base + k * entry_size)
+                    << std::setw(20) << "" << entries[k] << "\n";
+            }
+            continue;
+        }
+
+        for (const auto& p : placements) {
+            if (p.out_sec_name != name) continue;
+            uint64_t addr = base + p.offset_in_out_sec;
+            out << " " << std::left << std::setw(23) << p.in_sec_name << std::setw(20) << map_hex(addr)
+                << std::setw(20) << map_hex(p.size) << object_labels[p.obj_index] << "\n";
+
+            std::vector<std::pair<uint64_t, std::string_view>> syms;
+            for (const auto& sym : selected_objects[p.obj_index].symbols) {
+                if (sym.type != SymbolType::UNDEFINED && sym.section == p.in_sec_name) {
+                    syms.push_back({addr + sym.offset, sym.name});
+                }
+            }
+            std::sort(syms.begin(), syms.end());
+            for (const auto& [sym_addr, sym_name] : syms) {
+                out << std::string(24, ' ') << std::setw(20) << map_hex(sym_addr)
+                    << std::setw(20) << "" << sym_name << "\n";
+            }
+        }
+    }
+}
+
 struct ResolvedSymbol {
     uint64_t vaddr;
     SymbolType type;
@@ -52,12 +214,59 @@ struct SectionLocation {
     uint64_t offset_in_out_sec;
 };
 
+/*
+归档成员中第一个能满足当前未定义引用的符号（有节的非未定义符号），没有则返回 nullptr
+*/
+static const Symbol* first_needed_symbol(const FLEObject& member, const std::unordered_set<InternedString>& undefined) {
+    for (const auto& sym : member.symbols) {
+        if (sym.type != SymbolType::UNDEFINED && !sym.section.empty() && undefined.count(sym.name)) {
+            return &sym;
+        }
+    }
+    return nullptr;
+}
+
+/*
+一轮归档扫描中已提交成员涉及过的符号（它们在未定义集合中的状态可能已变）
+前面加一层按哈希的位图过滤，绝大多数查询只需一次位测试
+*/
+class TouchedSymbols {
+public:
+    bool empty() const { return names.empty(); }
+
+    void add(InternedString name) {
+        bits[name.hash() & (FILTER_BITS - 1)] = true;
+        names.insert(name);
+    }
+
+    bool contains(InternedString name) const {
+        return bits[name.hash() & (FILTER_BITS - 1)] && names.count(name);
+    }
+
+    //成员在快照下的结论（第一个命中的符号 hit，或没有命中）仍然成立，
+    //当且仅当 hit 及其之前的可定义符号都没有被触及
+    bool affects(const FLEObject& member, const Symbol* hit) const {
+        for (const auto& sym : member.symbols) {
+            if (sym.type != SymbolType::UNDEFINED && !sym.section.empty() && contains(sym.name)) {
+                return true;
+            }
+            if (&sym == hit) break;
+        }
+        return false;
+    }
+
+private:
+    static constexpr size_t FILTER_BITS = 1 << 16;
+    std::vector<bool> bits = std::vector<bool>(FILTER_BITS);
+    std::unordered_set<InternedString> names;
+};
+
 /*
 追踪符号状态
 */
 struct SymbolStatus {
-    std::set<std::string> defined;
-    std::set<std::string> undefined;
+    std::unordered_set<InternedString> defined;
+    std::unordered_set<InternedString> undefined;
 
     void add_object_symbols(const FLEObject& obj) {
         for (const auto& sym : obj.symbols) {
@@ -82,15 +291,19 @@ struct SymbolStatus {
 
 FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& options)
 {
+    TraceScope phase("Symbol collection & archive resolution");
     std::vector<FLEObject> selected_objects;
+    std::vector<std::string> object_labels; //-Map中显示的输入名，如 libfoo.fa(bar.fo)
+    std::vector<std::pair<std::string, std::string>> archive_reasons;
     SymbolStatus status;
     std::set<std::string> included_member_names; 
     
     //Bonus 2: 区分内部定义和动态定义
-    std::set<std::string> internal_defined;
-    std::set<std::string> dynamic_defined;
+    std::unordered_set<InternedString> internal_defined;
+    std::unordered_set<InternedString> dynamic_defined;
+    std::unordered_map<InternedString, const Symbol*> dynamic_symbols; //同名时取第一个共享库中的定义
 
-    status.undefined.insert(options.entryPoint);
+    status.undefined.insert(intern(options.entryPoint));
 
     FLEObject executable;
     //Bonus 1: 根据选项决定输出类型
@@ -103,6 +316,7 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
     for (const auto& obj : objects) {
         if (obj.type == ".obj") {
             selected_objects.push_back(obj);
+            object_labels.push_back(obj.name);
             status.add_object_symbols(obj);
             //记录内部符号
             for (const auto& sym : obj.symbols) {
@@ -120,6 +334,7 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
             for (const auto& sym : obj.symbols) {
                 if (sym.type != SymbolType::UNDEFINED) {
                     dynamic_defined.insert(sym.name);
+                    dynamic_symbols.emplace(sym.name, &sym);
 
                     if (status.undefined.count(sym.name)) {
                         status.undefined.erase(sym.name);
@@ -132,65 +347,219 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
         }
     }
 
+    //加载器自己提供的函数（见 tls.hpp）和共享库导出的函数一样，经 PLT/GOT 在运行时解析
+    for (std::string_view name : LOADER_SYMBOLS) {
+        dynamic_defined.insert(intern(name));
+        status.undefined.erase(intern(name));
+    }
+
     //迭代扫描 .ar 归档文件
+    //每一轮中，一个归档的全部成员先并行对照未定义集合的快照做检查，
+    //再按归档顺序逐个提交；只有快照结论可能被前面提交的成员改变的成员才重新检查，
+    //因此选择结果与逐个顺序扫描完全一致
     bool changed = true;
     while (changed) {
         changed = false;
         for (const auto& input : objects) {
-            if (input.type == ".ar") {
-                for (const auto& member : input.members) {
-                    if (included_member_names.count(member.name)) continue;
-
-                    bool needed = false;
-                    for (const auto& sym : member.symbols) {
-                        if (sym.type != SymbolType::UNDEFINED && !sym.section.empty()) {
-                            //如果是未定义符号，且未被动态库满足
-                            if (status.undefined.count(sym.name)) {
-                                needed = true;
-                                break;
-                            }
-                        }
+            if (input.type != ".ar") continue;
+            const auto& members = input.members;
+
+            //只有一个线程或成员不多时，预先检查只是多做一遍，直接逐个检查
+            bool speculate = members.size() >= PARALLEL_SCAN_THRESHOLD && default_thread_count() > 1;
+            std::vector<const Symbol*> hits;
+            if (speculate) {
+                hits.assign(members.size(), nullptr);
+                parallel_for(members.size(), [&](size_t i) {
+                    if (!included_member_names.count(members[i].name)) {
+                        hits[i] = first_needed_symbol(members[i], status.undefined);
+                    }
+                });
+            }
+
+            TouchedSymbols touched;
+            for (size_t i = 0; i < members.size(); ++i) {
+                const auto& member = members[i];
+                if (included_member_names.count(member.name)) continue;
+
+                const Symbol* hit;
+                if (!speculate || (!touched.empty() && touched.affects(member, hits[i]))) {
+                    hit = first_needed_symbol(member, status.undefined);
+                } else {
+                    hit = hits[i];
+                }
+                if (hit == nullptr) continue;
+
+                selected_objects.push_back(member);
+                object_labels.push_back(input.name + "(" + member.name + ")");
+                archive_reasons.push_back({object_labels.back(), std::string(hit->name)});
+                status.add_object_symbols(member);
+                included_member_names.insert(member.name);
+                //新加入的 .ar 成员也是内部符号
+                for (const auto& sym : member.symbols) {
+                    if (sym.type != SymbolType::UNDEFINED && !sym.section.empty()) {
+                        internal_defined.insert(sym.name);
+                    }
+                }
+                changed = true;
+
+                //add_object_symbols 只会改变这些名字在未定义集合中的状态
+                if (!speculate) continue;
+                for (const auto& sym : member.symbols) {
+                    touched.add(sym.name);
+                }
+                for (const auto& [name, sec] : member.sections) {
+                    for (const auto& reloc : sec.relocs) {
+                        touched.add(reloc.symbol);
                     }
+                }
+            }
+        }
+    }
+
+    phase.stop();
 
-                    if (needed) {
-                        selected_objects.push_back(member);
-                        status.add_object_symbols(member);
-                        included_member_names.insert(member.name);
-                        //新加入的 .ar 成员也是内部符号
-                        for (const auto& sym : member.symbols) {
-                            if (sym.type != SymbolType::UNDEFINED && !sym.section.empty()) {
-                                internal_defined.insert(sym.name);
+    //共享库导出哪些符号：同名符号取各目标文件中最严格的可见性，
+    //hidden 符号和版本脚本判为 local 的符号只在库内使用
+    std::unordered_map<InternedString, SymbolVisibility> visibility;
+    std::unordered_set<InternedString> defined_functions;
+    std::optional<VersionScript> version_script;
+    if (options.shared) {
+        for (const auto& obj : selected_objects) {
+            for (const auto& sym : obj.symbols) {
+                if (sym.type != SymbolType::GLOBAL && sym.type != SymbolType::WEAK) continue;
+                auto& v = visibility[sym.name];
+                v = std::max(v, sym.visibility);
+                if (sym.section.view().substr(0, 5) == ".text") defined_functions.insert(sym.name);
+            }
+        }
+        if (!options.versionScript.empty()) {
+            version_script = VersionScript::load(options.versionScript);
+        }
+    }
+    auto is_exported = [&](InternedString name) {
+        auto it = visibility.find(name);
+        return it != visibility.end() && it->second != SymbolVisibility::HIDDEN &&
+               (!version_script || version_script->exports(name));
+    };
+
+    //库内对自身函数的调用默认在链接时直接绑定，不经过 PLT；导出的数据默认可被抢占，
+    //库内经 GOT 访问，可执行文件因此能为它做复制重定位。
+    //-Bsymbolic 把数据也直接绑定；-Bno-symbolic 恢复 ELF 的默认语义：导出的 default 符号
+    //都可被先加载模块中的同名定义抢占，库内对它的调用走 PLT、GOTPCREL 走 GOT、
+    //绝对地址留给加载器按名字填写；-Bsymbolic-functions 只绑定函数，数据仍可被抢占
+    auto is_redirectable = [&](const FLESection& sec, const Relocation& reloc) {
+        return is_gotpcrel(reloc.type) || is_tls(reloc.type) || reloc.type == RelocationType::R_X86_64_64 ||
+               (reloc.type == RelocationType::R_X86_64_PC32 && is_branch_rel32(sec.data, reloc.offset));
+    };
+
+    //默认绑定下，非 -fPIC 代码用 PC32 或32位绝对地址访问的数据无处改道，只好直接绑定（导出为 protected）
+    std::unordered_set<InternedString> pinned_data;
+    if (options.shared && options.binding == SymbolBinding::Default) {
+        for (const auto& obj : selected_objects) {
+            for (const auto& [name, sec] : obj.sections) {
+                for (const auto& reloc : sec.relocs) {
+                    if (!is_redirectable(sec, reloc) && !defined_functions.count(reloc.symbol)) pinned_data.insert(reloc.symbol);
+                }
+            }
+        }
+    }
+
+    auto is_interposable = [&](InternedString name) {
+        if (!options.shared || options.binding == SymbolBinding::Direct || !is_exported(name)) return false;
+        if (visibility[name] != SymbolVisibility::DEFAULT) return false;
+        if (options.binding == SymbolBinding::Interposable) return true;
+        return !defined_functions.count(name) && !pinned_data.count(name);
+    };
+
+    //Bonus 2: 可执行文件用绝对地址或PC32访问共享库中的数据对象时，改用复制重定位：
+    //在可执行文件里为它预留一份副本，加载器从库中复制初值，之后所有模块都使用这份副本。
+    //引用因此在链接时就能直接绑定，不经过GOT，库也不必为此放在低地址
+    std::vector<InternedString> copy_symbols;
+    if (!options.shared) {
+        for (const auto& obj : selected_objects) {
+            for (const auto& [name, sec] : obj.sections) {
+                for (const auto& reloc : sec.relocs) {
+                    if (internal_defined.count(reloc.symbol) || is_gotpcrel(reloc.type) || is_tls(reloc.type)) continue;
+                    if (reloc.type == RelocationType::R_X86_64_PC32 && is_branch_rel32(sec.data, reloc.offset)) continue;
+                    auto it = dynamic_symbols.find(reloc.symbol);
+                    if (it == dynamic_symbols.end() || it->second->section.view().substr(0, 5) == ".text") continue;
+
+                    //protected 的库数据在库内直接访问，不会改用副本，复制后两边各改各的
+                    if (it->second->visibility == SymbolVisibility::PROTECTED) {
+                        std::string lib;
+                        for (const auto& input : objects) {
+                            if (input.type == ".so" && std::any_of(input.symbols.begin(), input.symbols.end(),
+                                                                   [&](const Symbol& s) { return &s == it->second; })) {
+                                lib = input.name;
                             }
                         }
-                        changed = true;
+                        throw std::runtime_error(obj.name + ": copy relocation against protected symbol '" + reloc.symbol +
+                                                 "' in " + lib + ", which accesses it directly; recompile with -fPIC "
+                                                 "to reach it through the GOT, or build the library with -fPIC and without -Bsymbolic");
                     }
+
+                    //有了副本，这个符号就和可执行文件自己定义的一样
+                    copy_symbols.push_back(reloc.symbol);
+                    internal_defined.insert(reloc.symbol);
                 }
             }
         }
     }
 
     //Bonus 2: 确定需要的GOT和PLT条目
-    std::vector<std::string> got_symbols; 
-    std::map<std::string, size_t> got_indices; 
+    TraceScope got_plt_phase("GOT/PLT scan");
+    std::vector<InternedString> got_symbols; 
+    std::unordered_map<InternedString, size_t> got_indices; 
     
-    std::vector<std::string> plt_symbols; 
-    std::map<std::string, size_t> plt_indices; 
+    std::vector<InternedString> plt_symbols; 
+    std::unordered_map<InternedString, size_t> plt_indices; 
 
     //预扫描所有选定对象的重定位表，找出需要动态解析的引用
     for (const auto& obj : selected_objects) {
         for (const auto& [name, sec] : obj.sections) {
             for (const auto& reloc : sec.relocs) {
 
-                if (internal_defined.count(reloc.symbol)) continue;
+                //线程局部变量：可执行文件自己的变量在链接时就知道相对线程指针的偏移，
+                //能松弛的 initial-exec 访问改成立即数，其余 GOTTPOFF 需要一个存放偏移的GOT条目
+                if (is_tls(reloc.type)) {
+                    bool bound = !options.shared && internal_defined.count(reloc.symbol);
+                    if (reloc.type == RelocationType::R_X86_64_GOTTPOFF && !(bound && can_relax_gottpoff(sec.data, reloc)) &&
+                        got_indices.find(reloc.symbol) == got_indices.end()) {
+                        got_indices[reloc.symbol] = got_symbols.size();
+                        got_symbols.push_back(reloc.symbol);
+                    }
+                    continue;
+                }
+
+                if (internal_defined.count(reloc.symbol) && !is_interposable(reloc.symbol)) {
+                    //内部符号的GOTPCREL优先松弛为直接寻址，无法松弛时才需要GOT条目
+                    if (is_gotpcrel(reloc.type) && !can_relax_gotpcrel(sec.data, reloc) &&
+                        got_indices.find(reloc.symbol) == got_indices.end()) {
+                        got_indices[reloc.symbol] = got_symbols.size();
+                        got_symbols.push_back(reloc.symbol);
+                    }
+                    continue;
+                }
 
                 if (!dynamic_defined.count(reloc.symbol) && !options.shared) continue;
+
+                //可被抢占的符号的地址要到加载时才知道，数据的PC相对或32位绝对引用无处改道
+                if (is_interposable(reloc.symbol) && !is_redirectable(sec, reloc)) {
+                    std::string flag = options.binding == SymbolBinding::Functions ? "-Bsymbolic-functions" : "-Bno-symbolic";
+                    throw std::runtime_error(obj.name + ": relocation " + std::string(reloc_info(reloc.type).name) +
+                                             " against '" + reloc.symbol + "' cannot be used with " + flag +
+                                             "; recompile with -fPIC or drop " + flag);
+                }
                 
                 if (got_indices.find(reloc.symbol) == got_indices.end()) {
                     got_indices[reloc.symbol] = got_symbols.size();
                     got_symbols.push_back(reloc.symbol);
                 }
 
-                if (reloc.type == RelocationType::R_X86_64_PC32) {
+                //可执行文件对库函数的绝对地址引用也指向PLT条目，PLT条目就是函数在可执行文件中的规范地址
+                bool via_plt = reloc.type == RelocationType::R_X86_64_PC32 ||
+                               (!options.shared && !is_gotpcrel(reloc.type));
+                if (via_plt) {
                     if (plt_indices.find(reloc.symbol) == plt_indices.end()) {
                         plt_indices[reloc.symbol] = plt_symbols.size();
                         plt_symbols.push_back(reloc.symbol);
@@ -200,11 +569,15 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
         }
     }
 
+    got_plt_phase.stop();
+
     //构建节顺序，加入.plt和.got
-    std::vector<std::string> out_sec_order = {".text", ".plt", ".rodata", ".data", ".got", ".bss"};
+    TraceScope layout_phase("Layout");
+    std::vector<std::string> out_sec_order = {".text", ".plt", ".rodata", ".tdata", ".tbss", ".data", ".got", ".bss"};
     std::map<std::string, std::vector<uint8_t>> out_sec_buffers;
     std::map<std::string, uint64_t> out_sec_virtual_sizes; 
-    std::map<std::pair<size_t, std::string>, SectionLocation> sec_map;
+    std::map<std::pair<size_t, std::string_view>, SectionLocation> sec_map;
+    std::vector<InputPlacement> placements;
 
     //初始化特殊节的大小
     if (!plt_symbols.empty()) {
@@ -217,7 +590,14 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
         out_sec_buffers[".got"].resize(got_symbols.size() * 8, 0);
     }
 
-    //合并常规节
+    //合并常规节：先只分配偏移，不复制数据
+    struct SectionCopy {
+        std::string out_name;
+        uint64_t offset;
+        const std::vector<uint8_t>* data;
+    };
+    std::vector<SectionCopy> copies;
+    std::map<std::string, uint64_t> out_sec_file_sizes;
     for (size_t i = 0; i < selected_objects.size(); ++i) {
         std::map<std::string, uint64_t> actual_sizes;
         for (const auto& shdr : selected_objects[i].shdrs) {
@@ -232,15 +612,48 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
 
             uint64_t current_offset = out_sec_virtual_sizes[out_name];
             sec_map[{i, name}] = {out_name, current_offset};
+            placements.push_back({i, name, out_name, current_offset, sz});
 
             if (out_name != ".bss" && !sec.data.empty()) {
-                out_sec_buffers[out_name].insert(out_sec_buffers[out_name].end(), 
-                                               sec.data.begin(), sec.data.end());
+                copies.push_back({out_name, current_offset, &sec.data});
+                out_sec_file_sizes[out_name] = current_offset + sec.data.size();
             }
             out_sec_virtual_sizes[out_name] += sz;
         }
     }
 
+    //复制重定位的副本接在 .data 末尾。FLE 的动态重定位内联在节数据里，
+    //而 .bss 不带数据，所以副本不放 .bss；每份至少8字节，正好容纳内联的重定位字段
+    std::unordered_map<InternedString, uint64_t> copy_offsets;
+    std::unordered_map<InternedString, uint64_t> copy_sizes; //预留的字节数，记进 .dyncopy 的加数，供加载器检查
+    for (InternedString sym : copy_symbols) {
+        uint64_t size = dynamic_symbols[sym]->size;
+        uint64_t offset = align_up(out_sec_virtual_sizes[".data"], size >= 16 ? 16 : 8);
+        copy_offsets[sym] = offset;
+        copy_sizes[sym] = std::max<uint64_t>(align_up(size, 8), 8);
+        out_sec_virtual_sizes[".data"] = offset + copy_sizes[sym];
+        out_sec_file_sizes[".data"] = out_sec_virtual_sizes[".data"];
+    }
+
+    //输出节大小已确定：每个缓冲区一次分配到位，再把输入节直接复制到最终偏移
+    //各输入节的目标区间互不重叠，数据量大时交给工作线程并行复制
+    size_t copy_bytes = 0;
+    for (const auto& [out_name, file_size] : out_sec_file_sizes) {
+        out_sec_buffers[out_name].resize(file_size, 0);
+    }
+    for (const auto& copy : copies) {
+        copy_bytes += copy.data->size();
+    }
+    auto copy_section = [&](size_t k) {
+        const auto& copy = copies[k];
+        std::memcpy(out_sec_buffers.at(copy.out_name).data() + copy.offset, copy.data->data(), copy.data->size());
+    };
+    if (copy_bytes >= PARALLEL_COPY_THRESHOLD) {
+        parallel_for(copies.size(), copy_section);
+    } else {
+        for (size_t k = 0; k < copies.size(); ++k) copy_section(k);
+    }
+
     //布局规划
     //Bonus 1: 共享库通常以0x0为基址，可执行文件以0x400000为基址
     uint64_t current_vaddr = options.shared ? 0x0 : 0x400000;
@@ -248,7 +661,9 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
 
     for (const auto& name : out_sec_order) {
         if (out_sec_virtual_sizes.count(name) && out_sec_virtual_sizes[name] > 0) {
-            current_vaddr = align_up(current_vaddr);
+            //.tbss 紧跟 .tdata，两者合起来是一个 TLS 模板
+            if (name == ".tbss" && out_sec_vaddrs.count(".tdata")) current_vaddr = align_up(current_vaddr, TLS_BLOCK_ALIGN);
+            else current_vaddr = align_up(current_vaddr);
             out_sec_vaddrs[name] = current_vaddr;
             current_vaddr += out_sec_virtual_sizes[name];
         }
@@ -261,7 +676,7 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
         std::vector<uint8_t>& plt_buf = out_sec_buffers[".plt"];
 
         for (size_t i = 0; i < plt_symbols.size(); ++i) {
-            std::string sym = plt_symbols[i];
+            InternedString sym = plt_symbols[i];
             size_t got_idx = got_indices[sym];
             
             //计算GOT条目地址
@@ -280,9 +695,22 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
         }
     }
 
+    //TLS 模板的范围；可执行文件的 TLS 块紧挨在线程指针之下，变量的偏移因此在链接时确定
+    uint64_t tls_vaddr = 0, tls_end = 0;
+    for (const char* name : {".tdata", ".tbss"}) {
+        if (!out_sec_vaddrs.count(name)) continue;
+        if (tls_end == 0) tls_vaddr = out_sec_vaddrs[name];
+        tls_end = out_sec_vaddrs[name] + out_sec_virtual_sizes[name];
+    }
+    uint64_t tls_exe_offset = tls_block_offset(0, tls_end - tls_vaddr);
+    auto tp_offset = [&](uint64_t vaddr) { return vaddr - tls_vaddr - tls_exe_offset; };
+
+    layout_phase.stop();
+
     // ================== Symbol Resolution & Relocation ==================
-    std::map<std::string, ResolvedSymbol> global_sym_table;
-    std::vector<std::map<std::string, uint64_t>> local_sym_tables(selected_objects.size());
+    TraceScope reloc_phase("Symbol resolution & relocation");
+    std::unordered_map<InternedString, ResolvedSymbol> global_sym_table;
+    std::vector<std::unordered_map<InternedString, uint64_t>> local_sym_tables(selected_objects.size());
 
     //解析内部符号
     for (size_t i = 0; i < selected_objects.size(); ++i) {
@@ -308,7 +736,41 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
         }
     }
 
-    //应用重定位
+    for (InternedString sym : copy_symbols) {
+        global_sym_table[sym] = {out_sec_vaddrs[".data"] + copy_offsets[sym], SymbolType::GLOBAL};
+    }
+
+    //共享库的加载地址要到运行时才知道，库内绑定的绝对地址记为“所在输出节 + 偏移”的动态重定位，
+    //由加载器加上该节的实际地址（相当于ELF的RELATIVE重定位），不必按名字查找
+    auto section_relative = [&](RelocationType type, uint64_t offset, uint64_t vaddr, int64_t addend) {
+        std::string sec;
+        for (const auto& name : out_sec_order) {
+            if (is_tls_section(name) || !out_sec_vaddrs.count(name) || out_sec_vaddrs[name] > vaddr) continue;
+            //节末尾的地址（如大小为0的符号）仍算作该节
+            if (vaddr <= out_sec_vaddrs[name] + out_sec_virtual_sizes[name]) sec = name;
+        }
+        if (sec.empty()) {
+            throw std::runtime_error("address " + format_signed_hex(static_cast<int64_t>(vaddr)) + " is outside every output section");
+        }
+        return Relocation{type, offset, intern(sec), static_cast<int64_t>(vaddr - out_sec_vaddrs[sec]) + addend};
+    };
+
+    //共享库的 TLS 块位置要等加载器排好各模块才知道，偏移留给加载器填写：
+    //库内绑定的变量同样记为“所在输出节 + 偏移”，其余按名字查找
+    std::map<size_t, Relocation> got_dyn_relocs; //GOT下标 -> 填写该条目的动态重定位
+    auto tls_dyn_reloc = [&](uint64_t offset, InternedString sym, std::optional<uint64_t> vaddr, int64_t addend) {
+        if (!vaddr) return Relocation{RelocationType::R_X86_64_TPOFF64, offset, sym, addend};
+        std::string sec = out_sec_vaddrs.count(".tbss") && *vaddr >= out_sec_vaddrs[".tbss"] ? ".tbss" : ".tdata";
+        return Relocation{RelocationType::R_X86_64_TPOFF64, offset, intern(sec),
+                          static_cast<int64_t>(*vaddr - out_sec_vaddrs[sec]) + addend};
+    };
+
+    //库内直接绑定的全局符号；其中的数据对象导出为 protected，可执行文件不能为它们做复制重定位
+    std::unordered_set<InternedString> directly_bound;
+
+    //应用重定位：先解析出每项的S/A/P，再按类型分组批量写入
+    RelocBatch batch;
+    std::set<size_t> filled_got;
     for (size_t i = 0; i < selected_objects.size(); ++i) {
         for (const auto& [name, sec] : selected_objects[i].sections) {
             auto loc = sec_map[{i, name}];
@@ -317,17 +779,84 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
             uint64_t out_sec_base = out_sec_vaddrs[loc.out_sec_name];
 
             for (const auto& reloc : sec.relocs) {
+                uint64_t P = out_sec_base + loc.offset_in_out_sec + reloc.offset;
+                int64_t A = reloc.addend;
+                size_t write_pos = loc.offset_in_out_sec + reloc.offset;
+
+                //线程局部变量：S 是变量相对线程指针（TPOFF）或本模块 TLS 块起点（DTPOFF）的偏移
+                if (is_tls(reloc.type)) {
+                    std::optional<uint64_t> vaddr;
+                    if (local_sym_tables[i].count(reloc.symbol)) {
+                        vaddr = local_sym_tables[i][reloc.symbol];
+                    } else if (global_sym_table.count(reloc.symbol) && !is_interposable(reloc.symbol)) {
+                        vaddr = global_sym_table[reloc.symbol].vaddr;
+                    } else if (!options.shared && !dynamic_defined.count(reloc.symbol)) {
+                        throw std::runtime_error("Undefined symbol: " + reloc.symbol);
+                    }
+                    std::string where = std::string(reloc_info(reloc.type).name) + " against '" + reloc.symbol + "'";
+
+                    RelocationType type = reloc.type;
+                    uint64_t S = 0;
+                    switch (reloc.type) {
+                    case RelocationType::R_X86_64_DTPOFF32:
+                    case RelocationType::R_X86_64_DTPOFF64:
+                        if (!vaddr) throw std::runtime_error(where + " needs a thread-local variable of this module");
+                        S = *vaddr - tls_vaddr;
+                        break;
+                    case RelocationType::R_X86_64_TPOFF32:
+                    case RelocationType::R_X86_64_TPOFF64:
+                        if (options.shared && type == RelocationType::R_X86_64_TPOFF32) {
+                            throw std::runtime_error(where + " cannot be used when making a shared library; recompile with -fPIC");
+                        }
+                        if (!options.shared && !vaddr && type == RelocationType::R_X86_64_TPOFF32) {
+                            throw std::runtime_error(where + ": the variable is defined in a shared library; "
+                                                     "recompile with -ftls-model=initial-exec");
+                        }
+                        if (options.shared || !vaddr) {
+                            executable.dyn_relocs.push_back(tls_dyn_reloc(P, reloc.symbol, vaddr, A));
+                            continue;
+                        }
+                        S = tp_offset(*vaddr);
+                        break;
+                    default: //R_X86_64_GOTTPOFF
+                        if (!options.shared && vaddr && can_relax_gottpoff(sec.data, reloc)) {
+                            //偏移在链接时已知，去掉一次GOT访问；addend 中的 -4 是为PC相对准备的，一并去掉
+                            relax_gottpoff(buffer, write_pos);
+                            type = RelocationType::R_X86_64_TPOFF32;
+                            S = tp_offset(*vaddr);
+                            A += 4;
+                            break;
+                        }
+                        size_t idx = got_indices[reloc.symbol];
+                        if (filled_got.insert(idx).second) {
+                            if (!options.shared && vaddr) {
+                                batch.add(RelocationType::R_X86_64_64, {out_sec_buffers[".got"].data() + idx * 8, tp_offset(*vaddr), 0, 0},
+                                          {executable.name, ".got", reloc.symbol, idx * 8});
+                            } else {
+                                got_dyn_relocs[idx] = tls_dyn_reloc(out_sec_vaddrs[".got"] + idx * 8, reloc.symbol, vaddr, 0);
+                            }
+                        }
+                        S = out_sec_vaddrs[".got"] + idx * 8;
+                        break;
+                    }
+                    RelocSite site{selected_objects[i].name, name, reloc.symbol, reloc.offset};
+                    check_reloc_bounds(type, site, write_pos, buffer.size());
+                    batch.add(type, {buffer.data() + write_pos, S, A, P}, site);
+                    continue;
+                }
+
                 uint64_t S = 0;
                 bool is_internal = false;
                 bool is_dynamic = false;
 
-                //尝试内部解析
+                //尝试内部解析；可被抢占的库内符号和外部符号一样经 PLT/GOT 访问
                 if (local_sym_tables[i].count(reloc.symbol)) {
                     S = local_sym_tables[i][reloc.symbol];
                     is_internal = true;
-                } else if (global_sym_table.count(reloc.symbol)) {
+                } else if (global_sym_table.count(reloc.symbol) && !is_interposable(reloc.symbol)) {
                     S = global_sym_table[reloc.symbol].vaddr;
                     is_internal = true;
+                    if (options.shared) directly_bound.insert(reloc.symbol);
                 } 
                 //尝试动态解析
                 else if (got_indices.count(reloc.symbol)) {
@@ -340,41 +869,53 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
                      if (!options.shared) throw std::runtime_error("Undefined symbol: " + reloc.symbol);
                 }
 
-                uint64_t P = out_sec_base + loc.offset_in_out_sec + reloc.offset;
-                int64_t A = reloc.addend;
-                uint64_t val = 0; size_t sz = 0;
                 bool handled = false;
 
                 if (is_internal) {
-                    switch (reloc.type) {
-                        case RelocationType::R_X86_64_32:
-                        case RelocationType::R_X86_64_32S: val = S + A; sz = 4; break;
-                        case RelocationType::R_X86_64_64:  val = S + A; sz = 8; break;
-                        case RelocationType::R_X86_64_PC32: val = S + A - P; sz = 4; break;
-                        default: continue;
+                    if (is_gotpcrel(reloc.type)) {
+                        if (can_relax_gotpcrel(sec.data, reloc)) {
+                            //符号在链接单元内已确定，去掉一次GOT间接访问
+                            int64_t shift = relax_gotpcrel(buffer, write_pos);
+                            write_pos += shift;
+                            P += shift;
+                        } else {
+                            size_t idx = got_indices[reloc.symbol];
+                            //可执行文件地址固定，直接填写GOT条目；共享库的条目由加载器按节基址填写。
+                            //局部和 hidden 符号不导出，不能按名字查找（每个条目只写一次）
+                            if (filled_got.insert(idx).second) {
+                                if (options.shared) {
+                                    got_dyn_relocs[idx] = section_relative(RelocationType::R_X86_64_64,
+                                                                           out_sec_vaddrs[".got"] + idx * 8, S, 0);
+                                } else {
+                                    batch.add(RelocationType::R_X86_64_64, {out_sec_buffers[".got"].data() + idx * 8, S, 0, 0},
+                                              {executable.name, ".got", reloc.symbol, idx * 8});
+                                }
+                            }
+                            S = out_sec_vaddrs[".got"] + idx * 8;
+                        }
+                    } else if (options.shared && !reloc_info(reloc.type).pc_relative) {
+                        //库内的绝对地址随加载基址变化，交给加载器填写
+                        executable.dyn_relocs.push_back(section_relative(reloc.type, P, S, A));
+                        continue;
                     }
                     handled = true;
                 } 
                 else if (is_dynamic) {
-                    //Bonus 2: 重定向到GOT或PLT
-                    if (reloc.type == RelocationType::R_X86_64_PC32) {
-                        size_t idx = plt_indices[reloc.symbol];
-                        uint64_t plt_stub_addr = out_sec_vaddrs[".plt"] + idx * 6;
-                        val = plt_stub_addr + A - P;
-                        sz = 4;
+                    //Bonus 2: 重定向到GOT或PLT，S替换为对应条目的地址
+                    if (plt_indices.count(reloc.symbol) && !is_gotpcrel(reloc.type)) {
+                        S = out_sec_vaddrs[".plt"] + plt_indices[reloc.symbol] * 6;
                         handled = true;
                     } 
-                    else if (reloc.type == RelocationType::R_X86_64_GOTPCREL) {
-                        size_t idx = got_indices[reloc.symbol];
-                        uint64_t got_entry_addr = out_sec_vaddrs[".got"] + idx * 8;
-                        val = got_entry_addr + A - P;
-                        sz = 4;
+                    else if (is_gotpcrel(reloc.type)) {
+                        S = out_sec_vaddrs[".got"] + got_indices[reloc.symbol] * 8;
                         handled = true;
                     }
                 }
 
                 if (handled) {
-                    write_le(buffer, loc.offset_in_out_sec + reloc.offset, val, sz);
+                    RelocSite site{selected_objects[i].name, name, reloc.symbol, reloc.offset};
+                    check_reloc_bounds(reloc.type, site, write_pos, buffer.size());
+                    batch.add(reloc.type, {buffer.data() + write_pos, S, A, P}, site);
                 } else if (!is_internal && options.shared) {
                     Relocation dyn_rel;
                     dyn_rel.offset = P; 
@@ -387,10 +928,26 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
         }
     }
 
+    batch.apply();
+
+    for (InternedString sym : copy_symbols) {
+        executable.dyn_relocs.push_back(
+            {RelocationType::R_X86_64_COPY, out_sec_vaddrs[".data"] + copy_offsets[sym], sym,
+             static_cast<int64_t>(copy_sizes[sym])});
+    }
+
     //Bonus 2: 生成GOT的动态重定位表
     if (!got_symbols.empty()) {
         uint64_t got_base = out_sec_vaddrs[".got"];
         for (size_t i = 0; i < got_symbols.size(); ++i) {
+            auto filled = got_dyn_relocs.find(i);
+            if (filled != got_dyn_relocs.end()) {
+                executable.dyn_relocs.push_back(filled->second);
+                continue;
+            }
+            //可执行文件中的内部符号已在上面静态填写
+            if (!options.shared && internal_defined.count(got_symbols[i])) continue;
+
             Relocation dyn_rel;
             dyn_rel.offset = got_base + i * 8; //GOT条目的地址
             dyn_rel.symbol = got_symbols[i];
@@ -400,11 +957,21 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
         }
     }
 
+    reloc_phase.stop();
+
+    //-Map: 在缓冲区被移入输出对象之前写出布局
+    if (!options.mapFile.empty()) {
+        TraceScope map_phase("Write link map", options.mapFile);
+        write_link_map(options.mapFile, selected_objects, object_labels, archive_reasons, placements,
+                       out_sec_order, out_sec_vaddrs, out_sec_virtual_sizes, plt_symbols, got_symbols);
+    }
+
     //构建输出
+    TraceScope output_phase("Build output object");
     for (const auto& name : out_sec_order) {
         if (out_sec_virtual_sizes.count(name) && out_sec_virtual_sizes[name] > 0) {
             FLESection out_sec;
-            out_sec.name = name;
+            out_sec.name = intern(name);
             if (name != ".bss") out_sec.data = std::move(out_sec_buffers[name]);
             executable.sections[name] = out_sec;
 
@@ -416,7 +983,8 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
             //设置权限
             if (name == ".text" || name == ".plt") {
                 phdr.flags = static_cast<uint32_t>(PHF::R) | static_cast<uint32_t>(PHF::X);
-            } else if (name == ".rodata") {
+            } else if (name == ".rodata" || is_tls_section(name)) {
+                //TLS 模板只在加载时被复制，各线程改的是自己的副本
                 phdr.flags = static_cast<uint32_t>(PHF::R);
             } else { // .data, .got, .bss
                 phdr.flags = static_cast<uint32_t>(PHF::R) | static_cast<uint32_t>(PHF::W);
@@ -427,13 +995,15 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
     }
 
     //Bonus 1: 导出动态符号表
+    //不导出的符号在库内的引用上面已直接绑定
     if (options.shared) {
-        std::set<std::string> exported_names;
+        std::unordered_set<InternedString> exported_names;
         for (size_t i = 0; i < selected_objects.size(); ++i) {
             for (const auto& sym : selected_objects[i].symbols) {
                 if ((sym.type == SymbolType::GLOBAL || sym.type == SymbolType::WEAK) &&
                     sym.type != SymbolType::UNDEFINED && !sym.section.empty()) {
-                    
+                    if (!is_exported(sym.name)) continue;
+
                     if (global_sym_table.count(sym.name)) {
                         auto loc = sec_map[{i, sym.section}];
                         uint64_t base = out_sec_vaddrs[loc.out_sec_name];
@@ -442,7 +1012,12 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
                         if (sym_vaddr == global_sym_table[sym.name].vaddr) {
                             if (exported_names.find(sym.name) == exported_names.end()) {
                                 Symbol export_sym = sym;
-                                export_sym.section = loc.out_sec_name;
+                                export_sym.visibility = visibility[sym.name];
+                                if (export_sym.visibility == SymbolVisibility::DEFAULT && directly_bound.count(sym.name) &&
+                                    loc.out_sec_name != ".text") {
+                                    export_sym.visibility = SymbolVisibility::PROTECTED;
+                                }
+                                export_sym.section = intern(loc.out_sec_name);
                                 export_sym.offset = loc.offset_in_out_sec + sym.offset;
                                 executable.symbols.push_back(export_sym);
                                 exported_names.insert(sym.name);
@@ -454,7 +1029,43 @@ FLEObject FLE_ld(const std::vector<FLEObject>& objects, const LinkerOptions& opt
         }
     }
 
-    if (global_sym_table.count(options.entryPoint)) executable.entry = global_sym_table[options.entryPoint].vaddr;
+    //可执行文件保留符号表（-s 时省略），供 nm、disasm 和 exec --profile 使用；
+    //exec 不用它解析动态符号，所以保持原来的绑定类型
+    if (!options.shared && !options.strip) {
+        std::unordered_set<InternedString> kept_globals;
+        for (size_t i = 0; i < selected_objects.size(); ++i) {
+            for (const auto& sym : selected_objects[i].symbols) {
+                if (sym.type == SymbolType::UNDEFINED || sym.section.empty()) continue;
+
+                auto loc_it = sec_map.find({i, sym.section});
+                if (loc_it == sec_map.end() || !out_sec_vaddrs.count(loc_it->second.out_sec_name)) continue;
+                const auto& loc = loc_it->second;
+                uint64_t sym_vaddr = out_sec_vaddrs[loc.out_sec_name] + loc.offset_in_out_sec + sym.offset;
+
+                //同名的弱定义只保留最终胜出的那个
+                if (sym.type != SymbolType::LOCAL &&
+                    (global_sym_table[sym.name].vaddr != sym_vaddr || !kept_globals.insert(sym.name).second)) {
+                    continue;
+                }
+
+                Symbol kept = sym;
+                kept.section = intern(loc.out_sec_name);
+                kept.offset = loc.offset_in_out_sec + sym.offset;
+                executable.symbols.push_back(kept);
+            }
+        }
+    }
+
+    //副本也记入符号表，nm 和 exec --profile 能看到它的名字
+    if (!options.shared && !options.strip) {
+        for (InternedString sym : copy_symbols) {
+            executable.symbols.push_back(
+                {SymbolType::GLOBAL, intern(".data"), copy_offsets[sym], dynamic_symbols[sym]->size, sym});
+        }
+    }
+
+    InternedString entry_point = intern(options.entryPoint);
+    if (global_sym_table.count(entry_point)) executable.entry = global_sym_table[entry_point].vaddr;
     else if (!options.shared) throw std::runtime_error("Undefined symbol: " + options.entryPoint);
 
     return executable;
@@ -2,10 +2,11 @@
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <cctype>
 
 //辅助函数：判断字符串是否以指定前缀开头
-static bool starts_with(const std::string& str, const std::string& prefix) {
+static bool starts_with(std::string_view str, std::string_view prefix) {
     return str.size() >= prefix.size() && 
            str.compare(0, prefix.size(), prefix) == 0;
 }
@@ -33,7 +34,7 @@ void FLE_nm(const FLEObject& obj)
             is_code_section = true;
         } else if (starts_with(sym.section, ".data")) {
             type_char = 'D';
-        } else if (starts_with(sym.section, ".bss")) {
+        } else if (starts_with(sym.section, ".bss") || starts_with(sym.section, ".tbss")) {
             type_char = 'B';
         } else if (starts_with(sym.section, ".rodata")) {
             type_char = 'R';
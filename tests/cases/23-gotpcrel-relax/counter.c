@@ -0,0 +1,8 @@
+// B2-4: GOTPCRELX 松弛 - 被引用的数据和函数
+
+int counter;
+
+int bump(int x)
+{
+    return x + 1;
+}
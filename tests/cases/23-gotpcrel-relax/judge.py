@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""
+B2-4 Judge: 验证GOTPCRELX松弛
+- main.fo 应带有 .gotpcrelx / .rexgotpcrelx 重定位
+- 所有被引用的符号都在链接单元内定义，可执行文件中不应再有 .got 节和动态重定位
+"""
+import json
+import sys
+import os
+
+SCRIPT_DIR = os.path.dirname(__file__)
+ROOT_DIR = os.path.abspath(os.path.join(SCRIPT_DIR, "..", ".."))
+if ROOT_DIR not in sys.path:
+    sys.path.append(ROOT_DIR)
+
+from common.fle_utils import extract_dynamic_relocs
+
+def load_fle_json(path):
+    with open(path, 'r') as f:
+        return json.load(f)
+
+def judge():
+    try:
+        input_data = json.load(sys.stdin)
+        test_dir = input_data["test_dir"]
+        build_dir = os.path.join(test_dir, "build")
+
+        obj = load_fle_json(os.path.join(build_dir, "main.fo"))
+        lines = [l for v in obj.values() if isinstance(v, list) for l in v if isinstance(l, str)]
+        if not any(".gotpcrelx(" in l or ".rexgotpcrelx(" in l for l in lines):
+            print(json.dumps({"success": False, "message": "main.fo has no relaxable GOTPCREL relocations"}))
+            return
+
+        exe_fle = load_fle_json(os.path.join(build_dir, "program"))
+        sections = {phdr.get("name", "") for phdr in exe_fle.get("phdrs", [])}
+        if ".got" in sections:
+            print(json.dumps({"success": False, "message": "Executable still has a .got segment"}))
+            return
+
+        dyn_relocs = extract_dynamic_relocs(exe_fle)
+        if dyn_relocs:
+            print(json.dumps({"success": False, "message": f"Unexpected dynamic relocations: {dyn_relocs}"}))
+            return
+
+        print(json.dumps({"success": True, "message": "All GOT accesses relaxed"}))
+
+    except Exception as e:
+        print(json.dumps({"success": False, "message": f"Judge error: {str(e)}"}))
+
+if __name__ == "__main__":
+    judge()
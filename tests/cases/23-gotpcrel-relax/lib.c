@@ -0,0 +1,24 @@
+// B2-4: 共享库中无法松弛的 GOT 访问
+// 以 -fPIC 编译，对 lib_counter 的比较是 cmp lib_counter@GOTPCREL(%rip)，不能改写为直接寻址；
+// 版本脚本不导出 lib_counter，链接器只能让加载器按库的加载地址填写这个 GOT 条目
+
+int lib_counter = 3;
+
+int lib_is_counter(const int *p)
+{
+    return p == &lib_counter;
+}
+
+int *lib_counter_addr(void)
+{
+    return &lib_counter; // 可以松弛
+}
+
+// 数据段里指向库内数组中间的指针：加载器按“.data + 偏移”填写，偏移要原样读回
+static int lib_table[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+int *lib_entry = &lib_table[5];
+
+int lib_entry_value(void)
+{
+    return *lib_entry;
+}
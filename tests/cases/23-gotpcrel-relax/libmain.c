@@ -0,0 +1,14 @@
+// B2-4: 通过共享库的接口检查库内 GOT 条目指向的地址
+
+extern int lib_is_counter(const int *p);
+extern int *lib_counter_addr(void);
+extern int lib_entry_value(void);
+
+int main()
+{
+    int *p = lib_counter_addr();
+    if (*p != 3 || !lib_is_counter(p)) {
+        return 1;
+    }
+    return lib_entry_value() == 5 ? 0 : 2;
+}
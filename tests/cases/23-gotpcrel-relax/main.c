@@ -0,0 +1,18 @@
+// B2-4: GOTPCRELX 松弛 - 主程序
+// 以 -fPIC -fno-plt 编译，对 counter 的访问和对 bump/tail 的调用都经过 GOT，
+// 而它们都在链接单元内定义，链接器应把这些访问改写为直接寻址
+
+extern int counter;
+extern int bump(int);
+
+int tail(int x)
+{
+    return bump(x); // jmp *bump@GOTPCREL(%rip)
+}
+
+int main()
+{
+    counter = 5;
+    int r = tail(counter); // call *tail@GOTPCREL(%rip)
+    return (r == 6 && counter == 5) ? 0 : 1;
+}
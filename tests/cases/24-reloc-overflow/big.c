@@ -0,0 +1,2 @@
+// 4GB 的 .bss，把后面链接进来的 after 推到 4GB 以上
+char big[0x100000000UL];
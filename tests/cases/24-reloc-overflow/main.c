@@ -0,0 +1,12 @@
+// 以 -fno-pie 编译，取 after 的地址会生成 32 位绝对重定位 (R_X86_64_32)
+extern int after;
+
+long addr(void)
+{
+    return (long)&after;
+}
+
+int main(void)
+{
+    return addr() != 0;
+}
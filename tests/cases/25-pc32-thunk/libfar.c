@@ -0,0 +1,5 @@
+// 被低地址可执行文件直接 call rel32 调用的库函数
+int far_func(void)
+{
+    return 42;
+}
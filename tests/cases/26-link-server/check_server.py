@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Link through `ld --serve` and check the results match local links.
+
+usage: check_server.py <root_dir> <build_dir> <common_dir>
+"""
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+from pathlib import Path
+
+root, build, common = (Path(p) for p in sys.argv[1:4])
+ld = str(root / "ld")
+
+
+def fail(message):
+    print(f"FAIL: {message}")
+    sys.exit(1)
+
+
+def link(inputs, output, server=None):
+    env = dict(os.environ)
+    env.pop("FLE_LD_SERVER", None)
+    if server:
+        env["FLE_LD_SERVER"] = server
+    proc = subprocess.run([ld, *map(str, inputs), "-o", str(output)], env=env, capture_output=True, text=True)
+    if proc.returncode != 0:
+        fail(f"link of {output.name} failed: {proc.stderr}")
+
+
+def same(a, b):
+    return a.read_bytes() == b.read_bytes()
+
+
+# The socket lives in a short temporary path; sun_path is limited to 108 bytes
+sock_dir = tempfile.mkdtemp(prefix="fle-ld-")
+sock = os.path.join(sock_dir, "ld.sock")
+server = subprocess.Popen([ld, "--serve", sock], stderr=subprocess.PIPE, text=True)
+try:
+    for _ in range(100):
+        if os.path.exists(sock):
+            break
+        time.sleep(0.02)
+    else:
+        fail("server did not start")
+
+    # Same inputs twice: the second link is served from the cache
+    inputs = [build / "input.fo", build / "libscale.fa", common / "minilibc.fo"]
+    shutil.copyfile(build / "main.fo", build / "input.fo")
+    link(inputs, build / "expected")
+    link(inputs, build / "program", sock)
+    if not same(build / "program", build / "expected"):
+        fail("first server link differs from a local link")
+    link(inputs, build / "program", sock)
+    if not same(build / "program", build / "expected"):
+        fail("cached server link differs from a local link")
+
+    # A changed input must be re-read, not served stale
+    shutil.copyfile(build / "main2.fo", build / "input.fo")
+    link(inputs, build / "expected2")
+    link(inputs, build / "program2", sock)
+    if not same(build / "program2", build / "expected2"):
+        fail("server reused a stale input after it changed")
+
+    # A second server on the same socket is refused
+    if subprocess.run([ld, "--serve", sock], capture_output=True).returncode == 0:
+        fail("second server started on a busy socket")
+
+    if subprocess.run([ld, "--serve-stop", sock]).returncode != 0:
+        fail("--serve-stop failed")
+    server.wait(timeout=5)
+    log = server.stderr.read()
+    if "3 cached / 0 parsed" not in log:
+        fail(f"second link was not served from the cache:\n{log}")
+    if os.path.exists(sock):
+        fail("server left its socket behind")
+finally:
+    if server.poll() is None:
+        server.kill()
+    shutil.rmtree(sock_dir, ignore_errors=True)
+
+# Without a server, FLE_LD_SERVER falls back to linking locally
+link(inputs, build / "program3", sock)
+if not same(build / "program3", build / "expected2"):
+    fail("fallback link differs from a local link")
+
+print("link server OK")
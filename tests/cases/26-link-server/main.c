@@ -0,0 +1,6 @@
+int scale(int);
+
+int main()
+{
+    return scale(7) == 21 ? 0 : 1;
+}
@@ -0,0 +1,6 @@
+int scale(int);
+
+int main()
+{
+    return scale(2) + 1;
+}
@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Check disasm against binutils objdump, instruction by instruction.
+
+Two inputs: every .text section of the compiled code.fo, and a hand-made
+object whose .text strings together encodings compilers rarely produce from
+the test sources (prefixes, REX byte registers, %riz, string ops, SSE).
+
+usage: check_disasm.py <root_dir> <build_dir>
+"""
+import json
+import re
+import subprocess
+import sys
+from pathlib import Path
+
+root, build = (Path(p).resolve() for p in sys.argv[1:3])
+
+# (hex bytes, note) -- each must decode to exactly one instruction
+SAMPLES = [
+    ("f3 0f 1e fa", "endbr64"),
+    ("66 2e 0f 1f 84 00 00 00 00 00", "cs nopw"),
+    ("66 66 2e 0f 1f 84 00 00 00 00 00", "data16 cs nopw"),
+    ("0f 1f 44 00 00", "nopl with SIB"),
+    ("8d 74 26 00", "%riz"),
+    ("40 88 f7", "REX byte registers"),
+    ("88 e0", "legacy high byte registers"),
+    ("66 89 c8", "16-bit operands"),
+    ("49 b8 ef cd ab 89 67 45 23 01", "movabs"),
+    ("48 c7 c0 ff ff ff ff", "sign-extended imm32"),
+    ("48 83 e4 f0", "sign-extended imm8"),
+    ("64 48 8b 04 25 28 00 00 00", "%fs absolute"),
+    ("4a 8b 04 c5 00 00 00 00", "index without base"),
+    ("f3 48 ab", "rep stos"),
+    ("f3 a6", "repz cmpsb"),
+    ("f0 0f b1 17", "lock cmpxchg"),
+    ("3e ff e0", "notrack jmp"),
+    ("ff 14 c5 08 00 00 00", "indirect call through a table"),
+    ("f3 c3", "repz ret"),
+    ("c2 08 00", "ret imm16"),
+    ("48 0f af c1", "imul two operands"),
+    ("6b c0 f9", "imul three operands"),
+    ("0f b6 c0", "movzbl"),
+    ("48 0f bf 07", "movswq"),
+    ("48 63 c7", "movslq"),
+    ("48 98", "cltq"),
+    ("48 99", "cqto"),
+    ("d1 e8", "shr by one"),
+    ("48 d3 e0", "shl by %cl"),
+    ("c1 7d f8 03", "sarl memory"),
+    ("f7 5c 24 08", "negl memory"),
+    ("0f 94 c0", "sete"),
+    ("48 0f 4c c2", "cmovl"),
+    ("0f ba e0 05", "bt imm"),
+    ("f3 48 0f b8 c7", "popcnt"),
+    ("f3 0f bc c0", "tzcnt"),
+    ("0f c8", "bswap"),
+    ("66 0f ef c0", "pxor"),
+    ("f2 0f 10 05 00 00 00 00", "movsd %rip"),
+    ("66 48 0f 7e c0", "movq xmm to gpr"),
+    ("f2 48 0f 2a c7", "cvtsi2sd"),
+    ("f2 0f 2a 44 24 08", "cvtsi2sdl memory"),
+    ("66 0f 73 db 08", "psrldq"),
+    ("0f 12 c1", "movhlps"),
+    ("66 0f 70 c0 1b", "pshufd"),
+    ("45 0f 29 44 24 10", "movaps xmm8+"),
+    ("0f 05", "syscall"),
+    ("cc", "int3"),
+]
+
+
+def fail(message):
+    print(f"FAIL: {message}")
+    sys.exit(1)
+
+
+def fle_bytes(lines):
+    """Section bytes with relocation slots as zeros, plus reloc offsets"""
+    data, relocs = bytearray(), []
+    for line in lines:
+        if line.startswith("🔢"):
+            data += bytes.fromhex(line.split(":", 1)[1])
+        elif line.startswith("❓"):
+            kind = re.match(r"❓: \.(\w+)\(", line).group(1)
+            relocs.append(len(data))
+            data += bytes(8 if kind.endswith("64") else 4)
+    return bytes(data), relocs
+
+
+def reference(data, name):
+    raw = build / f"{name}.bin"
+    raw.write_bytes(data)
+    out = subprocess.run(
+        ["objdump", "-D", "-b", "binary", "-m", "i386:x86-64", str(raw)], capture_output=True, text=True, check=True
+    ).stdout
+    insns = {}
+    for line in out.splitlines():
+        m = re.match(r"^\s*([0-9a-f]+):\t[0-9a-f ]+\t(.*)$", line)
+        if m:
+            text = m.group(2).split("#")[0]
+            insns[int(m.group(1), 16)] = " ".join(text.split())
+    return insns
+
+
+def disasm(obj, section):
+    out = subprocess.run([str(root / "disasm"), str(obj), section], capture_output=True, text=True)
+    if out.returncode != 0:
+        fail(f"disasm {obj.name} {section}: {out.stderr.strip()}")
+    insns, annotated = {}, set()
+    for line in out.stdout.splitlines():
+        m = re.match(r"^([0-9a-f]{4,}): ((?:[0-9a-f]{2} )*[0-9a-f]{2})\s+(.*)$", line)
+        if m:
+            addr = int(m.group(1), 16)
+            text, _, comment = m.group(3).partition("#")
+            insns[addr] = " ".join(text.split())
+            if comment.strip():
+                annotated.add(addr)
+    return insns, annotated
+
+
+def compare(obj, section, lines):
+    data, relocs = fle_bytes(lines)
+    expected = reference(data, section.strip(".").replace(".", "_"))
+    actual, annotated = disasm(obj, section)
+    if expected != actual:
+        for addr in sorted(set(expected) | set(actual)):
+            if expected.get(addr) != actual.get(addr):
+                fail(f"{obj.name} {section} +{addr:#x}: objdump '{expected.get(addr)}', disasm '{actual.get(addr)}'")
+    # Every relocation must be annotated on the instruction that contains it
+    starts = sorted(actual)
+    for offset in relocs:
+        owner = max(a for a in starts if a <= offset)
+        if owner not in annotated:
+            fail(f"{obj.name} {section}: relocation at {offset:#x} not annotated")
+    return len(actual)
+
+
+code = build / "code.fo"
+obj = json.loads(code.read_text(encoding="utf-8"))
+count = 0
+for section in obj:
+    if section.startswith(".text"):
+        count += compare(code, section, obj[section])
+
+blob = bytes.fromhex(" ".join(h for h, _ in SAMPLES))
+lines = ["🔢: " + " ".join(f"{b:02x}" for b in blob[i : i + 16]) for i in range(0, len(blob), 16)]
+samples = build / "samples.fo"
+samples.write_text(
+    json.dumps(
+        {
+            "type": ".obj",
+            "shdrs": [{"name": ".text", "type": 1, "flags": 6, "addr": 0, "offset": 0, "size": len(blob)}],
+            ".text": lines,
+        },
+        ensure_ascii=False,
+    ),
+    encoding="utf-8",
+)
+got = compare(samples, ".text", lines)
+if got != len(SAMPLES):
+    fail(f"hand-made samples decoded as {got} instructions, expected {len(SAMPLES)}")
+count += got
+
+print(f"disasm OK: {count} instructions match objdump")
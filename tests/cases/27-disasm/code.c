@@ -0,0 +1,62 @@
+// 编译器常见的各类指令：循环、switch 跳转表、64 位常量、除法、移位、位运算、浮点和结构体拷贝
+
+struct point {
+    long x, y, z;
+    char tag[40];
+};
+
+static struct point origin = { 1, 2, 3, "origin" };
+unsigned long counter;
+double scale = 2.5;
+
+__attribute__((noinline)) long mix(long a, long b)
+{
+    long r = a * 0x9e3779b97f4a7c15L;
+    r ^= (unsigned long)r >> 29;
+    r += b / 7 - b % 13;
+    return r << (b & 7);
+}
+
+__attribute__((noinline)) int classify(int c)
+{
+    switch (c) {
+    case 0:
+        return 17;
+    case 1:
+        return -3;
+    case 2:
+        return c * 100;
+    case 3:
+        return counter > 5;
+    case 4:
+        return (signed char)c;
+    case 5:
+        return (unsigned short)(c * 1000);
+    default:
+        return __builtin_popcount(c) + __builtin_ctz(c);
+    }
+}
+
+__attribute__((noinline)) double blend(double a, long n)
+{
+    return a * scale + (double)n / 3.0;
+}
+
+__attribute__((noinline)) void copy_point(struct point* dst, const struct point* src)
+{
+    *dst = *src;
+    dst->tag[0] = (char)dst->x;
+}
+
+int main(void)
+{
+    struct point p;
+    copy_point(&p, &origin);
+    long sum = 0;
+    for (int i = 0; i < 10; ++i) {
+        sum += mix(i, p.y) + classify(i);
+        counter++;
+    }
+    sum += (long)blend(1.5, sum);
+    return sum == 0;
+}
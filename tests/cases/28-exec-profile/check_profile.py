@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""Run the program under `exec --profile` in both formats and check the report.
+
+usage: check_profile.py <root_dir> <build_dir>
+"""
+import subprocess
+import sys
+from pathlib import Path
+
+root, build = (Path(p).resolve() for p in sys.argv[1:3])
+program = build / "program"
+
+
+def fail(message):
+    print(f"FAIL: {message}")
+    sys.exit(1)
+
+
+def profile(fmt):
+    out = build / f"profile.{fmt}"
+    out.unlink(missing_ok=True)
+    proc = subprocess.run([str(root / "exec"), "--profile", str(out), "--profile-format", fmt, str(program)],
+                          capture_output=True, text=True)
+    # 剖析不应改变程序的行为
+    if proc.returncode != 42 or proc.stdout != "profiled\n":
+        fail(f"{fmt}: program exited {proc.returncode} with output {proc.stdout!r}")
+    if not out.exists():
+        fail(f"{fmt}: no profile written; stderr: {proc.stderr}")
+    return out.read_text()
+
+
+# 平坦剖析：spin 的自身采样最多，work 和 main 的累计采样覆盖它
+rows = {}
+for line in profile("flat").splitlines():
+    if line.startswith("#"):
+        continue
+    fields = line.split()
+    rows[fields[4]] = (int(fields[1]), int(fields[3]))
+if not rows:
+    fail("flat profile is empty")
+hottest = max(rows, key=lambda name: rows[name][0])
+if hottest != "spin":
+    fail(f"hottest symbol is {hottest}, expected spin")
+samples = sum(self for self, _ in rows.values())
+if samples < 20:
+    fail(f"only {samples} samples")
+for caller in ("work", "main"):
+    if caller not in rows or rows[caller][1] < rows["spin"][0] // 2:
+        fail(f"{caller} total does not cover its callees: {rows.get(caller)}")
+
+# 折叠调用栈：从 _start 开始，经过 main 到达 spin
+stacks = {}
+for line in profile("folded").splitlines():
+    stack, count = line.rsplit(" ", 1)
+    stacks[stack] = int(count)
+if sum(stacks.values()) < 20:
+    fail("folded profile has too few samples")
+if stacks.get("_start;main;work;spin", 0) < max(stacks.values()) // 2:
+    fail(f"expected _start;main;work;spin to dominate, got {sorted(stacks.items(), key=lambda kv: -kv[1])[:3]}")
+if not any(stack.startswith("_start;main;cold;spin") for stack in stacks):
+    fail("cold;spin stack missing")
+
+print("profile OK")
@@ -0,0 +1,34 @@
+#include "minilibc.h"
+
+// 热点集中在 spin：大部分经 work 调用，少部分经 cold 调用
+volatile unsigned long sink;
+
+__attribute__((noinline)) unsigned long spin(unsigned long n)
+{
+    unsigned long x = n;
+    for (unsigned long i = 0; i < n; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    return x;
+}
+
+__attribute__((noinline)) unsigned long cold(unsigned long n)
+{
+    return spin(n);
+}
+
+__attribute__((noinline)) unsigned long work(int rounds)
+{
+    unsigned long total = 0;
+    for (int i = 0; i < rounds; i++) {
+        total += spin(20000000 + i);
+    }
+    return total;
+}
+
+int main()
+{
+    sink = work(6) + cold(20000000);
+    printf("profiled\n");
+    return 42;
+}
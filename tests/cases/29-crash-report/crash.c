@@ -0,0 +1,21 @@
+#include "minilibc.h"
+
+// 空指针解引用发生在不建立栈帧的叶子函数里，崩溃报告要给出完整的调用链
+volatile int* target;
+
+__attribute__((noinline)) int leaf(int x)
+{
+    return *target + x;
+}
+
+__attribute__((noinline)) static int middle(int x)
+{
+    int r = leaf(x) * 3;
+    return r + 1;
+}
+
+int main()
+{
+    printf("before crash\n");
+    return middle(4);
+}
@@ -0,0 +1,7 @@
+// 引用被版本脚本隐藏的符号，链接应当失败
+extern int lib_internal(int);
+
+int main()
+{
+    return lib_internal(1);
+}
@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+"""
+验证共享库只导出版本脚本和可见性允许的符号
+- api_add、api_scale、api_counter 应导出，api_scale 保留 protected
+- vis_hidden（hidden）和 lib_internal（版本脚本 local）不应导出
+"""
+import json
+import os
+import sys
+
+
+def exported_symbols(fle_obj):
+    """符号名 -> 可见性（省略时为 default）"""
+    symbols = {}
+    for section_data in fle_obj.values():
+        if not isinstance(section_data, list):
+            continue
+        for line in section_data:
+            if isinstance(line, str) and (line.startswith("📤:") or line.startswith("📎:")):
+                parts = line.split(":", 1)[1].split()
+                symbols[parts[0]] = parts[3] if len(parts) > 3 else "default"
+    return symbols
+
+
+def judge():
+    input_data = json.load(sys.stdin)
+    so_path = os.path.join(input_data["test_dir"], "build", "libvis.so")
+    with open(so_path) as f:
+        symbols = exported_symbols(json.load(f))
+
+    expected = {"api_add": "default", "api_scale": "protected", "api_counter": "default"}
+    if symbols != expected:
+        print(json.dumps({"success": False, "message": f"Expected exports {expected}, got {symbols}"}))
+        return
+    print(json.dumps({"success": True, "message": "Export table matches the version script and visibility."}))
+
+
+if __name__ == "__main__":
+    judge()
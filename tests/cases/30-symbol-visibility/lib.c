@@ -0,0 +1,26 @@
+// 共享库的导出范围：可见性属性和版本脚本共同决定
+
+// hidden：只在库内使用，不导出
+__attribute__((visibility("hidden"))) int vis_hidden(int x)
+{
+    return x + 1;
+}
+
+// protected：导出，库内引用直接绑定
+__attribute__((visibility("protected"))) int api_scale(int x)
+{
+    return x * 3;
+}
+
+// 默认可见性，但版本脚本的 local: * 把它留在库内
+int lib_internal(int x)
+{
+    return vis_hidden(x) * 2;
+}
+
+int api_add(int a, int b)
+{
+    return lib_internal(a) + b;
+}
+
+int api_counter = 5;
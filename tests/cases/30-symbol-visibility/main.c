@@ -0,0 +1,13 @@
+// 只通过导出的接口使用共享库
+extern int api_add(int, int);
+extern int api_scale(int);
+extern int api_counter;
+
+int main()
+{
+    // api_add(4, 1) = (4 + 1) * 2 + 1 = 11，api_scale(4) = 12，api_counter = 5
+    if (api_add(4, 1) + api_scale(4) + api_counter == 28) {
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,7 @@
+// 先加载的库：它的定义会抢占后加载库中的同名符号
+int foo(void)
+{
+    return 1;
+}
+
+int shared_value = 3;
@@ -0,0 +1,12 @@
+// 退出码 = call_foo() * 100 + read_value() * 10 + read_pointer()
+// 默认（直接绑定函数，数据可被抢占）与 -Bsymbolic-functions：2 * 100 + 3 * 10 + 3 = 233
+// -Bsymbolic（全部直接绑定）：2 * 100 + 4 * 10 + 4 = 244
+// -Bno-symbolic：1 * 100 + 3 * 10 + 3 = 133
+extern int call_foo(void);
+extern int read_value(void);
+extern int read_pointer(void);
+
+int main()
+{
+    return call_foo() * 100 + read_value() * 10 + read_pointer();
+}
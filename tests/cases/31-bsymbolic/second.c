@@ -0,0 +1,25 @@
+// 后加载的库：库内对 foo 和 shared_value 的引用是否被抢占取决于链接选项
+int foo(void)
+{
+    return 2;
+}
+
+int shared_value = 4;
+
+// 数据段里的绝对地址也必须和其他引用绑定到同一个定义
+int* value_pointer = &shared_value;
+
+int call_foo(void)
+{
+    return foo();
+}
+
+int read_value(void)
+{
+    return shared_value;
+}
+
+int read_pointer(void)
+{
+    return *value_pointer;
+}
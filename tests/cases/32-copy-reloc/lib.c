@@ -0,0 +1,19 @@
+// 被可执行文件直接访问的库数据
+int counter = 7;
+int table[4] = { 1, 2, 3, 4 };
+
+// 库按默认选项链接，导出的数据可被抢占，库内经 GOT 访问，复制重定位后看到的是可执行文件里的副本
+void bump(void)
+{
+    counter++;
+}
+
+int get_counter(void)
+{
+    return counter;
+}
+
+void set_table(int i, int value)
+{
+    table[i] = value;
+}
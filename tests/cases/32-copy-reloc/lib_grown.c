@@ -0,0 +1,18 @@
+// 重新编译后的库：table 变大了，可执行文件里为它预留的副本装不下
+int counter = 7;
+int table[16] = { 1, 2, 3, 4 };
+
+void bump(void)
+{
+    counter++;
+}
+
+int get_counter(void)
+{
+    return counter;
+}
+
+void set_table(int i, int value)
+{
+    table[i] = value;
+}
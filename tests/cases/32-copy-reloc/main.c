@@ -0,0 +1,32 @@
+// 非 PIC 代码直接访问库数据：PC32 和绝对地址引用都依赖复制重定位
+extern int counter;
+extern int table[4];
+extern void bump(void);
+extern int get_counter(void);
+extern void set_table(int i, int value);
+
+volatile int index = 3;
+
+int main()
+{
+    // 初值由加载器从库中复制过来；table[index] 是 32 位绝对地址引用
+    if (counter != 7 || table[index] != 4) {
+        return 1;
+    }
+    // 库修改的是可执行文件里的副本
+    bump();
+    if (counter != 8) {
+        return 2;
+    }
+    // 数组同样如此
+    set_table(index, 40);
+    if (table[index] != 40) {
+        return 3;
+    }
+    // 可执行文件写入的值库也能看到
+    counter = 20;
+    if (get_counter() != 20) {
+        return 4;
+    }
+    return 0;
+}
@@ -0,0 +1,21 @@
+// 库里的线程局部变量用 initial-exec 模型访问：GOT 条目中的偏移由加载器填写
+__thread int lib_counter = 100;
+__thread long lib_total;
+static __thread int lib_step = 5;
+
+int lib_bump(void)
+{
+    lib_total += lib_step;
+    return ++lib_counter;
+}
+
+// 库内的 static 变量没有导出，加载器按“.tdata + 偏移”定位它
+void lib_set_step(int step)
+{
+    lib_step = step;
+}
+
+long lib_get_total(void)
+{
+    return lib_total;
+}
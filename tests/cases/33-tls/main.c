@@ -0,0 +1,117 @@
+// 可执行文件自己的 TLS 变量走 local-exec，库里的和其他目标文件里的走 initial-exec
+#include <linux/futex.h>
+#include <linux/sched.h>
+#include <sys/syscall.h>
+
+extern __thread int lib_counter;
+extern __thread int seed;
+extern int lib_bump(void);
+extern void lib_set_step(int step);
+extern long lib_get_total(void);
+extern long syscall(int num, ...);
+
+// 加载器为新线程分配 TLS 区域，见 include/tls.hpp
+extern void* __fle_thread_area_alloc(void);
+extern void __fle_thread_area_free(void* tp);
+
+int value = 9;
+__thread int counter = 42;
+__thread char buffer[32];
+__thread int* pointer = &value; // .tdata 里的重定位在模板中已经填好
+
+static char thread_stack[16384] __attribute__((aligned(16)));
+static volatile int thread_tid;
+static int thread_result = -1;
+
+// 新线程的 TLS 是模板里的初值，不受主线程修改的影响
+static int thread_main(void)
+{
+    if (counter != 42 || buffer[5] != 0 || *pointer != 9 || seed != 7 || lib_counter != 100) {
+        return 1;
+    }
+    counter = 1000;
+    if (lib_bump() != 101) {
+        return 2;
+    }
+    return 0;
+}
+
+void thread_entry(void)
+{
+    thread_result = thread_main();
+    syscall(SYS_exit, 0);
+    __builtin_unreachable();
+}
+
+// 以 tp 为线程指针启动运行 thread_entry 的线程；内核在线程退出时清零 thread_tid 并唤醒等待者
+static long start_thread(void* tp)
+{
+    register long rax asm("rax") = SYS_clone;
+    register long rdi asm("rdi") = CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SYSVSEM |
+                                   CLONE_SETTLS | CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID;
+    register long rsi asm("rsi") = (long)(thread_stack + sizeof(thread_stack));
+    register long rdx asm("rdx") = (long)&thread_tid;
+    register long r10 asm("r10") = (long)&thread_tid;
+    register long r8 asm("r8") = (long)tp;
+    // 子线程在新栈上从这里继续，不能返回到本函数
+    asm volatile("syscall\n\t"
+                 "test %%rax, %%rax\n\t"
+                 "jnz 1f\n\t"
+                 "call thread_entry\n"
+                 "1:"
+                 : "+r"(rax)
+                 : "r"(rdi), "r"(rsi), "r"(rdx), "r"(r10), "r"(r8)
+                 : "rcx", "r11", "memory");
+    return rax;
+}
+
+static int run_thread(void)
+{
+    void* tp = __fle_thread_area_alloc();
+    if (tp == 0 || start_thread(tp) <= 0) {
+        return 1;
+    }
+    for (int tid; (tid = thread_tid) != 0;) {
+        syscall(SYS_futex, &thread_tid, FUTEX_WAIT, tid, 0, 0, 0);
+    }
+    __fle_thread_area_free(tp);
+    return thread_result;
+}
+
+int main()
+{
+    if (counter != 42 || buffer[5] != 0 || *pointer != 9 || seed != 7) {
+        return 1;
+    }
+    counter++;
+    buffer[5] = 'x';
+    // 取地址要读 %fs:0 处的线程指针
+    volatile int* p = &counter;
+    if (*p != 43 || buffer[5] != 'x') {
+        return 2;
+    }
+    if (lib_counter != 100) {
+        return 3;
+    }
+    if (lib_bump() != 101 || lib_get_total() != 5) {
+        return 4;
+    }
+    // 库和可执行文件访问的是同一个变量
+    lib_counter = 200;
+    lib_set_step(3);
+    if (lib_bump() != 201 || lib_get_total() != 8) {
+        return 5;
+    }
+    // 各模块的 TLS 块互不重叠
+    if ((char*)&lib_counter >= (char*)&counter && (char*)&lib_counter < (char*)(&counter + 1)) {
+        return 6;
+    }
+    // 另一个线程有自己的一份变量
+    if (run_thread() != 0) {
+        return 7;
+    }
+    if (counter != 43 || lib_counter != 201 || lib_get_total() != 8) {
+        return 8;
+    }
+    return 0;
+}
@@ -0,0 +1,2 @@
+// 另一个目标文件定义的变量：main.c 经 GOTTPOFF 访问，链接器把它松弛为立即数
+__thread int seed = 7;